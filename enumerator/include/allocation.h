@@ -6,47 +6,68 @@
 #include <set>
 
 enum violin_alloc_policy_t { DEFAULT_ALLOC, LRF_ALLOC, MRF_ALLOC };
-violin_alloc_policy_t alloc_policy;
 
-deque<void*> free_pool;
-set<void*> alloc_set;
+// The blocks of the object under test, which are reused in the order of the
+// policy rather than returned to malloc, such that ABA can occur.
+struct ViolinAllocation {
+  violin_alloc_policy_t policy;
+  deque<void*> free_pool;
+  set<void*> alloc_set;
 
-void* violin_malloc(int size) {
-  void *x;
-  if (free_pool.empty()) {
-    x = malloc(size);
-    alloc_set.insert(x);
-  } else {
-    x = free_pool.front();
-    free_pool.pop_front();
+  ViolinAllocation() : policy(DEFAULT_ALLOC) {}
+
+  void* allocate(int size) {
+    void *x;
+    if (free_pool.empty()) {
+      x = malloc(size);
+      alloc_set.insert(x);
+    } else {
+      x = free_pool.front();
+      free_pool.pop_front();
+    }
+    return x;
+  }
+
+  void release(void *x) {
+    if (alloc_set.find(x) == alloc_set.end())
+      return;
+
+    switch (policy) {
+    case LRF_ALLOC:
+      free_pool.push_back(x);
+      break;
+    case MRF_ALLOC:
+      free_pool.push_front(x);
+      break;
+    default:
+      free(x);
+      alloc_set.erase(x);
+    }
+  }
+
+  void clear() {
+    for (set<void*>::iterator p = alloc_set.begin(); p != alloc_set.end(); ) {
+      // Tricky tricky! can't free(*p) before ++p
+      void *ptr = *p;
+      ++p;
+      free(ptr);
+    }
+    alloc_set.clear();
+    free_pool.clear();
   }
-  return x;
+};
+
+// That of the current context; see ViolinContext in violin.h.
+ViolinAllocation &violin_allocation();
+
+void* violin_malloc(int size) {
+  return violin_allocation().allocate(size);
 }
 
 void violin_free(void *x) {
-  if (alloc_set.find(x) == alloc_set.end())
-    return;
-
-  switch (alloc_policy) {
-  case LRF_ALLOC:
-    free_pool.push_back(x);
-    break;
-  case MRF_ALLOC:
-    free_pool.push_front(x);
-    break;
-  default:
-    free(x);
-    alloc_set.erase(x);
-  }
+  violin_allocation().release(x);
 }
 
 void violin_clear_alloc_pool() {
-  for (set<void*>::iterator p = alloc_set.begin(); p != alloc_set.end(); ) {
-    // Tricky tricky! can't free(*p) before ++p
-    void *ptr = *p;
-    ++p;
-    free(ptr);
-  }
-  alloc_set.clear();
-  free_pool.clear();
+  violin_allocation().clear();
 }
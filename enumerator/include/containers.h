@@ -2,8 +2,13 @@
 /** COUNTING FOR CONTAINERS                                                 **/
 /*****************************************************************************/
 
+// With relaxation k > 1, the order and empty checks accept up to k-1
+// witnesses, as for k-FIFO queues, k-stacks and quasi-linearizable
+// containers whose removals may return any of the first k values.
+
 class CollectionCountingMonitor : public CountingMonitor {
   const int num_values;
+  const int relaxation;
   violin_order_t violin_order;
   bool check_empty_violations;
   bool check_order_violations;
@@ -12,19 +17,28 @@ class CollectionCountingMonitor : public CountingMonitor {
 public:
   CollectionCountingMonitor(
     int N, int V, violin_order_t ord,
-    bool verify, bool collect)
+    bool verify, bool collect, int k = 1)
     : CountingMonitor(N,(2*V+5),collect),
       num_values(V),
+      relaxation(k),
       violin_order(ord),
       check_empty_violations(verify),
       check_order_violations(verify),
       check_remove_violations(verify)
-    { }
+    {
+      if (k > 1) {
+        stringstream s;
+        s << "Operation-Counting(" << N-1 << ",k=" << k << ")";
+        name = s.str();
+      }
+    }
   void onReturn() {
     if (vstring == "")
       check_violations();
   }
   void onPostExecute() {
+    if (stream != NULL)
+      load();
     if (vstring == "")
       check_violations();
     CountingMonitor::onPostExecute();
@@ -137,14 +151,23 @@ private:
     pair<int,int> reme = span(m);
     if (!exists(reme)) return false;
 
+    vector< pair<int,int> > adds(num_values+1), rems(num_values+1);
     for (int v=1; v<=num_values; v++) {
-      pair<int,int>
-        addv = span(add_method(v)),
-        remv = span(remove_method(v));
-      for (int i=reme.first; i<=reme.second; i++)
-        for (int j=reme.first; j<=reme.second; j++)
-          if (counters[idx(m,i,j)] > 0 && addv.second < i && j < remv.first)
-            return true;
+      adds[v] = span(add_method(v));
+      rems[v] = span(remove_method(v));
+    }
+
+    for (int i=reme.first; i<=reme.second; i++) {
+      for (int j=reme.first; j<=reme.second; j++) {
+        if (counters[idx(m,i,j)] == 0)
+          continue;
+        int inside = 0;
+        for (int v=1; v<=num_values; v++)
+          if (adds[v].second < i && j < rems[v].first)
+            inside++;
+        if (inside >= relaxation)
+          return true;
+      }
     }
     return false;
   }
@@ -171,6 +194,11 @@ private:
       return before(addu,addv) && (
         (exists(remu) && before(remv,remu))
         || (!exists(remu) && before(remv,remuu)));
+    case PRIORITY_ORDER:
+      // v removed while the smaller u was certainly present.
+      return u < v && before(addu,remv) && (
+        (exists(remu) && before(remv,remu))
+        || (!exists(remu) && before(remv,remuu)));
     default:
       return false;
     }
@@ -190,9 +218,10 @@ private:
         if (!check_order_violations || last_time-time_offset < 1)
           continue;
 
+        int overtaken = 0;
         for (int u = 1; u <= num_values; u++) {
           if (u == v) continue;
-          if (order_violation(u,v)) {
+          if (order_violation(u,v) && ++overtaken >= relaxation) {
             s << "(Ov:" << u << "," << v << ")";
             goto FOUND;
           }
@@ -265,7 +294,10 @@ private:
         }
       }
     }
-    return new History(ops);
+    History *h = new History(ops);
+    for (int i = 0; i < ops.size(); i++)
+      delete ops[i];
+    return h;
   }
 
 };
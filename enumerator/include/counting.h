@@ -3,34 +3,80 @@
 /*****************************************************************************/
 #include <iostream>
 
+class CountingMonitor;
+
+// The operations of an execution in the order of their calls, and its last
+// time, recorded once for several CountingMonitors with different interval
+// bounds, e.g. one per barrier level in VERSUS_MODE; see
+// CountingMonitor::share. The first monitor which shares it feeds it, and
+// deletes it.
+struct CountingStream {
+  CountingMonitor *feeder;
+  vector<Operation*> operations;
+  int last_time;
+
+  CountingStream() : feeder(NULL), last_time(0) {}
+
+  void clear() {
+    operations.clear();
+    last_time = 0;
+  }
+
+  void record(Operation *op) {
+    int now = op->endTime();
+    if (now == OMEGA) {
+      now = op->startTime();
+      operations.push_back(op);
+    }
+    last_time = max(last_time, now);
+  }
+};
+
 class CountingMonitor : public Monitor {
 protected:
   const int num_methods;
   const int interval_bound;
   int *counters;
   int time_offset, last_time;
+  CountingStream *stream;
   const bool debug = false;
 
 public:
   CountingMonitor(int N, int M, bool collect)
     : Monitor("Operation-Counting", collect),
-      interval_bound(N), num_methods(M), counters(new int[N*(N+1)*M]) {
+      interval_bound(N), num_methods(M), counters(new int[N*(N+1)*M]),
+      stream(NULL) {
     stringstream s;
     s << "Operation-Counting(" << N-1 << ")";
     name = s.str();
   }
+  ~CountingMonitor() {
+    delete[] counters;
+    if (stream != NULL && stream->feeder == this)
+      delete stream;
+  }
+
+  // Counts the operations of s rather than each call and return, and only
+  // once the counters are needed; see load.
+  void share(CountingStream *s) {
+    stream = s;
+    if (stream->feeder == NULL)
+      stream->feeder = this;
+  }
 
   virtual void onPreExecute() {
     Monitor::onPreExecute();
     memset(counters, 0, num_methods * interval_bound * (interval_bound+1) * sizeof(int));
     last_time = 0;
     time_offset = 0;
+    if (stream != NULL && stream->feeder == this)
+      stream->clear();
   }
   virtual void onPostExecute() {
     Monitor::onPostExecute();
   }
-  virtual void onCall(Operation *op) { count(op); }
-  virtual void onReturn(Operation *op) { count(op); }
+  virtual void onCall(Operation *op) { event(op); }
+  virtual void onReturn(Operation *op) { event(op); }
 
 protected:
   virtual int method(Operation *op) = 0;
@@ -67,6 +113,31 @@ protected:
     }
   }
 
+  inline void event(Operation *op) {
+    if (stream == NULL)
+      count(op);
+    else if (stream->feeder == this)
+      stream->record(op);
+  }
+
+  // Fills the counters from the stream at once. Each shift moves the counts
+  // of [i,j] to [i-1,j-1], clamped at 0, so after d shifts, the interval
+  // [s,e] of an operation lands in [s-d,e-d], clamped at 0, and a pending
+  // one in [s-d,*]; d is how far the last time exceeds the bound.
+  void load() {
+    memset(counters, 0, num_methods * interval_bound * (interval_bound+1) * sizeof(int));
+    last_time = stream->last_time;
+    time_offset = max(0, last_time - interval_bound + 1);
+    for (vector<Operation*>::iterator op = stream->operations.begin();
+         op != stream->operations.end(); ++op) {
+      int start_time = max(0, (*op)->startTime() - time_offset);
+      int end_time = (*op)->endTime() == OMEGA
+        ? interval_bound
+        : max(0, (*op)->endTime() - time_offset);
+      counters[idx(method(*op),start_time,end_time)]++;
+    }
+  }
+
   void count(Operation *op) {
     int now = op->endTime();
     if (now == OMEGA) now = op->startTime();
@@ -96,33 +167,33 @@ protected:
   }
 
   void print_counters() {
-    cout << "--+";
+    violin_out() << "--+";
     for (int j=0; j<interval_bound+1; j++)
-      cout << "--";
-    cout << endl;
+      violin_out() << "--";
+    violin_out() << endl;
     for (int m=0; m<num_methods; m++) {
-      cout << "M" << m << "|";
+      violin_out() << "M" << m << "|";
       for (int j=0; j<interval_bound; j++)
-        cout << " " << j;
-      cout << " *" << endl;
-      cout << "--+";
+        violin_out() << " " << j;
+      violin_out() << " *" << endl;
+      violin_out() << "--+";
       for (int j=0; j<interval_bound+1; j++)
-        cout << "--";
-      cout << endl;
+        violin_out() << "--";
+      violin_out() << endl;
       for (int i=0; i<interval_bound; i++) {
-        cout << i << " |";
+        violin_out() << i << " |";
         for (int j=0; j<interval_bound+1; j++) {
           if (i <= j)
-            cout << " " << counters[idx(m,i,j)];
+            violin_out() << " " << counters[idx(m,i,j)];
           else
-            cout << " .";
+            violin_out() << " .";
         }
-        cout << endl;
+        violin_out() << endl;
       }
-      cout << "--+";
+      violin_out() << "--+";
       for (int j=0; j<interval_bound+1; j++)
-        cout << "--";
-      cout << endl;
+        violin_out() << "--";
+      violin_out() << endl;
     }
   }
 
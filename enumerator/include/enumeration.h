@@ -2,33 +2,114 @@
 /** FIBER MAGIC                                                             **/
 /*****************************************************************************/
 
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
 #include <vector>
 #include <deque>
 #include <list>
+#include <string>
 #include "Coro.h"
 
 using namespace std;
 
-Coro *scheduler;
-Coro *current;
-bool completed;
+struct Blocker {
+  int thread;
+  void *channel;
+  bool timed;
+};
+
+// The fibers of a search: the coroutine of its scheduler, that of the thread
+// it runs, and how that thread switched back. Each OS thread runs one search
+// at a time, whose fibers are current; so searches in different OS threads
+// do not interfere.
+struct Fibers {
+  Coro *scheduler;
+  Coro *current;
+  bool completed;
+  bool blocked;
+  void *footprint;          // where the current thread last yielded, if annotated
+  int current_index;        // the thread of the current coroutine
+  list<Blocker> blockers;   // disabled threads, in the order they blocked
+  vector<int> woken;        // threads enabled since the last Resume
+  vector<bool> timed_out;
+};
+
+__thread Fibers *fibers;
 
 #define Yield DoYield
 
 void DoYield() {
-  Coro_switchTo_(current, scheduler);
+  fibers->footprint = NULL;
+  Coro_switchTo_(fibers->current, fibers->scheduler);
+}
+
+void DoFootprintYield(void *site) {
+  fibers->footprint = site;
+  Coro_switchTo_(fibers->current, fibers->scheduler);
 }
 
 void Complete() {
-  completed = true;
-  Coro_switchTo_(current, scheduler);
+  fibers->completed = true;
+  Coro_switchTo_(fibers->current, fibers->scheduler);
 }
 
 bool Resume(Coro *c) {
-  completed = false;
-  current = c;
-  Coro_switchTo_(scheduler, current);
-  return completed;
+  fibers->completed = false;
+  fibers->blocked = false;
+  fibers->current = c;
+  Coro_switchTo_(fibers->scheduler, fibers->current);
+  return fibers->completed;
+}
+
+/*****************************************************************************/
+/** BLOCKING                                                                **/
+/*****************************************************************************
+ * A thread which cannot proceed until another one acts calls DoBlock on some
+ * channel, and is disabled until another thread calls DoWake on the same
+ * channel; schedulers do not run disabled threads, so waiting is not
+ * explored as a busy loop. A thread which blocks with a timeout is enabled
+ * again, timed out, once no thread is enabled. DoBlock returns false iff it
+ * timed out.
+ *****************************************************************************/
+
+bool DoBlock(void *channel, bool timed) {
+  Fibers *f = fibers;
+  f->blockers.push_back({.thread = f->current_index, .channel = channel, .timed = timed});
+  f->timed_out[f->current_index] = false;
+  f->blocked = true;
+  f->footprint = NULL;
+  Coro_switchTo_(f->current, f->scheduler);
+  return !f->timed_out[f->current_index];
+}
+
+// Enables the thread which blocked first on channel, if any.
+void DoWake(void *channel) {
+  Fibers *f = fibers;
+  for (list<Blocker>::iterator b = f->blockers.begin(); b != f->blockers.end(); ++b) {
+    if (b->channel == channel) {
+      f->woken.push_back(b->thread);
+      f->blockers.erase(b);
+      return;
+    }
+  }
+}
+
+// Enables the thread which blocked first with a timeout, if any.
+bool TimeOut() {
+  Fibers *f = fibers;
+  for (list<Blocker>::iterator b = f->blockers.begin(); b != f->blockers.end(); ++b) {
+    if (b->timed) {
+      f->timed_out[b->thread] = true;
+      f->woken.push_back(b->thread);
+      f->blockers.erase(b);
+      return true;
+    }
+  }
+  return false;
 }
 
 struct Thread {
@@ -60,17 +141,157 @@ public:
   virtual void onResume(int t) {}
   virtual void onComplete(int t) {}
   virtual void onDelay() {}
+  virtual void onDiscard() {}  // instead of onPostExecute
 };
 
+// The listeners of a dynamic search, notified in the order they were added.
+class ListenerList {
+  list<ExecutionListener*> &listeners;
+  typedef list<ExecutionListener*>::iterator iterator;
+public:
+  ListenerList(list<ExecutionListener*> &ls) : listeners(ls) {}
+  void onPreExecute() {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onPreExecute();
+  }
+  void onPostExecute() {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onPostExecute();
+  }
+  void onPause(int t) {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onPause(t);
+  }
+  void onResume(int t) {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onResume(t);
+  }
+  void onComplete(int t) {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onComplete(t);
+  }
+  void onDelay() {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onDelay();
+  }
+  void onDiscard() {
+    for (iterator l = listeners.begin(); l != listeners.end(); ++l) (*l)->onDiscard();
+  }
+};
+
+// The listeners of a static search, fixed at compile time, e.g.
+// StaticListeners<ViolinListener,TraceRecorder>(v,r): each event calls each
+// of them in order, directly, and inline where their classes are final.
+template<typename... Ls> class StaticListeners;
+
+template<> class StaticListeners<> {
+public:
+  void onPreExecute() {}
+  void onPostExecute() {}
+  void onPause(int t) {}
+  void onResume(int t) {}
+  void onComplete(int t) {}
+  void onDelay() {}
+  void onDiscard() {}
+};
+
+template<typename L, typename... Ls>
+class StaticListeners<L,Ls...> {
+  L &head;
+  StaticListeners<Ls...> tail;
+public:
+  StaticListeners(L &l, Ls&... ls) : head(l), tail(ls...) {}
+  void onPreExecute() { head.onPreExecute(); tail.onPreExecute(); }
+  void onPostExecute() { head.onPostExecute(); tail.onPostExecute(); }
+  void onPause(int t) { head.onPause(t); tail.onPause(t); }
+  void onResume(int t) { head.onResume(t); tail.onResume(t); }
+  void onComplete(int t) { head.onComplete(t); tail.onComplete(t); }
+  void onDelay() { head.onDelay(); tail.onDelay(); }
+  void onDiscard() { head.onDiscard(); tail.onDiscard(); }
+};
+
+/*****************************************************************************/
+/** BUDGETS AND PROGRESS                                                    **/
+/*****************************************************************************/
+
+// A search stops after max_executions schedules, resp. max_seconds, where
+// positive. Every interval seconds, where positive, it reports its progress
+// to stderr; the stats file, if named, is rewritten with each report and at
+// the end, one "key value" per line.
+struct SearchBudget {
+  uint64_t max_executions;
+  double max_seconds;
+  double interval;
+  string stats_file;
+};
+
+double seconds_since(timeval &start) {
+  timeval now;
+  gettimeofday(&now,0);
+  return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+// Rewrites the stats file of a search; returns false if it cannot.
+bool write_search_stats(string file, uint64_t executions, double elapsed,
+                        double rate, double estimate, double eta,
+                        bool complete, bool exhausted) {
+  FILE *f = fopen(file.c_str(), "w");
+  if (f == NULL) {
+    perror(file.c_str());
+    return false;
+  }
+  fprintf(f, "executions %llu\n", (unsigned long long) executions);
+  fprintf(f, "seconds %.3f\n", elapsed);
+  fprintf(f, "executions_per_second %.1f\n", rate);
+  fprintf(f, "estimated_executions %.0f\n", estimate);
+  fprintf(f, "eta_seconds %.0f\n", eta);
+  fprintf(f, "complete %d\n", complete);
+  fprintf(f, "out_of_budget %d\n", exhausted);
+  fclose(f);
+  return true;
+}
+
 class Enumerator {
 protected:
   vector<Thread> threads;
   list<ExecutionListener*> listeners;
-  enum execution_event_t { PRE_EXECUTE, POST_EXECUTE, PAUSE, RESUME, COMPLETE, DELAY };
+
+  SearchBudget budget;
+  uint64_t executions;
+  uint64_t discards;
+  bool exhausted;
+  double estimate;
+  timeval start_time;
+  double last_report;
+  vector<int> steps;
+  Fibers search_fibers;
 
 public:
-  Enumerator() {}
-  Enumerator(vector<Thread> &ts) : threads(ts) {}
+  Enumerator() : budget({0,0,0,""}), executions(0), exhausted(false), estimate(0) {}
+  // Frees the coroutines of the threads, which addThread created.
+  virtual ~Enumerator() {
+    for (vector<Thread>::iterator t = threads.begin(); t != threads.end(); ++t)
+      Coro_free(t->coro);
+  }
+
+  void setBudget(SearchBudget &b) {
+    budget = b;
+  }
+
+  // Whether the last search ran out of budget before the last schedule.
+  bool stoppedEarly() {
+    return exhausted;
+  }
+
+  // How many executions the scheduler discarded in the last search.
+  uint64_t discardedExecutions() {
+    return discards;
+  }
+
+  // The estimated number of schedules of the last search; 0 if unknown.
+  double estimatedSchedules() {
+    return estimate;
+  }
+
+  // The thread of each step of the current execution so far, which a
+  // ReplayScheduler replays.
+  vector<int> &trace() {
+    return steps;
+  }
 
   vector<Thread> &getThreads() {
     return threads;
@@ -87,88 +308,220 @@ public:
   virtual void run() = 0;
 
 protected:
-  void notify(execution_event_t event, int t=0) {
-    for (list<ExecutionListener*>::iterator l = listeners.begin();
-        l != listeners.end(); ++l) {
-      switch (event) {
-      case PRE_EXECUTE:
-        (*l)->onPreExecute();
-        break;
-      case POST_EXECUTE:
-        (*l)->onPostExecute();
-        break;
-      case PAUSE:
-        (*l)->onPause(t);
-        break;
-      case RESUME:
-        (*l)->onResume(t);
-        break;
-      case COMPLETE:
-        (*l)->onComplete(t);
-        break;
-      case DELAY:
-        (*l)->onDelay();
-        break;
-      }
+  bool outOfBudget() {
+    return (budget.max_executions > 0 && executions >= budget.max_executions)
+        || (budget.max_seconds > 0 && seconds_since(start_time) >= budget.max_seconds);
+  }
+
+  template<typename S>
+  void report(S &s, bool final) {
+    double elapsed = seconds_since(start_time);
+    if (!final && (budget.interval <= 0 || elapsed - last_report < budget.interval))
+      return;
+    if (!final)
+      last_report = elapsed;
+
+    double progress = s.progress();
+    if (final && !exhausted)
+      estimate = executions;
+    else if (progress > 0)
+      estimate = max((double) executions, executions / progress);
+    double rate = elapsed > 0 ? executions / elapsed : 0;
+    double eta = rate > 0 && estimate > 0 ? (estimate - executions) / rate : -1;
+
+    // Searches which end before their first report stay quiet.
+    if (budget.interval > 0 && (!final || last_report >= budget.interval || exhausted)) {
+      fprintf(stderr, "Progress: %llu schedules in %.0fs (%.0f/s)",
+              (unsigned long long) executions, elapsed, rate);
+      if (!final && estimate > 0)
+        fprintf(stderr, ", about %.0f in total, ETA %.0fs", estimate, eta);
+      fprintf(stderr, final ? (exhausted ? "; out of budget.\n" : "; done.\n") : ".\n");
     }
+
+    if (budget.stats_file != ""
+        && !write_search_stats(budget.stats_file, executions, elapsed, rate,
+                               estimate, final && !exhausted ? 0 : eta,
+                               final && !exhausted, exhausted))
+      budget.stats_file = "";
   }
 
+  // Notifies the added listeners, and calls the scheduler, dynamically;
+  // deletes the scheduler once done.
   int search(Scheduler *s) {
+    ListenerList l(listeners);
+    int result = search(*s, l);
+    delete s;
+    return result;
+  }
 
-    scheduler = Coro_new();
-    Coro_initializeMainCoro(scheduler);
+  // The search loop proper, for a scheduler of class S and listeners of
+  // class L; with a final S and StaticListeners, each step dispatches
+  // statically.
+  template<typename S, typename L>
+  int search(S &s, L &l) {
 
-    while (s->nextSchedule()) {
+    // Searches nest, e.g. a replay within a listener of another search.
+    Fibers *outer = fibers;
+    Fibers *f = fibers = &search_fibers;
+    f->scheduler = Coro_new();
+    Coro_initializeMainCoro(f->scheduler);
+
+    executions = 0;
+    discards = 0;
+    exhausted = false;
+    estimate = 0;
+    last_report = 0;
+    gettimeofday(&start_time,0);
+
+    while (!(exhausted = outOfBudget()) && s.nextSchedule()) {
 
       for (vector<Thread>::iterator t = threads.begin(); t != threads.end(); ++t) {
-        Coro_startCoro_(scheduler, current = t->coro, &(*t), &Thread::execute);
+        Coro_startCoro_(f->scheduler, f->current = t->coro, &(*t), &Thread::execute);
       }
+      f->blockers.clear();
+      f->woken.clear();
+      f->timed_out.assign(threads.size(),false);
+      steps.clear();
 
-      notify(PRE_EXECUTE);
+      l.onPreExecute();
 
+      bool discard = false;
       while (true) {
-        int current_thread = s->nextStep();
+        int current_thread = s.nextStep();
+
+        if (current_thread == Scheduler::DISCARD) {
+          discard = true;
+          break;
+        }
 
-        if (current_thread == Scheduler::DONE)
+        if (current_thread == Scheduler::DONE) {
+          // Threads still blocked here never complete, unless they time out.
+          if (TimeOut()) {
+            s.unblocked(f->woken.back());
+            f->woken.clear();
+            continue;
+          }
           break;
+        }
 
         if (current_thread == Scheduler::DELAY) {
-          notify(DELAY);
+          l.onDelay();
           continue;
         }
 
-        notify(RESUME,current_thread);
+        l.onResume(current_thread);
 
+        steps.push_back(current_thread);
+        f->current_index = current_thread;
         if (Resume(threads[current_thread].coro)) {
-          s->completed();
-          notify(COMPLETE,current_thread);
+          s.completed();
+          l.onComplete(current_thread);
 
         } else {
-          notify(PAUSE,current_thread);
+          if (f->blocked)
+            s.blocked();
+          l.onPause(current_thread);
         }
 
+        for (vector<int>::iterator t = f->woken.begin(); t != f->woken.end(); ++t)
+          s.unblocked(*t);
+        f->woken.clear();
+
+      }
+
+      // Threads of a discarded execution are abandoned where they are.
+      if (discard || s.discarded()) {
+        l.onDiscard();
+        discards++;
+        continue;
       }
 
-      notify(POST_EXECUTE);
+      l.onPostExecute();
+      executions++;
+      report(s,false);
     }
+    report(s,true);
+    Coro_free(f->scheduler);
+    fibers = outer;
     return 0;
   }
 };
 
+// With exact set, explores the schedules with exactly K delays only, for
+// iterative deepening over K: K goes from 0 up, and each level keeps the
+// choices of its schedules for the next; see RoundRobinScheduler. With a
+// shard set, explores only its part
+// of the schedules, and with a pool, the prefixes which it takes as one of
+// the workers of a parallel search; see RoundRobinScheduler.
 class DelayBoundedEnumerator : public Enumerator {
   int num_delays;
+  bool exact;
+  LevelChoices levels;
+  int shard;
+  int num_shards;
+  PrefixPool *pool;
+  int worker;
 public:
-  DelayBoundedEnumerator(int K) : Enumerator(), num_delays(K) { }
+  DelayBoundedEnumerator(int K)
+    : Enumerator(), num_delays(K), exact(false), shard(0), num_shards(1),
+      pool(NULL), worker(0) { }
+  void setDelays(int K, bool exactly) {
+    num_delays = K;
+    exact = exactly;
+    if (exact) {
+      levels.resize(K+1);
+      levels[K].clear();
+    }
+  }
+  void setShard(int i, int n) {
+    shard = i;
+    num_shards = n;
+  }
+  void setPool(PrefixPool *p, int w) {
+    pool = p;
+    worker = w;
+  }
+  void run() {
+    search(new RoundRobinScheduler(threads, num_delays, exact ? &levels : NULL,
+                                   shard, num_shards, pool, worker));
+  }
+  // Notifies the given listeners rather than the added ones, statically;
+  // see StaticListeners.
+  template<typename L>
+  void run(L &l) {
+    RoundRobinScheduler s(threads, num_delays, exact ? &levels : NULL,
+                          shard, num_shards, pool, worker);
+    search(s, l);
+  }
+};
+
+class ReplayEnumerator : public Enumerator {
+  vector<int> replayed;
+public:
+  ReplayEnumerator() : Enumerator() { }
+  // Executes the single schedule which follows the given trace; see
+  // ReplayScheduler.
+  void replay(const vector<int> &trace) {
+    replayed = trace;
+    run();
+  }
   void run() {
-    search(new RoundRobinScheduler(threads, num_delays));
+    search(new ReplayScheduler(threads, replayed));
   }
 };
 
 class AtomicThreadEnumerator : public Enumerator {
+  vector<int> programs;
 public:
   AtomicThreadEnumerator() : Enumerator() { }
-  AtomicThreadEnumerator(vector<Thread> &ts) : Enumerator(ts) { }
+  // Keeps the threads of each program in order; see ProgramOrderScheduler.
+  void setPrograms(const vector<int> &program_of) {
+    programs = program_of;
+  }
   void run() {
-    search(new AtomicScheduler(threads));
+    if (programs.empty())
+      search(new AtomicScheduler(threads));
+    else
+      search(new ProgramOrderScheduler(threads, programs));
   }
 };
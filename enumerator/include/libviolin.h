@@ -0,0 +1,126 @@
+/*****************************************************************************/
+/* LIBVIOLIN: the violation detector as a library, with a C API.            */
+/*****************************************************************************
+ * Usage
+ * Create a context, and check objects in it, e.g.,
+ *
+ *   violin_t *v = violin_new();
+ *   violin_config_t config;
+ *   violin_config_init(&config);
+ *   config.adds = 2; config.removes = 2; config.delays = 2;
+ *   config.order = VIOLIN_FIFO_ORDER;
+ *   violin_result_t result;
+ *   violin_check(v, &queue, NULL, &config, &result);
+ *   printf("%s", violin_output(v));
+ *   violin_delete(v);
+ *
+ * Each context keeps all the state of its checks, and checks one object at a
+ * time; checks in different contexts, on different threads, run in
+ * parallel. The operations of the object run on fibers of the calling thread,
+ * and call violin_yield wherever another operation may preempt them.
+ *
+ * Link with -lviolin, which includes the coroutine library, and the C++
+ * standard library.
+ *
+ *****************************************************************************/
+
+#ifndef LIBVIOLIN_H_
+#define LIBVIOLIN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct violin violin_t;
+
+// The value which remove returns when the object is empty.
+#define VIOLIN_EMPTY (-1)
+
+// An object under test, or the sequential specification of one for the
+// linearization modes. Its functions get its data; initialize resets it
+// before each execution. The batch functions are optional: add_batch adds
+// values[0..n-1] in order, and remove_batch removes up to n values into
+// values, returning how many.
+typedef struct {
+  void *data;
+  void (*initialize)(void *data);
+  void (*add)(void *data, int value);
+  int (*remove)(void *data);
+  void (*add_batch)(void *data, int *values, int n);
+  int (*remove_batch)(void *data, int *values, int n);
+} violin_object_t;
+
+// As violin_mode_t, violin_order_t, violin_alloc_policy_t and violin_show_t
+// in violin.h.
+enum {
+  VIOLIN_NOTHING_MODE, VIOLIN_COUNTING_MODE, VIOLIN_COUNTING_NO_VERIFY_MODE,
+  VIOLIN_LINEARIZATIONS_MODE, VIOLIN_LIN_SKIP_ATOMIC_MODE, VIOLIN_VERSUS_MODE
+};
+enum {
+  VIOLIN_NO_ORDER, VIOLIN_LIFO_ORDER, VIOLIN_FIFO_ORDER, VIOLIN_PRIORITY_ORDER
+};
+enum { VIOLIN_DEFAULT_ALLOC, VIOLIN_LRF_ALLOC, VIOLIN_MRF_ALLOC };
+enum { VIOLIN_SHOW_NONE, VIOLIN_SHOW_WINS, VIOLIN_SHOW_VIOLATIONS, VIOLIN_SHOW_ALL };
+
+// The arguments of "violin" and its settings; see violin.h.
+typedef struct {
+  int adds;
+  int removes;
+  const char *workload;       // e.g. "aar,rra"; overrides adds and removes
+  int batch_size;
+  int mode;
+  int order;
+  int alloc;
+  int barriers;
+  int delays;
+  int relaxation;
+  int show;                   // which histories go to the output
+  int deepen;                 // explore 0, 1, ... delays level by level?
+  int stop_at_violation;      // and stop at the first level with one?
+  int shrink;
+  uint64_t max_executions;    // 0 for all
+  double max_seconds;         // 0 for no limit
+} violin_config_t;
+
+typedef struct {
+  uint64_t executions;
+  uint64_t violations;
+  int out_of_budget;
+} violin_result_t;
+
+violin_t *violin_new(void);
+void violin_delete(violin_t *v);
+
+// One add and one remove in counting mode with no order, no barriers nor
+// delays, showing no histories.
+void violin_config_init(violin_config_t *config);
+
+// Checks obj in context v; spec is only needed by the linearization modes.
+// Returns 0, or -1 if the configuration is invalid.
+int violin_check(violin_t *v, const violin_object_t *obj,
+                 const violin_object_t *spec, const violin_config_t *config,
+                 violin_result_t *result);
+
+// What the last check of v printed, until the next.
+const char *violin_output(violin_t *v);
+
+// For objects under test: a preemption point, and blocking until another
+// operation wakes the same channel, or if timed, until nothing else can run;
+// violin_block returns 0 iff it timed out. See DoBlock in enumeration.h.
+void violin_yield(void);
+int violin_block(void *channel, int timed);
+void violin_wake(void *channel);
+
+// For objects under test: blocks which are reused by the allocation policy
+// of the check, rather than returned to malloc, to expose ABA.
+void *violin_allocate(size_t size);
+void violin_release(void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBVIOLIN_H_
@@ -6,6 +6,7 @@
 #include <queue>
 #include <unordered_set>
 #include <set>
+#include <map>
 #include <regex>
 
 class SequentialExecutionCollector : public ExecutionListener {
@@ -17,15 +18,16 @@ public:
   SequentialExecutionCollector(Object spec_obj, vector<Operation*> &ops, unordered_set<string> &hs)
     : spec_object(spec_obj), operations(ops), histories(hs) {}
 
+  // Each prefix is a valid history too, for the case where the remaining
+  // operations never return.
   void onPreExecute() {
     hout.str("");
     hout.clear();
     spec_object.initialize();
+    histories.insert(hout.str());
   }
   void onComplete(int t) {
     hout << operations[t]->toString() << " ";
-  }
-  void onPostExecute() {
     histories.insert(hout.str());
   }
 };
@@ -33,7 +35,8 @@ public:
 class LinearizationMonitor : public Monitor {
   Object spec_object;
   vector<Operation*> &operations;
-  vector<Operation*> &spec_operations;
+  vector<Operation*> spec_operations;
+  vector<int> spec_programs;
   unordered_set<string> valid_linear_histories;
   const bool debug = false;
 
@@ -42,17 +45,25 @@ class LinearizationMonitor : public Monitor {
   unsigned num_queries;
 
 public:
+  // The spec operations of each program, if given, run in order, as those of
+  // a thread; see ProgramOrderScheduler. The monitor takes the spec
+  // operations, and only refers to those of the object.
   LinearizationMonitor(
     Object spec_obj, vector<Operation*> &ops,
     vector<Operation*> &spec_ops, bool collect,
-    bool dont_compute_atomic_histories = false)
+    bool dont_compute_atomic_histories = false,
+    vector<int> spec_progs = vector<int>())
     : Monitor("Line-Up", collect), spec_object(spec_obj),
-      operations(ops), spec_operations(spec_ops),
+      operations(ops), spec_operations(spec_ops), spec_programs(spec_progs),
       max_num_linearizations(0), total_num_linearizations(0), num_queries(0) {
 
     if (!dont_compute_atomic_histories)
       computeSequentialHistories();
   }
+  ~LinearizationMonitor() {
+    for (int i=0; i<spec_operations.size(); i++)
+      delete spec_operations[i];
+  }
   void onPostExecute() {
     check_violations();
   }
@@ -60,9 +71,14 @@ public:
   void onReturn(Operation *op) { }
   
   string extraInfo() {
+    return info(getName(), total_num_linearizations, num_queries, max_num_linearizations);
+  }
+
+  // Also that of the shards of a search together; see violin_merge_shards.
+  static string info(string name, unsigned total, unsigned queries, unsigned max) {
     stringstream s;
-    s << getName() << " performed "
-      << avgLinearizations() << " (avg) / " << maxLinearizations() << " (max)"
+    s << name << " performed "
+      << (queries > 0 ? total / queries : 0) << " (avg) / " << max << " (max)"
       << " linearizations.";
     return s.str();
   }
@@ -78,6 +94,22 @@ public:
     return max_num_linearizations;
   }
 
+  unsigned totalLinearizations() {
+    return total_num_linearizations;
+  }
+
+  unsigned numQueries() {
+    return num_queries;
+  }
+
+  void merge(Monitor &m) {
+    Monitor::merge(m);
+    LinearizationMonitor &l = dynamic_cast<LinearizationMonitor&>(m);
+    total_num_linearizations += l.total_num_linearizations;
+    num_queries += l.num_queries;
+    max_num_linearizations = max(max_num_linearizations, l.max_num_linearizations);
+  }
+
 private:
   void computeSequentialHistories() {
     AtomicThreadEnumerator e;
@@ -85,10 +117,11 @@ private:
         op != spec_operations.end(); ++op) {
       e.addThread(&Operation::run, (void*) (*op));
     }
+    e.setPrograms(spec_programs);
     SequentialExecutionCollector sel(spec_object, spec_operations, valid_linear_histories);
     e.addListener(&sel);
 
-    cout << "Computing sequential histories... ";
+    violin_out() << "Computing sequential histories... ";
     timeval start_time, end_time;
     gettimeofday(&start_time,0);
     e.run();
@@ -98,13 +131,13 @@ private:
       difftime(end_time.tv_sec, start_time.tv_sec)*100 +
       difftime(end_time.tv_usec, start_time.tv_usec)/10000) / 100;
 
-    cout << valid_linear_histories.size() << " histories computed in " 
+    violin_out() << valid_linear_histories.size() << " histories computed in " 
          << diff << "s." << endl;
 
     if (debug) {
       for (unordered_set<string>::iterator h = valid_linear_histories.begin();
            h != valid_linear_histories.end(); ++h) {
-        cout << *h << endl;
+        violin_out() << *h << endl;
       }
     }
   }
@@ -122,8 +155,21 @@ private:
     list<Operation*> empty_seq;
     list<Operation*> ops;
     vector< list<Operation*> > linearizations;
-    for (vector<Operation*>::iterator o = operations.begin(); o != operations.end(); ++o)
-      ops.push_back(*o);
+
+    // The parts of a batch are linearized in order. Operations which never
+    // returned, since they blocked for good, took no effect and are left out.
+    vector<Operation*> parts;
+    map<Operation*,Operation*> predecessor;
+    for (vector<Operation*>::iterator o = operations.begin(); o != operations.end(); ++o) {
+      for (int p=0; p<(*o)->numParts(); p++) {
+        parts.push_back((*o)->part(p));
+        if (p > 0)
+          predecessor[(*o)->part(p)] = (*o)->part(p-1);
+      }
+    }
+    for (vector<Operation*>::iterator o = parts.begin(); o != parts.end(); ++o)
+      if ((*o)->endTime() < OMEGA)
+        ops.push_back(*o);
 
     work_list.push(make_pair(empty_seq,ops));
 
@@ -159,7 +205,9 @@ private:
 
       list<Operation*> minimals;
       for (list<Operation*>::iterator o = remaining.begin(); o != remaining.end(); ++o) {
-        if ((*o)->startTime() <= min) {
+        if ((*o)->startTime() <= min
+            && (predecessor.count(*o) == 0
+                || find(remaining.begin(), remaining.end(), predecessor[*o]) == remaining.end())) {
           minimals.push_back(*o);
         }
       }
@@ -174,9 +222,9 @@ private:
     }
     
     if (debug) {
-      cout << "[failed linearizations]" << endl;
+      violin_out() << "[failed linearizations]" << endl;
       for (list<string>::iterator i = tries.begin(); i != tries.end(); ++i)
-        cout << "X. " << (*i) << endl;
+        violin_out() << "X. " << (*i) << endl;
     }
   
     vstring = "(Lv)";
@@ -184,7 +232,7 @@ private:
     is_violation = true;
 
   DONE:
-    logHistory(new History(operations),is_violation);
+    logHistory(new History(parts),is_violation);
     total_num_linearizations += num_linearizations;
     if (num_linearizations > max_num_linearizations)
       max_num_linearizations = num_linearizations;
@@ -0,0 +1,245 @@
+/*****************************************************************************/
+/** PARALLEL SEARCH                                                         **/
+/*****************************************************************************/
+
+// The search of "violin" on several workers, each an OS thread with a
+// context, an enumerator and fibers of its own, its own copies of the
+// operations and monitors, and its own instance of the object under test;
+// see violin_set_parallel. The workers take prefixes of the schedules from a
+// PrefixPool, and steal from each other when idle (see scheduler.h).
+//
+// Each worker keeps the histories it shows, and the first violation of each
+// of its segments; once all are done, the segments are put in the serial
+// order, such that the output, the counts and the first violation are those
+// of the serial search.
+
+#include <unistd.h>
+
+// Keeps the trace of the first violation of each segment of a worker. It
+// must follow the ViolinListener, which counts the violations.
+class SegmentRecorder final : public ExecutionListener {
+  Enumerator &enumerator;
+  PrefixPool &pool;
+  const int worker;
+  int violations;
+
+public:
+  map<int,vector<int> > first_violations;   // by segment
+
+  SegmentRecorder(Enumerator &e, PrefixPool &p, int w)
+    : enumerator(e), pool(p), worker(w) { }
+
+  void onPreExecute() {
+    violations = violin_context->num_violations;
+  }
+
+  void onPostExecute() {
+    int segment = pool.segmentsOf(worker).size() - 1;
+    if (violin_context->num_violations > violations
+        && first_violations.count(segment) == 0)
+      first_violations[segment] = enumerator.trace();
+  }
+};
+
+struct ViolinParallelSearch;
+
+struct ViolinWorker {
+  int index;
+  ViolinParallelSearch *search;
+  pthread_t thread;
+  ViolinContext context;
+  stringstream out;           // e.g. of computing sequential histories
+  vector< pair<uint64_t,string> > shown;
+  map<int,vector<int> > first_violations;
+  vector<Monitor*> monitors;
+};
+
+// What the workers share: the listener of the search, whose programs they
+// copy, its objects, and the settings of its monitors.
+struct ViolinParallelSearch {
+  ViolinListener *listener;
+  Object obj;
+  Object spec_obj;
+  Workload workload;
+  violin_mode_t mode;
+  violin_order_t container_order;
+  int num_barriers;
+  int relaxation;
+  violin_show_t show;
+  int num_delays;
+  violin_alloc_policy_t allocation_policy;
+  PrefixPool *pool;
+  void (*initialize_worker)(void);
+  void (*finalize_worker)(void);
+  volatile int running;
+};
+
+void *violin_worker(void *context) {
+  ViolinWorker *w = (ViolinWorker*) context;
+  ViolinParallelSearch &p = *w->search;
+  ViolinContextScope scope(&w->context);
+  violin_allocation().policy = p.allocation_policy;
+  if (p.initialize_worker != NULL)
+    p.initialize_worker();
+
+  // The copies keep the ids of the operations, which the histories show.
+  DelayBoundedEnumerator e(p.num_delays);
+  e.setPool(p.pool, w->index);
+  ViolinListener v(p.obj, p.show);
+  v.keepShown(&w->shown);
+  for (int t=0; t<p.listener->programs.size(); t++) {
+    vector<Operation*> ops;
+    for (int i=0; i<p.listener->programs[t]->operations.size(); i++)
+      ops.push_back(p.listener->programs[t]->operations[i]->clone());
+    e.addThread(&Program::run, (void*) v.addProgram(ops));
+  }
+  violin_add_monitors(v, p.spec_obj, p.workload, p.mode, p.container_order,
+                      p.num_barriers, p.relaxation);
+
+  SegmentRecorder r(e, *p.pool, w->index);
+  StaticListeners<ViolinListener,SegmentRecorder> listeners(v, r);
+  e.run(listeners);
+
+  w->monitors.swap(v.monitors);
+  w->first_violations = r.first_violations;
+  violin_clear_alloc_pool();
+  if (p.finalize_worker != NULL)
+    p.finalize_worker();
+  __sync_fetch_and_sub(&p.running, 1);
+  return NULL;
+}
+
+// The j-th segment of a worker: its executions after begin up to end.
+struct ViolinSegment {
+  vector<int> first;
+  int worker;
+  int index;
+  uint64_t begin, end;
+  bool operator<(const ViolinSegment &s) const { return first < s.first; }
+};
+
+// Runs the search of "violin" up to num_delays delays on the workers of
+// violin_set_parallel rather than on the enumerator of v, and shows, counts
+// and records the first violation as v would. The budget applies to all
+// workers together.
+void violin_parallel_search(
+    ViolinListener &v, Object obj, Object spec_obj, Workload &workload,
+    violin_mode_t mode, violin_order_t container_order,
+    int num_barriers, int relaxation, violin_show_t show, int num_delays,
+    violin_alloc_policy_t allocation_policy) {
+
+  int num_workers = violin_context->parallel.workers;
+  SearchBudget budget = violin_context->budget;
+  timeval start_time, end_time;
+  gettimeofday(&start_time,0);
+  violin_print_enumerating(v.programs.size(), num_delays);
+
+  // The listener of the search, v, does not run: it only serves as the
+  // prototype of those of the workers, and gets their results.
+  PrefixPool pool(num_workers, num_delays, budget.max_executions);
+  ViolinParallelSearch p = {
+    &v, obj, spec_obj, workload, mode, container_order, num_barriers, relaxation,
+    show, num_delays, allocation_policy, &pool,
+    violin_context->parallel.initialize_worker,
+    violin_context->parallel.finalize_worker, num_workers
+  };
+  vector<ViolinWorker*> workers;
+  for (int i=0; i<num_workers; i++) {
+    ViolinWorker *w = new ViolinWorker();
+    w->index = i;
+    w->search = &p;
+    w->context.out = &w->out;
+    workers.push_back(w);
+    pthread_create(&w->thread, NULL, violin_worker, w);
+  }
+
+  // Reports the progress, as Enumerator::report, without an estimate.
+  double last_report = 0;
+  while (p.running > 0) {
+    usleep(1000);
+    double elapsed = seconds_since(start_time);
+    if (budget.max_seconds > 0 && elapsed >= budget.max_seconds)
+      pool.stop();
+    if (budget.interval <= 0 || elapsed - last_report < budget.interval)
+      continue;
+    last_report = elapsed;
+    uint64_t executions = pool.startedSchedules();
+    double rate = executions / elapsed;
+    fprintf(stderr, "Progress: %llu schedules in %.0fs (%.0f/s) on %d workers.\n",
+            (unsigned long long) executions, elapsed, rate, num_workers);
+    if (budget.stats_file != ""
+        && !write_search_stats(budget.stats_file, executions, elapsed, rate, 0, -1, false, false))
+      budget.stats_file = "";
+  }
+  for (int i=0; i<num_workers; i++)
+    pthread_join(workers[i]->thread, NULL);
+  gettimeofday(&end_time,0);
+
+  // The segments in the serial order, the number of the executions before
+  // each, and thus the serial number of each shown history.
+  vector<ViolinSegment> segments;
+  uint64_t executions = 0, violations = 0;
+  for (int i=0; i<num_workers; i++) {
+    vector<PrefixPool::Segment> &ss = pool.segmentsOf(i);
+    for (int j=0; j<ss.size(); j++) {
+      uint64_t end = j+1 < ss.size() ? ss[j+1].schedules : workers[i]->context.num_executions;
+      segments.push_back({ss[j].first, i, j, ss[j].schedules, end});
+    }
+    executions += workers[i]->context.num_executions;
+    violations += workers[i]->context.num_violations;
+  }
+  sort(segments.begin(), segments.end());
+  vector< vector<uint64_t> > serial(num_workers);
+  for (int i=0; i<num_workers; i++)
+    serial[i].resize(pool.segmentsOf(i).size());
+  uint64_t before = 0;
+  for (int s=0; s<segments.size(); s++) {
+    serial[segments[s].worker][segments[s].index] = before;
+    before += segments[s].end - segments[s].begin;
+  }
+
+  vector< pair<uint64_t,string> > shown;
+  for (int i=0; i<num_workers; i++) {
+    vector<PrefixPool::Segment> &ss = pool.segmentsOf(i);
+    for (int h=0, j=0; h<workers[i]->shown.size(); h++) {
+      uint64_t n = workers[i]->shown[h].first;
+      while (j+1 < ss.size() && ss[j+1].schedules < n)
+        j++;
+      shown.push_back(make_pair(serial[i][j] + n - ss[j].schedules, workers[i]->shown[h].second));
+    }
+  }
+  sort(shown.begin(), shown.end());
+  for (int h=0; h<shown.size(); h++)
+    violin_out() << violin_context->num_executions + shown[h].first << ". " << shown[h].second << endl;
+
+  violin_context->num_executions += executions;
+  violin_context->num_violations += violations;
+  for (int s=0; s<segments.size() && violin_context->shrinking; s++) {
+    map<int,vector<int> > &fs = workers[segments[s].worker]->first_violations;
+    if (fs.count(segments[s].index) > 0) {
+      v.recordViolation(fs[segments[s].index]);
+      break;
+    }
+  }
+  for (int i=0; i<num_workers; i++) {
+    for (int m=0; m<v.monitors.size(); m++) {
+      v.monitors[m]->merge(*workers[i]->monitors[m]);
+      delete workers[i]->monitors[m];
+    }
+    delete workers[i];
+  }
+
+  double seconds = seconds_between(start_time,end_time);
+  violin_context->out_of_budget = pool.stoppedEarly();
+  violin_context->search_seconds = seconds;
+  if (budget.interval > 0 && (last_report > 0 || pool.stoppedEarly()))
+    fprintf(stderr, "Progress: %llu schedules in %.0fs (%.0f/s)%s",
+            (unsigned long long) executions, seconds, seconds > 0 ? executions / seconds : 0,
+            pool.stoppedEarly() ? "; out of budget.\n" : "; done.\n");
+  if (budget.stats_file != "")
+    write_search_stats(budget.stats_file, executions, seconds,
+                       seconds > 0 ? executions / seconds : 0,
+                       pool.stoppedEarly() ? 0 : executions, pool.stoppedEarly() ? -1 : 0,
+                       !pool.stoppedEarly(), pool.stoppedEarly());
+  violin_print_search(violin_context->num_executions, seconds, pool.stoppedEarly(), 0);
+}
@@ -1,56 +1,327 @@
 class Scheduler {
 public:
-  const static int DELAY = -2, DONE = -1;
+  const static int DELAY = -2, DONE = -1, DISCARD = -3;
 public:
+  virtual ~Scheduler() {}
   virtual bool nextSchedule() = 0;
   virtual int nextStep() = 0;
   virtual void completed() = 0;
+
+  // The current thread is disabled until unblocked; see DoBlock. By default,
+  // a blocked thread is treated as completed and never runs again.
+  virtual void blocked() { completed(); }
+  virtual void unblocked(int t) { }
+
+  // The fraction of all schedules enumerated so far, as far as it can be
+  // estimated; 0 if unknown.
+  virtual double progress() { return 0; }
+
+  // Whether the execution which just ended is not to be monitored; a
+  // scheduler may also end one early by returning DISCARD.
+  virtual bool discarded() { return false; }
+};
+
+double binomial(int n, int k) {
+  if (k < 0 || k > n)
+    return 0;
+  double b = 1;
+  for (int i=1; i<=k; i++)
+    b = b * (n-k+i) / i;
+  return b;
+}
+
+// Ranks of combinations, exactly; doubles lose the low ranks of long
+// executions.
+typedef unsigned __int128 rank_t;
+
+rank_t combinations(int n, int k) {
+  if (k < 0 || k > n)
+    return 0;
+  rank_t c = 1;
+  for (int i=1; i<=k; i++)
+    c = c * (n-k+i) / i;
+  return c;
+}
+
+// The rank of the combination c[0] < ... < c[k-1] of [0,n) in lexicographic
+// order.
+rank_t combination_rank(const int *c, int k, int n) {
+  rank_t rank = 0;
+  for (int i=0, first=0; i<k; first=c[i]+1, i++)
+    for (int j=first; j<c[i]; j++)
+      rank += combinations(n-1-j, k-1-i);
+  return rank;
+}
+
+// The combination of [0,n) with the given rank, into c[0..k-1].
+void combination_unrank(rank_t rank, int *c, int k, int n) {
+  for (int i=0, x=0; i<k; i++, x++) {
+    while (rank >= combinations(n-1-x, k-1-i)) {
+      rank -= combinations(n-1-x, k-1-i);
+      x++;
+    }
+    c[i] = x;
+  }
+}
+
+// The delay-bounded schedules of a parallel search, as prefixes of their
+// delay positions, for workers to take. A prefix stands for the schedule at
+// its positions followed by consecutive ones, and for those which follow it
+// in the serial order, down to its next sibling: the prefix which delays its
+// last delay by one step more. Running a prefix thus opens the siblings of
+// each delay it used, from its own on; see RoundRobinScheduler.
+//
+// Each worker keeps the prefixes it opens on a deque of its own, and runs
+// the newest first, i.e. in the serial order. An idle worker steals the
+// oldest prefix of another, the shortest, whose subtree is the largest, and
+// starts a segment: a run of schedules which is contiguous in the serial
+// order, from the first schedule of that prefix on. Sorting the segments of
+// all workers by their first schedules thus gives the serial order.
+class PrefixPool {
+  struct Deque {
+    pthread_mutex_t lock;
+    deque< vector<int> > prefixes;
+  };
+
+public:
+  struct Segment {
+    vector<int> first;          // the delay positions of its first schedule
+    uint64_t schedules;         // those the worker ran before
+  };
+
+private:
+  vector<Deque*> deques;
+  vector< vector<Segment> > segments;
+  volatile uint64_t pending;    // prefixes opened and not run to the end
+  volatile uint64_t started;
+  uint64_t max_schedules;
+  volatile bool stopped;
+
+public:
+  PrefixPool(int num_workers, int num_delays, uint64_t max_schedules = 0)
+    : segments(num_workers), pending(1), started(0),
+      max_schedules(max_schedules), stopped(false) {
+    for (int i=0; i<num_workers; i++) {
+      Deque *d = new Deque();
+      pthread_mutex_init(&d->lock, NULL);
+      deques.push_back(d);
+    }
+    deques[0]->prefixes.push_back(vector<int>(num_delays > 0 ? 1 : 0, 0));
+  }
+
+  ~PrefixPool() {
+    for (int i=0; i<deques.size(); i++) {
+      pthread_mutex_destroy(&deques[i]->lock);
+      delete deques[i];
+    }
+  }
+
+  void push(int worker, vector<int> &prefix) {
+    __sync_fetch_and_add(&pending, 1);
+    Deque *d = deques[worker];
+    pthread_mutex_lock(&d->lock);
+    d->prefixes.push_back(prefix);
+    pthread_mutex_unlock(&d->lock);
+  }
+
+  // The worker ran a prefix taken before, and pushed those it opened.
+  void finished(int worker) {
+    __sync_fetch_and_sub(&pending, 1);
+  }
+
+  // The next prefix of the worker, its own or stolen; waits while others
+  // may still open some, and returns false once all are run, or the search
+  // stopped. Sets stolen when the prefix starts a segment.
+  bool take(int worker, vector<int> &prefix, bool &stolen) {
+    while (!stopped) {
+      stolen = false;
+      for (int i=0; i<deques.size(); i++) {
+        Deque *d = deques[(worker + i) % deques.size()];
+        pthread_mutex_lock(&d->lock);
+        bool found = !d->prefixes.empty();
+        if (found && i == 0) {
+          prefix = d->prefixes.back();
+          d->prefixes.pop_back();
+        } else if (found) {
+          prefix = d->prefixes.front();
+          d->prefixes.pop_front();
+          stolen = true;
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (!found)
+          continue;
+        uint64_t n = __sync_fetch_and_add(&started, 1);
+        if (max_schedules > 0 && n >= max_schedules) {
+          stop();
+          return false;
+        }
+        return true;
+      }
+      if (pending == 0)
+        return false;
+      sched_yield();
+    }
+    return false;
+  }
+
+  // Ends the search early, e.g. once a worker runs out of budget.
+  void stop() {
+    stopped = true;
+  }
+  bool stoppedEarly() {
+    return stopped;
+  }
+
+  // How many prefixes the workers took so far, i.e. schedules started.
+  uint64_t startedSchedules() {
+    return started;
+  }
+
+  void startSegment(int worker, vector<int> &first, uint64_t schedules) {
+    segments[worker].push_back({first, schedules});
+  }
+  vector<Segment> &segmentsOf(int worker) {
+    return segments[worker];
+  }
 };
 
-class RoundRobinScheduler : public Scheduler {
+// The choices of each schedule with exactly j delays, in the order they ran,
+// for j up to the last level run; see RoundRobinScheduler.
+typedef vector< vector<int> > LevelChoices;
+
+// With levels set, only schedules which use all num_delays delays are run,
+// e.g. for iterative deepening: delay positions then count the choices, the
+// steps at which two or more threads are enabled, so no delay is lost. A
+// schedule with k delays is one of k-1 delays, followed by another delay
+// before the end of its execution; so level k, given the choices of each
+// schedule of the levels below in the order they ran, places each delay
+// within those of the schedule which its predecessors give, and runs no
+// schedule twice. The levels run in order from 0, each recording its own.
+//
+// Shard i of n explores the i-th of n contiguous ranges of the schedules,
+// which runs independently of the others. Schedules are enumerated in
+// lexicographic order of their delay positions, each at the first positions
+// which give it: those of its delays, followed by consecutive ones. Ranking
+// these among the combinations of num_delays out of the steps of the first
+// execution, plus num_delays, with later positions clamped to the last
+// ones, keeps that order; so each shard unranks the first position of its
+// range of ranks, and runs up to the next. A shard discards the first
+// execution, which only measures the steps, unless it is its own, and those
+// from the positions it sought to until the serial order would visit them:
+// until no delay is lost before its position.
+//
+// With a pool, the scheduler runs the prefixes which a worker takes from it
+// rather than all schedules, and pushes those which each opens; see
+// PrefixPool.
+class RoundRobinScheduler final : public Scheduler {
   const int num_threads;
   const int num_delays;
+  LevelChoices *const levels;
+  vector<int> level_index;    // of the schedule of each level the first delays give
   int *delay_positions;
   deque<int> schedule;
   int step;
+  int choice;                 // steps with two or more threads enabled
   int delay_count;
+  int last_steps;
+
+  const int shard;
+  const int num_shards;
+  int num_steps;              // ranked, once the first execution ran
+  rank_t shard_begin, shard_end;
+  bool foreign;               // the current schedule is another shard's
+  bool sought;                // the current positions were unranked
+
+  PrefixPool *const pool;
+  const int worker;
+  int prefix_length;          // of the prefix taken from the pool
+  uint64_t num_schedules;
 
 public:
-  RoundRobinScheduler(vector<Thread> &ts, int delays)
-    : num_threads(ts.size()), num_delays(delays) {
+  RoundRobinScheduler(vector<Thread> &ts, int delays, LevelChoices *levels = NULL,
+                      int shard = 0, int num_shards = 1,
+                      PrefixPool *pool = NULL, int worker = 0)
+    : num_threads(ts.size()), num_delays(delays), levels(levels),
+      level_index(delays+1), shard(shard), num_shards(num_shards), pool(pool),
+      worker(worker) {
 
     delay_positions = new int[num_delays];
     delay_count = -1;
+    last_steps = 0;
+    num_steps = 0;
+    foreign = false;
+    sought = false;
+    num_schedules = 0;
+  }
+  ~RoundRobinScheduler() {
+    delete[] delay_positions;
   }
 
   bool nextSchedule() {
-    if (delay_count == 0)
+    if (pool != NULL) {
+      if (!take())
+        return false;
+
+    } else if (levels != NULL) {
+      if (delay_count >= 0)
+        (*levels)[num_delays].push_back(choice);
+      if (!(delay_count < 0 ? firstOfLevel(num_delays) : nextOfLevel(num_delays)))
+        return false;
+
+    } else if (delay_count == 0)
       return false;
 
     else if (delay_count < 0) {
       for (int i=0; i<num_delays; i++)
         delay_positions[i] = i;
+      foreign = shard > 0;
+
+    } else if (num_shards > 1 && num_steps == 0 && shard > 0) {
+      if (!seek())
+        return false;
 
     } else {
+      if (num_shards > 1 && num_steps == 0)
+        rankSteps();
       delay_positions[delay_count-1]++;
       for (int i=delay_count; i<num_delays; i++)
         delay_positions[i] = delay_positions[i-1] + 1;
+      foreign = false;
+      if (num_shards > 1 && rank() >= shard_end)
+        return false;
     }
 
     delay_count = 0;
     step = 0;
+    choice = 0;
+    schedule.clear();
     for (int i=0; i<num_threads; i++)
       schedule.push_back(i);
     return true;
   }
 
   int nextStep() {
-    if (schedule.size() < 1)
+    if (sought
+        && schedule.size() <= 1
+        && delay_count < num_delays
+        && delay_positions[delay_count] > step) {
+      // The delay is lost already here, where the serial order puts it.
+      foreign = true;
+      return DISCARD;
+    }
+
+    if (schedule.size() < 1) {
+      last_steps = levels != NULL ? choice : step;
       return DONE;
-    
+    }
+
+    int position = levels != NULL ? choice : step;
+    if (schedule.size() > 1)
+      choice++;
+
     if (schedule.size() > 1
         && delay_count < num_delays
-        && delay_positions[delay_count] == step) {
+        && delay_positions[delay_count] == position) {
 
       schedule.push_back(schedule.front());
       schedule.pop_front();
@@ -66,6 +337,211 @@ public:
   void completed() {
     schedule.pop_front();
   }
+
+  void blocked() {
+    schedule.pop_front();
+  }
+
+  void unblocked(int t) {
+    schedule.push_back(t);
+  }
+
+  bool discarded() {
+    if (sought) {
+      // The delays after a lost one follow it.
+      for (int i=delay_count+1; i<num_delays; i++)
+        if (delay_positions[i] != delay_positions[i-1] + 1)
+          foreign = true;
+      sought = foreign;
+    }
+    return foreign || (levels != NULL && delay_count < num_delays);
+  }
+
+  // Schedules are enumerated in lexicographic order of their delay positions,
+  // so the rank of the current positions among all choices of num_delays out
+  // of the steps of the last execution estimates the progress; within a
+  // shard, that among the ranks of its range.
+  double progress() {
+    if (num_shards > 1) {
+      if (num_steps == 0 || shard_end <= shard_begin)
+        return 0;
+      rank_t r = rank();
+      return r <= shard_begin ? 0
+        : (double) (r - shard_begin) / (double) (shard_end - shard_begin);
+    }
+    int n = last_steps;
+    for (int i=0; i<num_delays; i++)
+      n = max(n, delay_positions[i]+1);
+    double rank = 0;
+    for (int i=0, first=0; i<num_delays; first=delay_positions[i]+1, i++)
+      for (int j=first; j<delay_positions[i]; j++)
+        rank += binomial(n-1-j, num_delays-1-i);
+    double total = binomial(n, num_delays);
+    return total > 0 ? rank / total : 0;
+  }
+
+private:
+  // The choices of the schedule of level j which the first j delays give.
+  int choicesOf(int j) {
+    vector<int> &choices = (*levels)[j];
+    return level_index[j] < choices.size() ? choices[level_index[j]] : 0;
+  }
+
+  // Moves the first j delays to the first, resp. next, schedule of level j,
+  // in lexicographic order of their positions.
+  bool firstOfLevel(int j) {
+    if (j == 0)
+      return true;
+    if (!firstOfLevel(j-1))
+      return false;
+    level_index[j] = -1;
+    return placeDelay(j);
+  }
+
+  bool nextOfLevel(int j) {
+    if (j == 0)
+      return false;
+    if (delay_positions[j-1]+1 < choicesOf(j-1)) {
+      delay_positions[j-1]++;
+      level_index[j]++;
+      return true;
+    }
+    return nextOfLevel(j-1) && placeDelay(j);
+  }
+
+  // Places delay j-1 at the first choice after the first j-1 delays, of the
+  // first schedule of level j-1, from the current one on, which has one.
+  bool placeDelay(int j) {
+    while (true) {
+      int first = j > 1 ? delay_positions[j-2]+1 : 0;
+      if (first < choicesOf(j-1)) {
+        delay_positions[j-1] = first;
+        level_index[j]++;
+        return true;
+      }
+      if (!nextOfLevel(j-1))
+        return false;
+    }
+  }
+
+  // Pushes the siblings of the delays which the last schedule used, from
+  // the last of its prefix on, such that the sibling of the last delay is
+  // the newest; then moves to the positions of the next prefix.
+  bool take() {
+    if (delay_count >= 0) {
+      for (int i=max(prefix_length-1,0); i<delay_count; i++) {
+        vector<int> sibling(delay_positions, delay_positions + i+1);
+        sibling[i]++;
+        pool->push(worker, sibling);
+      }
+      pool->finished(worker);
+    }
+
+    vector<int> prefix;
+    bool stolen;
+    if (!pool->take(worker, prefix, stolen))
+      return false;
+    prefix_length = prefix.size();
+    for (int i=0; i<num_delays; i++)
+      delay_positions[i] = i < prefix_length ? prefix[i]
+        : i > 0 ? delay_positions[i-1] + 1 : 0;
+    if (stolen || num_schedules == 0) {
+      vector<int> first(delay_positions, delay_positions + num_delays);
+      pool->startSegment(worker, first, num_schedules);
+    }
+    num_schedules++;
+    return true;
+  }
+
+  // The rank of the current positions, clamped to the ranked steps.
+  rank_t rank() {
+    vector<int> c(delay_positions, delay_positions + num_delays);
+    for (int i=0; i<num_delays; i++)
+      c[i] = min(c[i], num_steps - num_delays + i);
+    return combination_rank(c.data(), num_delays, num_steps);
+  }
+
+  // Once the first execution ran, ranks its steps, and splits the ranks
+  // among the shards.
+  void rankSteps() {
+    num_steps = step + num_delays;
+    rank_t total = combinations(num_steps, num_delays);
+    shard_begin = (total * shard + num_shards - 1) / num_shards;
+    shard_end = (total * (shard + 1) + num_shards - 1) / num_shards;
+  }
+
+  // Moves to the first positions of this shard; returns false if it has
+  // none.
+  bool seek() {
+    rankSteps();
+    if (shard_begin >= shard_end)
+      return false;
+    combination_unrank(shard_begin, delay_positions, num_delays, num_steps);
+    foreign = false;
+    sought = true;
+    return true;
+  }
+};
+
+// Called before each step of a replayed schedule, for debuggers to break on,
+// e.g. with "break replay_step if step == 42".
+void __attribute__((noinline)) replay_step(int step, int thread) {
+  asm volatile("");
+}
+
+// Replays a trace, the thread of each step, e.g. from Enumerator::trace, as
+// a single schedule. Steps of threads which are not enabled are skipped, and
+// once the trace runs out, the enabled threads run to completion in order;
+// so an edited trace, e.g. without the steps of some thread, still replays
+// to a complete execution.
+class ReplayScheduler : public Scheduler {
+  const int num_threads;
+  const vector<int> trace;
+  deque<int> enabled;
+  int next;
+  int current;
+  int step;
+
+public:
+  ReplayScheduler(vector<Thread> &ts, const vector<int> &steps)
+    : num_threads(ts.size()), trace(steps), next(-1) { }
+
+  bool nextSchedule() {
+    if (next >= 0)
+      return false;
+    next = 0;
+    step = 0;
+    enabled.clear();
+    for (int i=0; i<num_threads; i++)
+      enabled.push_back(i);
+    return true;
+  }
+
+  int nextStep() {
+    while (next < trace.size()
+        && find(enabled.begin(), enabled.end(), trace[next]) == enabled.end())
+      next++;
+    if (next < trace.size())
+      current = trace[next++];
+    else if (enabled.empty())
+      return DONE;
+    else
+      current = enabled.front();
+    replay_step(step++, current);
+    return current;
+  }
+
+  void completed() {
+    enabled.erase(find(enabled.begin(), enabled.end(), current));
+  }
+
+  void blocked() {
+    completed();
+  }
+
+  void unblocked(int t) {
+    enabled.push_back(t);
+  }
 };
 
 class AtomicScheduler : public Scheduler {
@@ -73,6 +549,7 @@ class AtomicScheduler : public Scheduler {
   vector<int> schedule;
   int *c, *o;
   int turn;
+  double num_schedules;
 
 public:
   AtomicScheduler(vector<Thread> &ts)
@@ -84,11 +561,17 @@ public:
       c[i] = 0;
       o[i] = 1;
     }
+    num_schedules = 0;
+  }
+  ~AtomicScheduler() {
+    delete[] c;
+    delete[] o;
   }
 
   bool nextSchedule() {
     turn = 0;
-    
+    num_schedules++;
+
     if (schedule.empty()) {
       for (int i=0; i<num_threads; i++)
         schedule.push_back(i);
@@ -133,4 +616,70 @@ public:
   void completed() {
     turn++;
   }
-};
\ No newline at end of file
+
+  // All num_threads! permutations.
+  double progress() {
+    double total = 1;
+    for (int i=2; i<=num_threads; i++)
+      total *= i;
+    return (num_schedules-1) / total;
+  }
+};
+
+// Like AtomicScheduler, but the threads are grouped into programs, whose
+// threads keep the order of their indices: it explores the interleavings of
+// the programs rather than all permutations of the threads. The program of
+// each thread is given, numbered from 0 in the order of the threads, such
+// that the threads of a program are consecutive.
+class ProgramOrderScheduler : public Scheduler {
+  const int num_threads;
+  vector<int> programs;   // the program of each turn
+  vector<int> first;      // the first thread of each program
+  vector<int> schedule;
+  int turn;
+  double num_schedules;
+  double total;
+
+public:
+  ProgramOrderScheduler(vector<Thread> &ts, const vector<int> &program_of)
+    : num_threads(ts.size()), programs(program_of), num_schedules(0) {
+
+    for (int t=0; t<num_threads; t++)
+      if (t == 0 || program_of[t] != program_of[t-1])
+        first.push_back(t);
+    sort(programs.begin(), programs.end());
+
+    // The multinomial coefficient of the program lengths.
+    total = 1;
+    for (int t=0, n=0; t<num_threads; t++) {
+      n = t > 0 && program_of[t] == program_of[t-1] ? n+1 : 1;
+      total = total * (t+1) / n;
+    }
+  }
+
+  bool nextSchedule() {
+    turn = 0;
+    if (num_schedules++ > 0 && !next_permutation(programs.begin(), programs.end()))
+      return false;
+    vector<int> next(first);
+    schedule.clear();
+    for (int i=0; i<num_threads; i++)
+      schedule.push_back(next[programs[i]]++);
+    return num_threads > 0;
+  }
+
+  int nextStep() {
+    if (turn >= num_threads)
+      return DONE;
+
+    return schedule[turn];
+  }
+
+  void completed() {
+    turn++;
+  }
+
+  double progress() {
+    return (num_schedules-1) / total;
+  }
+};
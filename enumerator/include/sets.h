@@ -0,0 +1,202 @@
+/*****************************************************************************/
+/** SETS                                                                    **/
+/*****************************************************************************/
+
+enum set_method_t { SET_INSERT, SET_REMOVE, SET_CONTAINS };
+
+struct SetObject {
+  void (*initialize)(void);
+  bool (*insert)(int k);
+  bool (*remove)(int k);
+  bool (*contains)(int k);
+};
+
+class SetOperation : public Operation {
+  set_method_t method;
+  bool (*setFn)(int);
+  int key;
+  int result;
+public:
+  SetOperation(set_method_t m, bool (*fn)(int), int k)
+    : Operation(), method(m), setFn(fn), key(k), result(UNKNOWN_VAL) {}
+  set_method_t getMethod() const { return method; }
+  int getKey() const { return key; }
+  int getResult() const { return result; }
+  bool equivalent(const Operation &o) const {
+    const SetOperation *s = dynamic_cast<const SetOperation*>(&o);
+    return s && s->method == method && s->key == key && s->result == result;
+  }
+  void reset() { Operation::reset(); result = UNKNOWN_VAL; }
+  void setResult(int r) { result = r; }
+  void run() {
+    result = setFn(key);
+  }
+  string methodString() {
+    switch (method) {
+    case SET_INSERT: return "Ins";
+    case SET_REMOVE: return "Del";
+    default: return "Has";
+    }
+  }
+  string callString() {
+    stringstream s;
+    s << id << ":" << methodString() << "(" << key << ")?";
+    return s.str();
+  }
+  string retString() {
+    stringstream s;
+    s << id << ":" << methodString() << "(" << key << ")!" << (result ? "T" : "F");
+    return s.str();
+  }
+  string toString() {
+    stringstream s;
+    s << methodString() << "(" << key << ")";
+    if (result != UNKNOWN_VAL) s << "=" << (result ? "T" : "F");
+    return s.str();
+  }
+  Operation * clone() {
+    SetOperation *c = new SetOperation(method,setFn,key);
+    c->copy(*this);
+    c->result = result;
+    return c;
+  }
+};
+
+/*****************************************************************************/
+/** COUNTING FOR SETS                                                       **/
+/*****************************************************************************
+ * Keys are independent, so a set history is linearizable iff its projection
+ * to each key is; each key is a register which is either present or absent.
+ * In any linearization, the successful inserts and removes of a key
+ * alternate, starting with an insert. Hence it is a violation when, at some
+ * time, two more inserts certainly completed than removes possibly started
+ * (or one more remove than inserts); and an operation which observed the
+ * key absent (Has=F, Ins=T, Del=F) over [i,j] is a violation when more
+ * inserts certainly completed before i than removes possibly started by j,
+ * and dually for operations which observed it present. The check takes
+ * O(N^2) per key for N intervals.
+ *****************************************************************************/
+
+class SetCountingMonitor : public CountingMonitor {
+  const int num_keys;
+  bool check_violations_enabled;
+
+public:
+  SetCountingMonitor(int N, int K, bool verify, bool collect)
+    : CountingMonitor(N,(9*K+1),collect),
+      num_keys(K),
+      check_violations_enabled(verify)
+    { }
+  void onPostExecute() {
+    if (vstring == "" && check_violations_enabled)
+      check_violations();
+    CountingMonitor::onPostExecute();
+  }
+
+private:
+
+  // THE NUMBERING
+  // idx        operation
+  // --------------------
+  // 9(k-1)     ins(k)=F
+  // 9(k-1)+1   ins(k)=T
+  // 9(k-1)+2   ins(k)?
+  // 9(k-1)+3   del(k)=F
+  // ...
+  // 9(k-1)+8   has(k)?
+  // 9K         ???
+
+  int key_method(int k, set_method_t m, int r, bool pending=false) {
+    if (k < 1 || k > num_keys) return 9 * num_keys;
+    return 9 * (k-1) + 3 * m + (pending ? 2 : (r ? 1 : 0));
+  }
+
+  int method(Operation *op) {
+    SetOperation *s = dynamic_cast<SetOperation*>(op);
+    if (s) return key_method(s->getKey(), s->getMethod(), s->getResult(),
+                             s->endTime() == OMEGA);
+    return 9 * num_keys;
+  }
+
+  // How many operations of method m certainly returned before interval i,
+  // for each i?
+  vector<int> ending_before(int m) {
+    vector<int> count(interval_bound+1,0);
+    for (int i=1; i<=interval_bound; i++) {
+      count[i] = count[i-1];
+      for (int a=0; a<i; a++)
+        count[i] += counters[idx(m,a,i-1)];
+    }
+    return count;
+  }
+
+  // How many operations of method m possibly started by interval j, for
+  // each j?
+  vector<int> starting_by(int m) {
+    vector<int> count(interval_bound,0);
+    for (int j=0; j<interval_bound; j++) {
+      count[j] = j > 0 ? count[j-1] : 0;
+      for (int b=j; b<=interval_bound; b++)
+        count[j] += counters[idx(m,j,b)];
+    }
+    return count;
+  }
+
+  bool state_violation(int k) {
+    vector<int>
+      ins_before = ending_before(key_method(k,SET_INSERT,true)),
+      del_before = ending_before(key_method(k,SET_REMOVE,true)),
+      ins_by = starting_by(key_method(k,SET_INSERT,true)),
+      insp_by = starting_by(key_method(k,SET_INSERT,0,true)),
+      del_by = starting_by(key_method(k,SET_REMOVE,true)),
+      delp_by = starting_by(key_method(k,SET_REMOVE,0,true));
+
+    // Successful inserts and removes alternate: once every operation which
+    // returned before t is linearized, only those which started before t
+    // can be.
+    for (int t=1; t<=interval_bound; t++) {
+      if (ins_before[t] - del_by[t-1] - delp_by[t-1] >= 2)
+        return true;
+      if (del_before[t] - ins_by[t-1] - insp_by[t-1] >= 1)
+        return true;
+    }
+
+    const int absent[] = {
+      key_method(k,SET_CONTAINS,false),
+      key_method(k,SET_INSERT,true),
+      key_method(k,SET_REMOVE,false)
+    };
+    const int present[] = {
+      key_method(k,SET_CONTAINS,true),
+      key_method(k,SET_INSERT,false),
+      key_method(k,SET_REMOVE,true)
+    };
+
+    for (int i=0; i<interval_bound; i++) {
+      for (int j=i; j<interval_bound; j++) {
+        for (int n=0; n<3; n++) {
+          if (counters[idx(absent[n],i,j)] > 0
+              && ins_before[i] - del_by[j] - delp_by[j] >= 1)
+            return true;
+          if (counters[idx(present[n],i,j)] > 0
+              && ins_by[j] + insp_by[j] - del_before[i] <= 0)
+            return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void check_violations() {
+    for (int k = 1; k <= num_keys; k++) {
+      if (state_violation(k)) {
+        stringstream s;
+        s << "(Sv:" << k << ")";
+        vstring = s.str();
+        violationCount++;
+        return;
+      }
+    }
+  }
+
+};
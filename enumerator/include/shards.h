@@ -0,0 +1,166 @@
+/*****************************************************************************/
+/** SHARD RESULTS                                                           **/
+/*****************************************************************************/
+
+// A shard of a search (see violin_set_sharding) writes its results to a text
+// file, one tagged line each, for violin_merge_shards to combine:
+//
+//   shard I N             the shard, of how many
+//   search T K            its threads and delays
+//   line TEXT             the output before the search, e.g. the object
+//                         under test and the mode
+//   history K TEXT        the history of the K-th execution of the shard
+//   executions K
+//   seconds S
+//   estimate E            schedules in total, once out of budget
+//   out_of_budget B
+//   monitor V NAME        violations of each monitor, in order
+//   linearizations T Q M  those of the preceding Line-Up monitor
+//   shrunk TEXT           the output of shrinking the first violation
+//
+// Histories are written as they are shown, such that the file survives a
+// crash of a later execution up to its last history.
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct ShardMonitor {
+  string name;
+  uint64_t violations;
+  // Of a Line-Up monitor; see LinearizationMonitor::extraInfo.
+  bool lineup;
+  uint64_t linearizations;
+  uint64_t queries;
+  uint64_t max_linearizations;
+};
+
+struct ShardResults {
+  int shard;
+  int num_shards;
+  int num_threads;
+  int num_delays;
+  vector<string> preamble;
+  vector< pair<uint64_t,string> > histories;
+  uint64_t executions;
+  double seconds;
+  double estimate;
+  bool out_of_budget;
+  vector<ShardMonitor> monitors;
+  vector<string> shrunk;
+};
+
+class ShardWriter {
+  ofstream file;
+
+  void lines(string tag, string text) {
+    stringstream in(text);
+    string line;
+    while (getline(in,line))
+      file << tag << " " << line << endl;
+  }
+
+public:
+  bool open(string name, int shard, int num_shards) {
+    file.open(name.c_str());
+    if (!file) {
+      perror(name.c_str());
+      return false;
+    }
+    file << "shard " << shard << " " << num_shards << endl;
+    return true;
+  }
+
+  bool isOpen() {
+    return file.is_open();
+  }
+
+  void preamble(int num_threads, int num_delays, string text) {
+    file << "search " << num_threads << " " << num_delays << endl;
+    lines("line", text);
+  }
+
+  void history(uint64_t execution, string text) {
+    file << "history " << execution << " " << text << endl;
+  }
+
+  void summary(ShardResults &r) {
+    file << "executions " << r.executions << endl;
+    file << "seconds " << r.seconds << endl;
+    file << "estimate " << (uint64_t) r.estimate << endl;
+    file << "out_of_budget " << r.out_of_budget << endl;
+    for (int i=0; i<r.monitors.size(); i++) {
+      ShardMonitor &m = r.monitors[i];
+      file << "monitor " << m.violations << " " << m.name << endl;
+      if (m.lineup)
+        file << "linearizations " << m.linearizations << " "
+             << m.queries << " " << m.max_linearizations << endl;
+    }
+  }
+
+  void shrunk(string text) {
+    lines("shrunk", text);
+  }
+};
+
+// Reads the results of a shard; returns false if the file is unreadable or
+// has no summary, e.g. of a shard which did not finish.
+bool read_shard_results(string name, ShardResults &r) {
+  ifstream file(name.c_str());
+  if (!file) {
+    perror(name.c_str());
+    return false;
+  }
+  r = ShardResults();
+  r.shard = -1;
+  bool summary = false;
+  string line;
+  while (getline(file,line)) {
+    stringstream in(line);
+    string tag, text;
+    in >> tag;
+    if (tag == "shard")
+      in >> r.shard >> r.num_shards;
+    else if (tag == "search")
+      in >> r.num_threads >> r.num_delays;
+    else if (tag == "line")
+      r.preamble.push_back(line.substr(min(line.size(),tag.size()+1)));
+    else if (tag == "history") {
+      uint64_t k;
+      in >> k;
+      in.get();
+      getline(in,text);
+      r.histories.push_back(make_pair(k,text));
+    }
+    else if (tag == "executions") {
+      in >> r.executions;
+      summary = true;
+    }
+    else if (tag == "seconds")
+      in >> r.seconds;
+    else if (tag == "estimate")
+      in >> r.estimate;
+    else if (tag == "out_of_budget")
+      in >> r.out_of_budget;
+    else if (tag == "monitor") {
+      ShardMonitor m = {"", 0, false, 0, 0, 0};
+      in >> m.violations;
+      in.get();
+      getline(in,m.name);
+      r.monitors.push_back(m);
+    }
+    else if (tag == "linearizations" && !r.monitors.empty()) {
+      ShardMonitor &m = r.monitors.back();
+      m.lineup = true;
+      in >> m.linearizations >> m.queries >> m.max_linearizations;
+    }
+    else if (tag == "shrunk")
+      r.shrunk.push_back(line.substr(min(line.size(),tag.size()+1)));
+  }
+  if (r.shard < 0 || !summary) {
+    cerr << name << ": not the results of a finished shard." << endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,179 @@
+/*****************************************************************************/
+/** BINARY TRACES                                                           **/
+/*****************************************************************************/
+
+// A trace file keeps executions as the thread of each of their steps (see
+// Enumerator::trace), such that a ReplayScheduler re-executes any of them
+// directly. The file starts with the magic "VIOLINTR" and a version; each
+// record then consists of unsigned LEB128 varints:
+//
+//   execution   its number in the search, or 0 for a shrunk reproducer
+//   flags       TRACE_VIOLATION, TRACE_SHRUNK
+//   adds, removes, barriers, batch size
+//   workload    its length, then its characters, e.g. "aar,rra"; see
+//               violin_set_workload
+//   runs        how many runs of consecutive steps of one thread follow
+//   thread and number of steps, for each run
+//
+// such that a record costs a few bytes per preemption. Records of version 1
+// have no workload; theirs is the default one of their adds and removes.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+enum trace_flags_t { TRACE_VIOLATION = 1, TRACE_SHRUNK = 2 };
+
+const char TRACE_MAGIC[] = "VIOLINTR";
+const uint64_t TRACE_VERSION = 2;
+
+struct TraceRecord {
+  uint64_t execution;
+  uint64_t flags;
+  int num_adds;
+  int num_removes;
+  int num_barriers;
+  int batch_size;
+  string workload;
+  vector<int> trace;
+};
+
+class TraceWriter {
+  FILE *file;
+
+  void put(uint64_t x) {
+    while (x >= 0x80) {
+      fputc((x & 0x7f) | 0x80, file);
+      x >>= 7;
+    }
+    fputc(x, file);
+  }
+
+public:
+  TraceWriter() : file(NULL) {}
+  ~TraceWriter() {
+    if (file != NULL)
+      fclose(file);
+  }
+
+  bool open(string name) {
+    file = fopen(name.c_str(), "wb");
+    if (file == NULL) {
+      perror(name.c_str());
+      return false;
+    }
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), file);
+    put(TRACE_VERSION);
+    return true;
+  }
+
+  // Violations are flushed at once, to survive a crash of a later execution.
+  void write(TraceRecord &r) {
+    if (file == NULL)
+      return;
+    put(r.execution);
+    put(r.flags);
+    put(r.num_adds);
+    put(r.num_removes);
+    put(r.num_barriers);
+    put(r.batch_size);
+    put(r.workload.size());
+    fwrite(r.workload.data(), 1, r.workload.size(), file);
+
+    int runs = 0;
+    for (int i=0; i<r.trace.size(); i++)
+      if (i == 0 || r.trace[i] != r.trace[i-1])
+        runs++;
+    put(runs);
+    for (int i=0, j=0; i<r.trace.size(); i=j) {
+      while (j < r.trace.size() && r.trace[j] == r.trace[i])
+        j++;
+      put(r.trace[i]);
+      put(j-i);
+    }
+    if (r.flags & TRACE_VIOLATION)
+      fflush(file);
+  }
+};
+
+class TraceReader {
+  FILE *file;
+  uint64_t version;
+
+  bool get(uint64_t &x) {
+    x = 0;
+    for (int shift=0; shift<64; shift+=7) {
+      int c = fgetc(file);
+      if (c == EOF)
+        return false;
+      x |= (uint64_t) (c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool get(int &x) {
+    uint64_t y;
+    if (!get(y))
+      return false;
+    x = y;
+    return true;
+  }
+
+public:
+  TraceReader() : file(NULL), version(0) {}
+  ~TraceReader() {
+    if (file != NULL)
+      fclose(file);
+  }
+
+  bool open(string name) {
+    file = fopen(name.c_str(), "rb");
+    if (file == NULL) {
+      perror(name.c_str());
+      return false;
+    }
+    char magic[sizeof(TRACE_MAGIC)] = "";
+    if (fread(magic, 1, strlen(TRACE_MAGIC), file) != strlen(TRACE_MAGIC)
+        || strcmp(magic, TRACE_MAGIC) != 0
+        || !get(version) || version < 1 || version > TRACE_VERSION) {
+      fprintf(stderr, "%s: not a trace file of version up to %llu\n",
+              name.c_str(), (unsigned long long) TRACE_VERSION);
+      fclose(file);
+      file = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  // Returns false at the end of the file, or at a truncated record.
+  bool next(TraceRecord &r) {
+    uint64_t length, runs;
+    if (file == NULL
+        || !get(r.execution) || !get(r.flags)
+        || !get(r.num_adds) || !get(r.num_removes)
+        || !get(r.num_barriers) || !get(r.batch_size))
+      return false;
+    r.workload = "";
+    if (version >= 2) {
+      if (!get(length))
+        return false;
+      r.workload.resize(length);
+      if (length > 0 && fread(&r.workload[0], 1, length, file) != length)
+        return false;
+    }
+    if (!get(runs))
+      return false;
+    r.trace.clear();
+    for (uint64_t i=0; i<runs; i++) {
+      int thread, steps;
+      if (!get(thread) || !get(steps))
+        return false;
+      r.trace.insert(r.trace.end(), steps, thread);
+    }
+    return true;
+  }
+};
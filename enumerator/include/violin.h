@@ -25,9 +25,16 @@
  * 5. int num_removes         how many remove operations?
  * 6. violin_mode_t mode      how to monitor?
  * 7. int allocation_policy   from DEFAULT_ALLOC, LRF_ALLOC, MRF_ALLOC
- * 8. int container_order     from NO_ORDER, LIFO_ORDER, FIFO_ORDER
+ * 8. int container_order     from NO_ORDER, LIFO_ORDER, FIFO_ORDER,
+ *                            PRIORITY_ORDER
  * 9. int num_barriers        how many barriers?
  * 10. int num_delays         how many delays?
+ * 11. int relaxation         optional; counting accepts removals which
+ *                            overtake fewer than this many values (k-FIFO);
+ *                            ignored in VERSUS_MODE, whose Line-Up is strict
+ * 12. int batch_size         optional; adds and removes are issued in
+ *                            batches of this many per thread, through the
+ *                            object's add_batch and remove_batch if set
  *
  * Once the "violin" function is called, every possible delay-bounded round
  * robin schedule of `num_adds` add operations followed by `num_removes`
@@ -35,9 +42,38 @@
  * linearizability violation observable with up to `num_barriers` barries
  * witnessed by some execution will be reported.
  *
+ * Sets are checked likewise with the "violin_set" function, which takes a
+ * SetObject with insert, remove and contains functions on integer keys, and
+ * monitors with per-key counting; see sets.h.
+ *
+ * Long searches can be bounded, and report their progress, through
+ * "violin_set_budget" before the call; see SearchBudget in enumeration.h. A
+ * search which runs out of budget reports the violations seen so far.
+ * With "violin_set_deepening", the delay bound is deepened iteratively: level
+ * k explores only the schedules with exactly k delays, for k up to
+ * num_delays, optionally stopping at the first level with a violation.
+ * With "violin_set_shrinking", the first violating execution of "violin" is
+ * then shrunk to a smallest reproducer: fewer operations, delays and
+ * barriers, replaying each candidate schedule; see violin_shrink.
+ * With "violin_set_recording", the schedules of its executions are written
+ * to a binary trace file, from which "violin_replay_trace" re-executes one
+ * directly; see traces.h.
+ * With "violin_set_workload", each thread of "violin" runs a sequence of
+ * adds and removes in program order, rather than a single one, such that
+ * the schedules grow with the threads rather than the operations.
+ * With "violin_set_sharding", "violin" explores one of several parts of the
+ * schedules, for "violin_merge_shards" to combine; with "violin_set_parallel",
+ * it explores them all on several worker threads, which steal prefixes of
+ * the schedules from each other; see parallel.h.
+ *
+ * All these settings, the counts and the output are those of the current
+ * ViolinContext; an OS thread which installs a context of its own checks
+ * independently of the others. See libviolin.h for a C API.
+ *
  *****************************************************************************/
 
 #include <iostream>
+#include <map>
 #include <vector>
 #include <queue>
 #include <unordered_set>
@@ -45,27 +81,168 @@
 
 #include "enumeration.h"
 #include "allocation.h"
+#include "traces.h"
+#include "shards.h"
 
 using namespace std;
 
-enum violin_order_t { NO_ORDER, LIFO_ORDER, FIFO_ORDER };
+// PRIORITY_ORDER removes the smallest value first.
+enum violin_order_t { NO_ORDER, LIFO_ORDER, FIFO_ORDER, PRIORITY_ORDER };
 enum violin_mode_t { NOTHING_MODE, COUNTING_MODE, COUNTING_NO_VERIFY_MODE, LINEARIZATIONS_MODE, LIN_SKIP_ATOMIC_MODE, VERSUS_MODE };
 enum violin_show_t { SHOW_NONE, SHOW_WINS, SHOW_VIOLATIONS, SHOW_ALL };
 
 const int OMEGA = 9999;
 const int EMPTY_VAL = -1;
 const int UNKNOWN_VAL = -2;
-int num_executions;
-int num_violations;
+
+class ViolinListener;
+
+// All state of the checks of "violin" and friends: their settings, counts,
+// allocation pool and output. Each OS thread checks in its own current
+// context, the default one unless it installs another, e.g. with a
+// ViolinContextScope; so checks in different contexts run in parallel.
+struct ViolinContext {
+  int num_executions;
+  int num_violations;
+  bool out_of_budget;         // whether the last search stopped early
+  double search_seconds;      // and how long it took
+  SearchBudget budget;
+  struct {
+    bool enabled;
+    bool stop_at_violation;
+  } deepening;
+  bool shrinking;
+  struct {
+    string file;
+    bool violations_only;
+  } recording;
+  struct {
+    int shard;
+    int num_shards;
+    string results;
+    string header;
+  } sharding;
+  struct {
+    int workers;
+    void (*initialize_worker)(void);
+    void (*finalize_worker)(void);
+  } parallel;
+  vector<string> workload;    // see Workload
+  ViolinAllocation allocation;
+  ostream *out;
+
+  // The replays of violin_replay, set up once per workload and barriers.
+  map<pair<string,int>,pair<ReplayEnumerator*,ViolinListener*> > replays;
+
+  ViolinContext()
+    : num_executions(0), num_violations(0), out_of_budget(false),
+      search_seconds(0), budget({0,0,0,""}), deepening({false,false}),
+      shrinking(false), recording({"",false}), sharding({0,1,"",""}),
+      parallel({1,NULL,NULL}), out(&cout) {}
+};
+
+ViolinContext violin_default_context;
+__thread ViolinContext *violin_context = &violin_default_context;
+
+ViolinAllocation &violin_allocation() {
+  return violin_context->allocation;
+}
+
+ostream &violin_out() {
+  return *violin_context->out;
+}
+
+// Installs a context for the current OS thread, until the end of the scope.
+class ViolinContextScope {
+  ViolinContext *outer;
+public:
+  ViolinContextScope(ViolinContext *c) : outer(violin_context) {
+    violin_context = c;
+  }
+  ~ViolinContextScope() {
+    violin_context = outer;
+  }
+};
+
+void violin_set_budget(uint64_t max_executions, double max_seconds,
+                       double progress_interval, string stats_file) {
+  violin_context->budget.max_executions = max_executions;
+  violin_context->budget.max_seconds = max_seconds;
+  violin_context->budget.interval = progress_interval;
+  violin_context->budget.stats_file = stats_file;
+}
+
+void violin_set_deepening(bool enabled, bool stop_at_violation) {
+  violin_context->deepening.enabled = enabled;
+  violin_context->deepening.stop_at_violation = stop_at_violation;
+}
+
+void violin_set_shrinking(bool enabled) {
+  violin_context->shrinking = enabled;
+}
+
+void violin_set_recording(string file, bool violations_only) {
+  violin_context->recording.file = file;
+  violin_context->recording.violations_only = violations_only;
+}
+
+// Explores shard i of n of the schedules, with no coordination with the
+// others, and writes its results to a file, if any, from which
+// violin_merge_shards prints the summary of the whole search. The header is
+// what the caller printed before, e.g. the object under test, which the
+// summary starts with too.
+void violin_set_sharding(int shard, int num_shards, string results_file,
+                         string header = "") {
+  violin_context->sharding.shard = shard;
+  violin_context->sharding.num_shards = num_shards;
+  violin_context->sharding.results = results_file;
+  violin_context->sharding.header = header;
+}
+
+// Searches the schedules on several workers, each an OS thread, which
+// initialize_worker and finalize_worker set up and tear down, if given, on
+// the worker: e.g. an instance of the object under test of its own, on which
+// the functions of the Object act when called on that worker. See
+// violin_parallel_search.
+void violin_set_parallel(int workers, void (*initialize_worker)(void),
+                         void (*finalize_worker)(void)) {
+  violin_context->parallel.workers = workers;
+  violin_context->parallel.initialize_worker = initialize_worker;
+  violin_context->parallel.finalize_worker = finalize_worker;
+}
+
+// Prints the totals of a search, and once out of budget, the estimated
+// number of its schedules, if known.
+void violin_print_search(uint64_t executions, float seconds,
+                         bool out_of_budget, double estimate) {
+  violin_out() << executions << " schedules enumerated in " << seconds << "s";
+  if (out_of_budget && estimate > 0)
+    violin_out() << ", out of budget; about " << (long long) estimate
+         << " schedules in total";
+  else if (out_of_budget)
+    violin_out() << ", out of budget";
+  violin_out() << "." << endl;
+}
+
+void violin_print_search(Enumerator &e, float seconds) {
+  violin_context->out_of_budget = e.stoppedEarly();
+  violin_context->search_seconds = seconds;
+  violin_print_search(violin_context->num_executions, seconds,
+                      e.stoppedEarly(), e.estimatedSchedules());
+}
 
 class Operation {
   static int unique_id;
 protected:
   int id;
   int start_time, end_time;
-  Operation() : id(unique_id++) {}
+  Operation() : id(__sync_fetch_and_add(&unique_id,1)) {}
 public:
+  virtual ~Operation() {}
   static void run(void*);
+  // Numbers the operations created from now on from 0 again, as in a fresh
+  // process, e.g. those of a replay.
+  static void resetIds() { unique_id = 0; }
   bool operator<(const Operation &o) const { return end_time < o.start_time; }
   virtual bool equivalent(const Operation &o) const = 0;
   virtual void reset() { start_time = OMEGA; end_time = OMEGA; }
@@ -86,6 +263,9 @@ public:
   }
   virtual Operation *clone() = 0;
   virtual size_t hash() const { return start_time * end_time; }
+  // Batch operations consist of parts, which monitors see one by one.
+  virtual int numParts() const { return 1; }
+  virtual Operation *part(int i) { return this; }
 };
 
 int Operation::unique_id = 0;
@@ -176,6 +356,134 @@ public:
   }
 };
 
+// A batch of adds or removes on one thread, which the object performs with
+// add_batch or remove_batch when it has them, and otherwise part by part.
+// Each part is an AddOperation or RemoveOperation of its own, spanning the
+// whole batch; the parts take effect in order, but not atomically.
+class BatchOperation : public Operation {
+  vector<Operation*> parts;
+  void (*addBatchFn)(int*,int);
+  int (*removeBatchFn)(int*,int);
+  bool is_add;
+public:
+  BatchOperation(void (*add)(int*,int), vector<Operation*> ps)
+    : Operation(), parts(ps), addBatchFn(add), removeBatchFn(NULL), is_add(true) {}
+  BatchOperation(int (*rem)(int*,int), vector<Operation*> ps)
+    : Operation(), parts(ps), addBatchFn(NULL), removeBatchFn(rem), is_add(false) {}
+  ~BatchOperation() {
+    for (int i=0; i<parts.size(); i++)
+      delete parts[i];
+  }
+  int numParts() const { return parts.size(); }
+  Operation *part(int i) { return parts[i]; }
+  bool equivalent(const Operation &o) const {
+    const BatchOperation *b = dynamic_cast<const BatchOperation*>(&o);
+    if (!b || b->parts.size() != parts.size()) return false;
+    for (int i=0; i<parts.size(); i++)
+      if (!parts[i]->equivalent(*b->parts[i])) return false;
+    return true;
+  }
+  void reset() {
+    Operation::reset();
+    for (int i=0; i<parts.size(); i++) parts[i]->reset();
+  }
+  void start(int t) {
+    Operation::start(t);
+    for (int i=0; i<parts.size(); i++) parts[i]->start(t);
+  }
+  void unend() {
+    Operation::unend();
+    for (int i=0; i<parts.size(); i++) parts[i]->unend();
+  }
+  void end(int t) {
+    Operation::end(t);
+    for (int i=0; i<parts.size(); i++) parts[i]->end(t);
+  }
+  void run() {
+    int n = parts.size();
+    vector<int> vs(n);
+    if (is_add && addBatchFn) {
+      for (int i=0; i<n; i++)
+        vs[i] = ((AddOperation*) parts[i])->getParameter();
+      addBatchFn(&vs[0],n);
+    } else if (!is_add && removeBatchFn) {
+      int k = removeBatchFn(&vs[0],n);
+      for (int i=0; i<n; i++)
+        ((RemoveOperation*) parts[i])->setResult(i < k ? vs[i] : EMPTY_VAL);
+    } else {
+      for (int i=0; i<n; i++)
+        parts[i]->run();
+    }
+  }
+  string partsString() {
+    stringstream s;
+    for (int i=0; i<parts.size(); i++) {
+      if (i > 0) s << ",";
+      if (is_add) {
+        s << ((AddOperation*) parts[i])->getParameter();
+        continue;
+      }
+      int r = ((RemoveOperation*) parts[i])->getResult();
+      if (r == EMPTY_VAL) s << "E";
+      else if (r == UNKNOWN_VAL) s << "?";
+      else s << r;
+    }
+    return s.str();
+  }
+  string callString() {
+    stringstream s;
+    s << id << (is_add ? ":Add(" : ":Rem(") << partsString() << ")?";
+    return s.str();
+  }
+  string retString() {
+    stringstream s;
+    if (is_add)
+      s << id << ":Add(" << partsString() << ")!";
+    else
+      s << id << ":Rem!" << partsString();
+    return s.str();
+  }
+  string toString() {
+    stringstream s;
+    s << (is_add ? "Add(" : "Rem(") << partsString() << ")";
+    return s.str();
+  }
+  Operation * clone() {
+    vector<Operation*> cs;
+    for (int i=0; i<parts.size(); i++)
+      cs.push_back(parts[i]->clone());
+    BatchOperation *c = is_add
+      ? new BatchOperation(addBatchFn,cs)
+      : new BatchOperation(removeBatchFn,cs);
+    c->copy(*this);
+    return c;
+  }
+};
+
+// The operations of one thread, in program order. The thread yields between
+// two operations, such that the listener sees each return before the next
+// call, and other threads may run in between. The listener owns the
+// operations.
+class Program {
+public:
+  vector<Operation*> operations;
+  int finished;   // how many operations the thread ran
+  int returned;   // how many of those the listener saw return
+  Program(vector<Operation*> ops) : operations(ops), finished(0), returned(0) {}
+  void reset() { finished = 0; returned = 0; }
+  static void run(void*);
+};
+
+void Program::run(void *context) {
+  Program *p = (Program*) context;
+  for (int i=0; i<p->operations.size(); i++) {
+    if (i > 0)
+      Yield();
+    p->operations[i]->run();
+    p->finished = i+1;
+  }
+}
+
 // class Tick : public Operation {
 // public:
 //   Tick() : Operation() {}
@@ -205,6 +513,7 @@ bool h_order(Operation* lhs, Operation *rhs) {
   return lhs->getId() < rhs->getId();
 }
 
+// Owns copies of the operations it is made of.
 class History {
   vector<Operation*> ops;
 public:
@@ -214,6 +523,11 @@ public:
     }
     sort(ops.begin(), ops.end(), h_order);
   }
+  History(const History &h) = delete;
+  ~History() {
+    for (int i=0; i<ops.size(); i++)
+      delete ops[i];
+  }
   const Operation& operator[](int idx) const { return *ops[idx]; }
   unsigned size() const { return ops.size(); }
   bool operator==(const History &h) const { return compare(h,true); }
@@ -318,6 +632,11 @@ protected:
 public:
   Monitor(string n, bool collect)
     : name(n), violationCount(0), do_collect_histories(collect) { }
+  // The bad histories are among all of them.
+  virtual ~Monitor() {
+    for (unordered_set<History*>::iterator h = all_histories.begin(); h != all_histories.end(); ++h)
+      delete *h;
+  }
   string getName() { return name; }
   string violation() { return vstring; }
   int numViolations() { return violationCount; }
@@ -327,44 +646,120 @@ public:
   virtual void onReturn(Operation *op) {}
   unordered_set<History*> &getAllHistories() { return all_histories; }
   unordered_set<History*> &getBadHistories() { return bad_histories; }
+
+  // Adds the results of another monitor of the same kind, e.g. of a worker
+  // of a parallel search, and takes its histories.
+  virtual void merge(Monitor &m) {
+    violationCount += m.violationCount;
+    for (unordered_set<History*>::iterator h = m.all_histories.begin(); h != m.all_histories.end(); ++h)
+      logHistory(*h, m.bad_histories.count(*h) > 0);
+    m.all_histories.clear();
+    m.bad_histories.clear();
+  }
 protected:
+  // Takes h, and deletes it unless it is new.
   void logHistory(History *h, bool is_bad = false) {
-    if (!do_collect_histories) return;
+    if (!do_collect_histories || !all_histories.insert(h).second) {
+      delete h;
+      return;
+    }
     if (is_bad) bad_histories.insert(h);
-    all_histories.insert(h);
   }
 };
 
+// The batch functions are optional: add_batch adds vs[0..n-1] in order, and
+// remove_batch removes up to n values into vs, returning how many.
 struct Object {
   void (*initialize)(void);
   void (*add)(int v);
   int (*remove)(void);
+  void (*add_batch)(int *vs, int n);
+  int (*remove_batch)(int *vs, int n);
 };
 
 #include "counting.h"
 #include "containers.h"
+#include "sets.h"
 #include "linearization.h"
 
-class ViolinListener : public ExecutionListener {
+class ViolinListener final : public ExecutionListener {
   Object object;
   int time;
   bool return_happened;
   stringstream hout;
   violin_show_t show_histories;
   const bool deterministic_monitor;
+  Enumerator *recorder;
+  bool recorded;
+  vector<int> recorded_trace;
+  ShardWriter *results;
+  vector< pair<uint64_t,string> > *kept;
 
 public:
   vector<Operation*> operations;
+  vector<Program*> programs;
   vector<Monitor*> monitors;
 
 public:
   ViolinListener(Object obj, violin_show_t show)
-    : object(obj), deterministic_monitor(true), show_histories(show) { }
+    : object(obj), deterministic_monitor(true), show_histories(show),
+      recorder(NULL), recorded(false), results(NULL), kept(NULL) { }
+  // Owns its operations, programs and monitors.
+  ~ViolinListener() {
+    for (int i=0; i<operations.size(); i++)
+      delete operations[i];
+    for (int i=0; i<programs.size(); i++)
+      delete programs[i];
+    for (int i=0; i<monitors.size(); i++)
+      delete monitors[i];
+  }
 
   void addMonitor(Monitor *m) {
     monitors.push_back(m);
   }
 
+  // The program of the next thread, which runs ops in program order.
+  Program *addProgram(vector<Operation*> ops) {
+    Program *p = new Program(ops);
+    programs.push_back(p);
+    operations.insert(operations.end(), ops.begin(), ops.end());
+    return p;
+  }
+
+  // Keeps the trace of the first violating execution of e.
+  void recordFirstViolation(Enumerator *e) {
+    recorder = e;
+  }
+  bool hasRecordedViolation() {
+    return recorded;
+  }
+
+  // Takes the trace of the first violation found otherwise, e.g. by the
+  // workers of a parallel search.
+  void recordViolation(vector<int> &trace) {
+    recorded_trace = trace;
+    recorded = true;
+  }
+
+  // Writes the shown histories to the results of a shard too.
+  void recordResults(ShardWriter *w) {
+    results = w;
+  }
+  vector<int> &recordedTrace() {
+    return recorded_trace;
+  }
+
+  // Keeps the shown histories, by the number of their execution, rather than
+  // printing them.
+  void keepShown(vector< pair<uint64_t,string> > *histories) {
+    kept = histories;
+  }
+
+  // The history of the last execution, with its violations.
+  string history() {
+    return hout.str();
+  }
+
   void onPreExecute() {
     time = 0;
     return_happened = false;
@@ -376,6 +771,8 @@ public:
 
     for (int i = 0; i < operations.size(); i++)
       operations[i]->reset();
+    for (int i = 0; i < programs.size(); i++)
+      programs[i]->reset();
 
     for (int i = 0; i < monitors.size(); i++)
       monitors[i]->onPreExecute();
@@ -393,21 +790,38 @@ public:
       }
     }
 
-    num_executions++;
+    violin_context->num_executions++;
     if (violations > 0)
-      num_violations++;
+      violin_context->num_violations++;
+
+    if (violations > 0 && recorder != NULL && !recorded) {
+      recorded_trace = recorder->trace();
+      recorded = true;
+    }
 
     if (show_histories == SHOW_ALL
         || (show_histories == SHOW_VIOLATIONS && violations > 0)
         || (show_histories == SHOW_WINS && violations > 0 && violations != monitors.size())) {
-      cout << num_executions << ". " << hout.str() << endl;
+      if (kept != NULL)
+        kept->push_back(make_pair((uint64_t) violin_context->num_executions, hout.str()));
+      else
+        violin_out() << violin_context->num_executions << ". " << hout.str() << endl;
+      if (results != NULL)
+        results->history(violin_context->num_executions, hout.str());
     }
 
     violin_clear_alloc_pool();
   }
-  
+
+  void onDiscard() {
+    violin_clear_alloc_pool();
+  }
+
   void onResume(int t) {
-    Operation *op = operations[t];
+    Program *p = programs[t];
+    if (p->finished == p->operations.size())
+      return;
+    Operation *op = p->operations[p->finished];
     if (op->startTime() < OMEGA)
       return;
 
@@ -418,46 +832,216 @@ public:
 
     op->start(time);
     hout << op->callString() << " ";
-    for (int i=0; i<monitors.size(); i++) monitors[i]->onCall(op);
+    for (int i=0; i<monitors.size(); i++)
+      for (int p=0; p<op->numParts(); p++)
+        monitors[i]->onCall(op->part(p));
   }
 
   void onComplete(int t) {
-    Operation *op = operations[t];
-    op->end(time);
-    hout << op->retString() << " ";
-    for (int i=0; i<monitors.size(); i++) monitors[i]->onReturn(op);
-    return_happened = true;
+    programs[t]->finished = programs[t]->operations.size();
+    returnFinished(t);
+  }
+
+  void onPause(int t) {
+    returnFinished(t);
+    if (fibers->footprint)
+      hout << "@" << fibers->footprint << " ";
   }
 
   void onDelay() {
     hout << "* ";
   }
+
+private:
+  // The operations which the thread ran since it last paused return.
+  void returnFinished(int t) {
+    Program *p = programs[t];
+    for (; p->returned < p->finished; p->returned++) {
+      Operation *op = p->operations[p->returned];
+      op->end(time);
+      hout << op->retString() << " ";
+      for (int i=0; i<monitors.size(); i++)
+        for (int q=0; q<op->numParts(); q++)
+          monitors[i]->onReturn(op->part(q));
+      return_happened = true;
+    }
+  }
 };
 
-int violin(
-    Object obj,
-    Object spec_obj,
-    int num_adds,
-    int num_removes,
-    violin_mode_t mode,
-    violin_alloc_policy_t allocation_policy,
-    violin_order_t container_order,
-    int num_barriers, int num_delays,
-    violin_show_t show) {
+// Writes the trace of each execution of an enumerator, or of each violating
+// one, to a trace file. It must follow the ViolinListener, which counts the
+// violations, among the listeners.
+class TraceRecorder final : public ExecutionListener {
+  Enumerator &enumerator;
+  const bool violations_only;
+  TraceWriter writer;
+  TraceRecord record;
+  int violations;
 
-  DelayBoundedEnumerator e(num_delays);
-  ViolinListener v(obj,show);
-  e.addListener(&v);
+public:
+  TraceRecorder(Enumerator &e, bool only_violations,
+      int num_adds, int num_removes, int num_barriers, int batch_size,
+      string workload)
+    : enumerator(e), violations_only(only_violations),
+      record({0, 0, num_adds, num_removes, num_barriers, batch_size, workload, vector<int>()}) { }
 
-  for (int i=0; i<num_adds; i++) {
-    Operation *op = new AddOperation(obj.add,i+1);
-    v.operations.push_back(op);
-    e.addThread(&Operation::run, (void*) op);
+  bool open(string file) {
+    return writer.open(file);
   }
-  for (int i=0; i<num_removes; i++) {
-    Operation *op = new RemoveOperation(obj.remove);
-    v.operations.push_back(op);
-    e.addThread(&Operation::run, (void*) op);
+
+  void onPreExecute() {
+    violations = violin_context->num_violations;
+  }
+
+  void onPostExecute() {
+    bool violation = violin_context->num_violations > violations;
+    if (violations_only && !violation)
+      return;
+    record.execution = violin_context->num_executions;
+    record.flags = violation ? TRACE_VIOLATION : 0;
+    record.trace = enumerator.trace();
+    writer.write(record);
+  }
+
+  void write(TraceRecord &r) {
+    writer.write(r);
+  }
+};
+
+float seconds_between(timeval &start, timeval &end) {
+  return round(
+    difftime(end.tv_sec,start.tv_sec)*100 +
+    difftime(end.tv_usec,start.tv_usec)/10000)/100;
+}
+
+void violin_print_enumerating(int num_threads, int num_delays) {
+  violin_out() << "Enumerating schedules with "
+       << num_threads << " threads "
+       << "and " << num_delays << " delays"
+       << (violin_context->deepening.enabled ? ", by levels" : "") << "..." << endl;
+}
+
+// Runs the search of e up to num_delays delays, at once or by levels; see
+// violin_set_deepening. It notifies the listeners l statically, rather than
+// those added to e.
+template<typename L>
+void violin_search(DelayBoundedEnumerator &e, int num_delays, L &l) {
+  timeval start_time, end_time;
+  gettimeofday(&start_time,0);
+  violin_print_enumerating(e.getThreads().size(), num_delays);
+
+  if (!violin_context->deepening.enabled)
+    e.run(l);
+
+  // Each level gets what is left of the budget.
+  SearchBudget budget = violin_context->budget;
+  for (int k=0; violin_context->deepening.enabled && k<=num_delays; k++) {
+    int executions = violin_context->num_executions;
+    int violations = violin_context->num_violations;
+    timeval level_start, level_end;
+    gettimeofday(&level_start,0);
+    e.setDelays(k,true);
+    e.setBudget(budget);
+    e.run(l);
+    gettimeofday(&level_end,0);
+
+    violin_out() << "Delay bound " << k << ": "
+         << violin_context->num_executions - executions << " new schedules, "
+         << violin_context->num_violations - violations << " with violations";
+    if (e.discardedExecutions() > 0)
+      violin_out() << ", " << e.discardedExecutions() << " discarded";
+    violin_out() << ", in " << seconds_between(level_start,level_end) << "s." << endl;
+
+    if (e.stoppedEarly())
+      break;
+    if (violin_context->num_violations > violations && violin_context->deepening.stop_at_violation) {
+      violin_out() << "First violation at delay bound " << k << "." << endl;
+      break;
+    }
+    if (budget.max_executions > 0)
+      budget.max_executions -= violin_context->num_executions - executions;
+    if (budget.max_seconds > 0)
+      budget.max_seconds = max(1e-6, violin_context->budget.max_seconds - seconds_since(start_time));
+  }
+
+  gettimeofday(&end_time,0);
+  violin_print_search(e, seconds_between(start_time,end_time));
+}
+
+// A workload gives the operations of each thread in program order, as 'a'
+// for an add and 'r' for a remove, e.g. {"aar","rra"}; see
+// violin_set_workload. Adds add 1, 2, ... in the order of the threads.
+typedef vector<string> Workload;
+
+void violin_set_workload(Workload w) {
+  violin_context->workload = w;
+}
+
+// The default workload: num_adds adds, then num_removes removes, each on a
+// thread of its own, or batch_size to a thread.
+Workload violin_default_workload(int num_adds, int num_removes, int batch_size) {
+  Workload w;
+  for (int i=0; i<num_adds; i+=batch_size)
+    w.push_back(string(min(batch_size,num_adds-i),'a'));
+  for (int i=0; i<num_removes; i+=batch_size)
+    w.push_back(string(min(batch_size,num_removes-i),'r'));
+  return w;
+}
+
+// Parses threads separated by commas, e.g. "aar,rra"; returns no threads if
+// s is malformed.
+Workload violin_parse_workload(string s) {
+  Workload w;
+  stringstream in(s);
+  string thread;
+  while (getline(in,thread,',')) {
+    if (thread == "" || thread.find_first_not_of("ar") != string::npos)
+      return Workload();
+    w.push_back(thread);
+  }
+  return w;
+}
+
+string violin_workload_string(Workload &w) {
+  string s;
+  for (int i=0; i<w.size(); i++)
+    s += (i > 0 ? "," : "") + w[i];
+  return s;
+}
+
+int violin_workload_count(Workload &w, char op) {
+  int n = 0;
+  for (int i=0; i<w.size(); i++)
+    n += count(w[i].begin(), w[i].end(), op);
+  return n;
+}
+
+// Adds a thread to e and v for each thread of the workload; consecutive
+// adds, resp. removes, of a thread are grouped into batches.
+void violin_add_operations(
+    Enumerator &e, ViolinListener &v, Object obj,
+    Workload &w, int batch_size) {
+
+  Operation::resetIds();
+  int value = 1;
+  for (int t=0; t<w.size(); t++) {
+    vector<Operation*> ops;
+    for (int i=0, j=0; i<w[t].size(); i=j) {
+      vector<Operation*> parts;
+      for (j=i; j<w[t].size() && j<i+batch_size && w[t][j] == w[t][i]; j++) {
+        if (w[t][j] == 'a')
+          parts.push_back(new AddOperation(obj.add,value++));
+        else
+          parts.push_back(new RemoveOperation(obj.remove));
+      }
+      if (parts.size() == 1)
+        ops.push_back(parts[0]);
+      else if (w[t][i] == 'a')
+        ops.push_back(new BatchOperation(obj.add_batch,parts));
+      else
+        ops.push_back(new BatchOperation(obj.remove_batch,parts));
+    }
+    e.addThread(&Program::run, (void*) v.addProgram(ops));
   }
 
   // if (!deterministic_monitor) {
@@ -467,73 +1051,342 @@ int violin(
   //     e.addThread(&Operations::run, (void*) op);
   //   }
   // }
+}
 
-  alloc_policy = allocation_policy;
-
-  cout << "Violin: A Linearization-Violation Detector." << endl;;
+void violin_add_monitors(
+    ViolinListener &v, Object spec_obj, Workload &w,
+    violin_mode_t mode, violin_order_t container_order,
+    int num_barriers, int relaxation) {
 
-  switch (mode) {
-    case VERSUS_MODE: cout << "Lin-vs-counting"; break;
-    case COUNTING_NO_VERIFY_MODE: cout << "Counting-no-verify"; break;
-    case COUNTING_MODE: cout << "Counting"; break;
-    case LINEARIZATIONS_MODE: cout << "Linearization"; break;
-    case LIN_SKIP_ATOMIC_MODE: cout << "Linearization-no-atomic"; break;
-    default: cout << "Unmonitored"; break;
-  }
-  cout << " mode w/ "
-       << num_adds << " adds, "
-       << num_removes << " removes, "
-       << num_delays << " delays";
-  if (mode == COUNTING_MODE || mode == COUNTING_NO_VERIFY_MODE || mode == VERSUS_MODE)
-    cout << ", " << num_barriers << " barriers";
-  cout << "." << endl;
+  int num_adds = violin_workload_count(w,'a');
 
+  // Linearizations keep the program order, so only the interleavings of the
+  // threads are valid sequential histories.
   if (mode == LINEARIZATIONS_MODE || mode == LIN_SKIP_ATOMIC_MODE || mode == VERSUS_MODE) {
     vector<Operation*> spec_ops;
-    for (int i=0; i<num_adds; i++)
-      spec_ops.push_back(new AddOperation(spec_obj.add,i+1));
-    for (int i=0; i<num_removes; i++)
-      spec_ops.push_back(new RemoveOperation(spec_obj.remove));
+    vector<int> spec_programs;
+    for (int t=0, value=1; t<w.size(); t++) {
+      for (int i=0; i<w[t].size(); i++) {
+        if (w[t][i] == 'a')
+          spec_ops.push_back(new AddOperation(spec_obj.add,value++));
+        else
+          spec_ops.push_back(new RemoveOperation(spec_obj.remove));
+        spec_programs.push_back(t);
+      }
+    }
     v.monitors.push_back(
-      new LinearizationMonitor(spec_obj, v.operations, spec_ops, mode==VERSUS_MODE, mode==LIN_SKIP_ATOMIC_MODE));
+      new LinearizationMonitor(spec_obj, v.operations, spec_ops, mode==VERSUS_MODE, mode==LIN_SKIP_ATOMIC_MODE, spec_programs));
   }
 
   if (mode == COUNTING_MODE || mode == COUNTING_NO_VERIFY_MODE)
     v.monitors.push_back(
       new CollectionCountingMonitor(
         num_barriers+1, num_adds,
-        container_order, mode!=COUNTING_NO_VERIFY_MODE, false));
+        container_order, mode!=COUNTING_NO_VERIFY_MODE, false, relaxation));
 
+  // The barrier levels count from one stream of operations, rather than
+  // each shifting its own counters at each call and return; the first
+  // level owns it. They check the strict order, as Line-Up does, so that
+  // both judge the same histories.
   if (mode == VERSUS_MODE) {
+    CountingStream *stream = new CountingStream();
     for (int b=0; b<=num_barriers; b++) {
-      v.monitors.push_back(
-        new CollectionCountingMonitor(b+1, num_adds, container_order, true, true)
-      );
+      CollectionCountingMonitor *m =
+        new CollectionCountingMonitor(b+1, num_adds, container_order, true, true, 1);
+      m->share(stream);
+      v.monitors.push_back(m);
     }
   }
+}
 
-  timeval start_time, end_time;
-  gettimeofday(&start_time,0);
-  cout << "Enumerating schedules with "
-       << e.getThreads().size() << " threads "
-       << "and " << num_delays << " delays..." << endl;
-  e.run();
-  gettimeofday(&end_time,0);
-  
-  float diff = round(
-    difftime(end_time.tv_sec,start_time.tv_sec)*100 +
-    difftime(end_time.tv_usec,start_time.tv_usec)/10000)/100;
+#include "parallel.h"
+
+// A violating execution of "violin": its workload and barriers, and the
+// thread of each of its steps.
+struct Counterexample {
+  Workload workload;
+  int num_barriers;
+  vector<int> trace;
+  string history;
+};
+
+// How many delays the round robin schedule of the trace of num_threads
+// threads takes, i.e. the least -delays which explores it: each step of a
+// thread other than the first in the round robin order delays those before
+// it, and each thread leaves the order after its last step. Threads which
+// block leave it earlier, so theirs may take fewer.
+int violin_delays(vector<int> &trace, int num_threads) {
+  deque<int> order;
+  for (int t=0; t<num_threads; t++)
+    order.push_back(t);
+  int n = 0;
+  for (int i=0; i<trace.size(); i++) {
+    while (order.front() != trace[i]) {
+      order.push_back(order.front());
+      order.pop_front();
+      n++;
+    }
+    if (find(trace.begin()+i+1, trace.end(), trace[i]) == trace.end())
+      order.pop_front();
+  }
+  return n;
+}
+
+// Replays the trace of c on its own operations and monitors, which are set
+// up once per configuration, quietly; returns whether some monitor saw a
+// violation, and keeps the trace as executed, and its history, in c.
+bool violin_replay(
+    Object obj, Object spec_obj,
+    violin_mode_t mode, violin_order_t container_order,
+    int relaxation, int batch_size,
+    Counterexample &c) {
+
+  map<pair<string,int>,pair<ReplayEnumerator*,ViolinListener*> > &configurations =
+    violin_context->replays;
+  pair<string,int> key = make_pair(violin_workload_string(c.workload), c.num_barriers);
+  if (configurations.find(key) == configurations.end()) {
+    ReplayEnumerator *e = new ReplayEnumerator();
+    ViolinListener *v = new ViolinListener(obj,SHOW_NONE);
+    e->addListener(v);
+    violin_add_operations(*e, *v, obj, c.workload, batch_size);
+    ostream *out = violin_context->out;
+    ostream quiet(NULL);
+    violin_context->out = &quiet;
+    violin_add_monitors(*v, spec_obj, c.workload, mode, container_order, c.num_barriers, relaxation);
+    violin_context->out = out;
+    configurations[key] = make_pair(e,v);
+  }
+  ReplayEnumerator *e = configurations[key].first;
+  ViolinListener *v = configurations[key].second;
+
+  int violations = violin_context->num_violations;
+  e->replay(c.trace);
+  c.trace = e->trace();
+  c.history = v->history();
+  return violin_context->num_violations > violations;
+}
+
+// Shrinks the violating execution c greedily. Each round replays candidate
+// traces: with one operation less, and without the steps of its thread if
+// that was its only one; with the next run of a preempted thread moved up to
+// close the preemption; and with one barrier less. It keeps the first which still violates with fewer
+// operations and barriers, or as many and fewer delays, until none does. If
+// none ever does, or the violation does not replay, c is reported as it is.
+Counterexample violin_shrink(
+    Object obj, Object spec_obj,
+    violin_mode_t mode, violin_order_t container_order,
+    int relaxation, int batch_size,
+    Counterexample c) {
+
+  int executions = violin_context->num_executions;
+  int violations = violin_context->num_violations;
+  int replays = 0;
+
+  violin_out() << "Shrinking the first violation..." << endl;
+  Counterexample original = c;
+  bool shrunk = violin_replay(obj, spec_obj, mode, container_order, relaxation, batch_size, c);
+  if (!shrunk) {
+    violin_out() << "The violation does not replay, and is not shrunk." << endl;
+    c = original;
+  }
+  bool smaller = false;
+
+  while (shrunk) {
+    shrunk = false;
+
+    vector<Counterexample> candidates;
+
+    // The other steps of a thread which keeps operations replay as they
+    // can; see ReplayScheduler.
+    int num_ops = violin_workload_count(c.workload,'a') + violin_workload_count(c.workload,'r');
+    for (int t=0; num_ops > 1 && t<c.workload.size(); t++) {
+      for (int k=0; k<c.workload[t].size(); k++) {
+        if (k > 0 && c.workload[t][k] == c.workload[t][k-1])
+          continue;
+        Counterexample d = c;
+        d.workload[t].erase(k,1);
+        if (d.workload[t] == "") {
+          d.workload.erase(d.workload.begin()+t);
+          d.trace.clear();
+          for (int i=0; i<c.trace.size(); i++)
+            if (c.trace[i] != t)
+              d.trace.push_back(c.trace[i] > t ? c.trace[i]-1 : c.trace[i]);
+        }
+        candidates.push_back(d);
+      }
+    }
+
+    for (int i=0; i+1<c.trace.size(); i++) {
+      if (c.trace[i] == c.trace[i+1])
+        continue;
+      vector<int>::iterator first = find(c.trace.begin()+i+2, c.trace.end(), c.trace[i]);
+      if (first == c.trace.end())
+        continue;
+      vector<int>::iterator last = first;
+      while (last != c.trace.end() && *last == c.trace[i])
+        last++;
+      Counterexample d = c;
+      d.trace.assign(c.trace.begin(), c.trace.begin()+i+1);
+      d.trace.insert(d.trace.end(), first, last);
+      d.trace.insert(d.trace.end(), c.trace.begin()+i+1, first);
+      d.trace.insert(d.trace.end(), last, c.trace.end());
+      candidates.push_back(d);
+    }
+
+    if (c.num_barriers > 0) {
+      Counterexample d = c;
+      d.num_barriers--;
+      candidates.push_back(d);
+    }
+
+    int size = num_ops + c.num_barriers;
+    int delays = violin_delays(c.trace, c.workload.size());
+    for (int i=0; i<candidates.size() && !shrunk; i++) {
+      Counterexample &d = candidates[i];
+      replays++;
+      if (violin_replay(obj, spec_obj, mode, container_order, relaxation, batch_size, d)
+          && (violin_workload_count(d.workload,'a') + violin_workload_count(d.workload,'r')
+              + d.num_barriers < size
+              || violin_delays(d.trace, d.workload.size()) < delays)) {
+        c = d;
+        shrunk = true;
+        smaller = true;
+      }
+    }
+  }
+
+  violin_context->num_executions = executions;
+  violin_context->num_violations = violations;
+
+  int num_adds = violin_workload_count(c.workload,'a');
+  int num_removes = violin_workload_count(c.workload,'r');
+  if (smaller)
+    violin_out() << "Smallest reproducer, after " << replays << " replays: ";
+  else
+    violin_out() << "No smaller reproducer found, after " << replays << " replays: ";
+  if (c.workload != violin_default_workload(num_adds, num_removes, batch_size))
+    violin_out() << "threads " << violin_workload_string(c.workload) << ", ";
+  violin_out() << num_adds << " adds, "
+       << num_removes << " removes, "
+       << violin_delays(c.trace, c.workload.size()) << " delays";
+  if (mode == COUNTING_MODE || mode == COUNTING_NO_VERIFY_MODE || mode == VERSUS_MODE)
+    violin_out() << ", " << c.num_barriers << " barriers";
+  violin_out() << "." << endl;
+  violin_out() << "Schedule, as thread:steps runs:";
+  for (int i=0, j=0; i<c.trace.size(); i=j) {
+    while (j < c.trace.size() && c.trace[j] == c.trace[i])
+      j++;
+    violin_out() << " " << c.trace[i] << ":" << j-i;
+  }
+  violin_out() << endl;
+  if (c.history != "")
+    violin_out() << c.history << endl;
+  return c;
+}
+
+int violin(
+    Object obj,
+    Object spec_obj,
+    int num_adds,
+    int num_removes,
+    violin_mode_t mode,
+    violin_alloc_policy_t allocation_policy,
+    violin_order_t container_order,
+    int num_barriers, int num_delays,
+    violin_show_t show,
+    int relaxation = 1,
+    int batch_size = 1) {
+
+  // A workload overrides the adds and removes.
+  Workload workload = violin_context->workload;
+  if (workload.empty())
+    workload = violin_default_workload(num_adds, num_removes, batch_size);
+  num_adds = violin_workload_count(workload,'a');
+  num_removes = violin_workload_count(workload,'r');
+
+  DelayBoundedEnumerator e(num_delays);
+  e.setBudget(violin_context->budget);
+  ViolinListener v(obj,show);
+  if (violin_context->shrinking)
+    v.recordFirstViolation(&e);
+  TraceRecorder recorder(e, violin_context->recording.violations_only,
+                         num_adds, num_removes, num_barriers, batch_size,
+                         violin_workload_string(workload));
+  bool recording = violin_context->recording.file != "" && recorder.open(violin_context->recording.file);
+
+  // A shard writes its results, with what it prints before and after its
+  // search, for violin_merge_shards.
+  ShardWriter results;
+  if (violin_context->sharding.num_shards > 1)
+    e.setShard(violin_context->sharding.shard, violin_context->sharding.num_shards);
+  if (violin_context->sharding.results != "")
+    results.open(violin_context->sharding.results,
+                 violin_context->sharding.shard, violin_context->sharding.num_shards);
+  ostream *out = violin_context->out;
+  stringstream preamble;
+  if (results.isOpen())
+    violin_context->out = &preamble;
 
-  cout << num_executions << " schedules enumerated in " << diff << "s." << endl;
+  violin_add_operations(e, v, obj, workload, batch_size);
+
+  violin_allocation().policy = allocation_policy;
+
+  violin_out() << "Violin: A Linearization-Violation Detector." << endl;;
+
+  switch (mode) {
+    case VERSUS_MODE: violin_out() << "Lin-vs-counting"; break;
+    case COUNTING_NO_VERIFY_MODE: violin_out() << "Counting-no-verify"; break;
+    case COUNTING_MODE: violin_out() << "Counting"; break;
+    case LINEARIZATIONS_MODE: violin_out() << "Linearization"; break;
+    case LIN_SKIP_ATOMIC_MODE: violin_out() << "Linearization-no-atomic"; break;
+    default: violin_out() << "Unmonitored"; break;
+  }
+  violin_out() << " mode w/ ";
+  if (workload != violin_default_workload(num_adds, num_removes, batch_size))
+    violin_out() << "threads " << violin_workload_string(workload) << ", ";
+  violin_out() << num_adds << " adds, "
+       << num_removes << " removes, "
+       << num_delays << " delays";
+  if (mode == COUNTING_MODE || mode == COUNTING_NO_VERIFY_MODE || mode == VERSUS_MODE)
+    violin_out() << ", " << num_barriers << " barriers";
+  if (relaxation > 1 && mode != VERSUS_MODE)
+    violin_out() << ", relaxation " << relaxation;
+  if (batch_size > 1)
+    violin_out() << ", batches of " << batch_size;
+  violin_out() << "." << endl;
+
+  violin_add_monitors(v, spec_obj, workload, mode, container_order, num_barriers, relaxation);
+
+  if (results.isOpen()) {
+    violin_context->out = out;
+    violin_out() << preamble.str();
+    results.preamble(e.getThreads().size(), num_delays,
+                     violin_context->sharding.header + preamble.str());
+    v.recordResults(&results);
+  }
+
+  // The recorder must follow the listener, which counts the violations; a
+  // parallel search records no traces.
+  if (violin_context->parallel.workers > 1)
+    violin_parallel_search(v, obj, spec_obj, workload, mode, container_order,
+                           num_barriers, relaxation, show, num_delays,
+                           allocation_policy);
+  else if (recording) {
+    StaticListeners<ViolinListener,TraceRecorder> listeners(v,recorder);
+    violin_search(e, num_delays, listeners);
+  } else {
+    StaticListeners<ViolinListener> listeners(v);
+    violin_search(e, num_delays, listeners);
+  }
 
   for (int i=0; i<v.monitors.size(); i++) {
-    cout << v.monitors[i]->getName() << " saw "
+    violin_out() << v.monitors[i]->getName() << " saw "
          << v.monitors[i]->numViolations() << " violations";
     
     if (mode == VERSUS_MODE) {
       unordered_set<History*> &bads = v.monitors[i]->getBadHistories();
       unordered_set<History*> &all = v.monitors[i]->getAllHistories();
-      cout << " in " << bads.size() << "/" << all.size() << " histories";
+      violin_out() << " in " << bads.size() << "/" << all.size() << " histories";
       if (i > 0) {
         Monitor *lm = v.monitors[0];
         int numCovered = 0;
@@ -546,14 +1399,251 @@ int violin(
             }
           }
         }
-        cout << "; covered " << numCovered;
+        violin_out() << "; covered " << numCovered;
       }
     }
-    cout << "." << endl;
+    violin_out() << "." << endl;
     string extra = v.monitors[i]->extraInfo();
     if (extra != "")
-      cout << extra << endl;
+      violin_out() << extra << endl;
+  }
+
+  if (results.isOpen()) {
+    ShardResults r;
+    r.executions = violin_context->num_executions;
+    r.seconds = violin_context->search_seconds;
+    r.estimate = e.estimatedSchedules();
+    r.out_of_budget = e.stoppedEarly();
+    for (int i=0; i<v.monitors.size(); i++) {
+      ShardMonitor m = {v.monitors[i]->getName(), (uint64_t) v.monitors[i]->numViolations(),
+                        false, 0, 0, 0};
+      LinearizationMonitor *lm = dynamic_cast<LinearizationMonitor*>(v.monitors[i]);
+      if (lm != NULL) {
+        m.lineup = true;
+        m.linearizations = lm->totalLinearizations();
+        m.queries = lm->numQueries();
+        m.max_linearizations = lm->maxLinearizations();
+      }
+      r.monitors.push_back(m);
+    }
+    results.summary(r);
+  }
+
+  if (v.hasRecordedViolation()) {
+    stringstream shrinking;
+    if (results.isOpen())
+      violin_context->out = &shrinking;
+    Counterexample c = {workload, num_barriers, v.recordedTrace(), ""};
+    c = violin_shrink(obj, spec_obj, mode, container_order, relaxation, batch_size, c);
+    TraceRecord r = {0, TRACE_VIOLATION | TRACE_SHRUNK,
+                     violin_workload_count(c.workload,'a'), violin_workload_count(c.workload,'r'),
+                     c.num_barriers, batch_size, violin_workload_string(c.workload), c.trace};
+    recorder.write(r);
+    if (results.isOpen()) {
+      violin_context->out = out;
+      violin_out() << shrinking.str();
+      results.shrunk(shrinking.str());
+    }
+  }
+
+  return 0;
+}
+
+// Re-executes one execution of a trace file, on its own operations and with
+// the monitors of mode, and prints its history: the execution with the given
+// number, or if 0, the shrunk reproducer if any, else the first violation.
+int violin_replay_trace(
+    Object obj,
+    Object spec_obj,
+    string file,
+    uint64_t execution,
+    violin_mode_t mode,
+    violin_alloc_policy_t allocation_policy,
+    violin_order_t container_order,
+    int relaxation = 1) {
+
+  TraceReader reader;
+  if (!reader.open(file))
+    return -1;
+  TraceRecord r, found;
+  bool is_found = false;
+  while (reader.next(r)) {
+    if (execution > 0 ? r.execution == execution
+        : (r.flags & TRACE_SHRUNK) || ((r.flags & TRACE_VIOLATION) && !is_found)) {
+      found = r;
+      is_found = true;
+    }
+  }
+  if (!is_found) {
+    cerr << file << ": no "
+         << (execution > 0 ? "such execution" : "violation") << " recorded." << endl;
+    return -1;
+  }
+
+  Workload workload = found.workload != ""
+    ? violin_parse_workload(found.workload)
+    : violin_default_workload(found.num_adds, found.num_removes, found.batch_size);
+
+  ReplayEnumerator e;
+  ViolinListener v(obj,SHOW_NONE);
+  e.addListener(&v);
+  violin_add_operations(e, v, obj, workload, found.batch_size);
+  violin_allocation().policy = allocation_policy;
+
+  violin_out() << "Replaying ";
+  if (found.flags & TRACE_SHRUNK)
+    violin_out() << "the shrunk reproducer";
+  else
+    violin_out() << "execution " << found.execution;
+  violin_out() << " w/ ";
+  if (workload != violin_default_workload(found.num_adds, found.num_removes, found.batch_size))
+    violin_out() << "threads " << found.workload << ", ";
+  violin_out() << found.num_adds << " adds, "
+       << found.num_removes << " removes, "
+       << found.num_barriers << " barriers, "
+       << found.trace.size() << " steps." << endl;
+
+  violin_add_monitors(v, spec_obj, workload, mode, container_order, found.num_barriers, relaxation);
+
+  timeval start_time, end_time;
+  gettimeofday(&start_time,0);
+  e.replay(found.trace);
+  gettimeofday(&end_time,0);
+
+  violin_out() << v.history() << endl;
+  for (int i=0; i<v.monitors.size(); i++)
+    violin_out() << v.monitors[i]->getName() << " saw "
+         << v.monitors[i]->numViolations() << " violations." << endl;
+  violin_out() << "Replayed in " << seconds_between(start_time,end_time) << "s." << endl;
+  return 0;
+}
+
+// Prints the summary of a sharded search from the results of all its
+// shards, as "violin" prints that of the whole search: the histories,
+// numbered as in the whole search, the counts of all shards, and the shrunk
+// reproducer of the first violation, i.e. that of the first shard with one.
+// The history sets of versus mode are not merged, and their sizes not
+// printed. The search takes the time of its longest shard.
+int violin_merge_shards(vector<string> files) {
+  vector<ShardResults> shards(files.size());
+  for (int i=0; i<files.size(); i++)
+    if (!read_shard_results(files[i], shards[i]))
+      return -1;
+
+  bool complete = !shards.empty();
+  for (int i=0; complete && i<shards.size(); i++) {
+    ShardResults &r = shards[i];
+    complete = r.num_shards == shards.size()
+        && r.num_threads == shards[0].num_threads
+        && r.num_delays == shards[0].num_delays
+        && r.monitors.size() == shards[0].monitors.size();
+    for (int j=0; complete && j<i; j++)
+      complete = r.shard != shards[j].shard;
+  }
+  if (!complete) {
+    cerr << "Not the results of all shards of one search." << endl;
+    return -1;
+  }
+  sort(shards.begin(), shards.end(),
+       [](const ShardResults &a, const ShardResults &b) { return a.shard < b.shard; });
+
+  for (int i=0; i<shards[0].preamble.size(); i++)
+    violin_out() << shards[0].preamble[i] << endl;
+  violin_print_enumerating(shards[0].num_threads, shards[0].num_delays);
+
+  uint64_t executions = 0;
+  double seconds = 0, estimate = 0;
+  bool out_of_budget = false;
+  for (int i=0; i<shards.size(); i++) {
+    ShardResults &r = shards[i];
+    for (int j=0; j<r.histories.size(); j++)
+      violin_out() << executions + r.histories[j].first << ". " << r.histories[j].second << endl;
+    executions += r.executions;
+    seconds = max(seconds, r.seconds);
+    estimate += r.out_of_budget ? r.estimate : r.executions;
+    out_of_budget = out_of_budget || r.out_of_budget;
+  }
+  violin_print_search(executions, seconds, out_of_budget, estimate);
+
+  for (int i=0; i<shards[0].monitors.size(); i++) {
+    ShardMonitor m = shards[0].monitors[i];
+    for (int j=1; j<shards.size(); j++) {
+      ShardMonitor &n = shards[j].monitors[i];
+      m.violations += n.violations;
+      m.linearizations += n.linearizations;
+      m.queries += n.queries;
+      m.max_linearizations = max(m.max_linearizations, n.max_linearizations);
+    }
+    violin_out() << m.name << " saw " << m.violations << " violations." << endl;
+    if (m.lineup)
+      violin_out() << LinearizationMonitor::info(
+        m.name, m.linearizations, m.queries, m.max_linearizations) << endl;
+  }
+
+  for (int i=0; i<shards.size(); i++) {
+    if (shards[i].shrunk.empty())
+      continue;
+    for (int j=0; j<shards[i].shrunk.size(); j++)
+      violin_out() << shards[i].shrunk[j] << endl;
+    break;
   }
+  return 0;
+}
+
+int violin_set(
+    SetObject obj,
+    int num_keys,
+    int num_inserts,
+    int num_removes,
+    int num_contains,
+    violin_mode_t mode,
+    violin_alloc_policy_t allocation_policy,
+    int num_barriers, int num_delays,
+    violin_show_t show) {
+
+  DelayBoundedEnumerator e(num_delays);
+  e.setBudget(violin_context->budget);
+  ViolinListener v({.initialize = obj.initialize, .add = NULL, .remove = NULL,
+                    .add_batch = NULL, .remove_batch = NULL},show);
+  StaticListeners<ViolinListener> listeners(v);
+
+  // The i-th operation of each method goes to key (i mod num_keys) + 1.
+  for (int i=0; i<num_inserts; i++)
+    e.addThread(&Program::run, (void*) v.addProgram({new SetOperation(SET_INSERT,obj.insert,i%num_keys+1)}));
+  for (int i=0; i<num_removes; i++)
+    e.addThread(&Program::run, (void*) v.addProgram({new SetOperation(SET_REMOVE,obj.remove,i%num_keys+1)}));
+  for (int i=0; i<num_contains; i++)
+    e.addThread(&Program::run, (void*) v.addProgram({new SetOperation(SET_CONTAINS,obj.contains,i%num_keys+1)}));
+
+  violin_allocation().policy = allocation_policy;
+
+  violin_out() << "Violin: A Linearization-Violation Detector." << endl;
+
+  // There is no linearization monitor for sets; those modes count instead.
+  if (mode == NOTHING_MODE)
+    violin_out() << "Unmonitored";
+  else if (mode == COUNTING_NO_VERIFY_MODE)
+    violin_out() << "Counting-no-verify";
+  else
+    violin_out() << "Counting";
+  violin_out() << " set mode w/ "
+       << num_keys << " keys, "
+       << num_inserts << " inserts, "
+       << num_removes << " removes, "
+       << num_contains << " contains, "
+       << num_delays << " delays, "
+       << num_barriers << " barriers." << endl;
+
+  if (mode != NOTHING_MODE)
+    v.monitors.push_back(
+      new SetCountingMonitor(
+        num_barriers+1, num_keys, mode!=COUNTING_NO_VERIFY_MODE, false));
+
+  violin_search(e, num_delays, listeners);
+
+  for (int i=0; i<v.monitors.size(); i++)
+    violin_out() << v.monitors[i]->getName() << " saw "
+         << v.monitors[i]->numViolations() << " violations." << endl;
 
   return 0;
 }
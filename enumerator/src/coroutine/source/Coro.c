@@ -65,7 +65,12 @@ typedef struct CallbackBlock
 	CoroStartCallback *func;
 } CallbackBlock;
 
-static CallbackBlock globalCallbackBlock;
+// Thread-local, such that several threads may start coroutines at once.
+#if defined(_MSC_VER)
+static __declspec(thread) CallbackBlock globalCallbackBlock;
+#else
+static __thread CallbackBlock globalCallbackBlock;
+#endif
 
 Coro *Coro_new(void)
 {
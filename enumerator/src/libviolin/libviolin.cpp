@@ -0,0 +1,212 @@
+// The C API of libviolin (see include/libviolin.h), over "violin" in a
+// context of its own per violin_t.
+
+#include <sstream>
+
+#include "violin.h"
+#include "libviolin.h"
+
+struct violin {
+  ViolinContext context;
+  stringstream output;
+  string report;
+
+  // Those of the running check.
+  violin_object_t obj;
+  violin_object_t spec;
+};
+
+static_assert((int) VIOLIN_VERSUS_MODE == (int) VERSUS_MODE
+              && (int) VIOLIN_PRIORITY_ORDER == (int) PRIORITY_ORDER
+              && (int) VIOLIN_MRF_ALLOC == (int) MRF_ALLOC
+              && (int) VIOLIN_SHOW_ALL == (int) SHOW_ALL,
+              "the C constants of libviolin.h follow those of violin.h");
+
+namespace {
+
+// The check running on this thread; "violin" calls the plain functions
+// below, which forward to its objects.
+__thread violin_t *running;
+
+void obj_initialize() {
+  running->obj.initialize(running->obj.data);
+}
+
+void obj_add(int v) {
+  running->obj.add(running->obj.data, v);
+}
+
+int obj_remove() {
+  return running->obj.remove(running->obj.data);
+}
+
+void obj_add_batch(int *vs, int n) {
+  running->obj.add_batch(running->obj.data, vs, n);
+}
+
+int obj_remove_batch(int *vs, int n) {
+  return running->obj.remove_batch(running->obj.data, vs, n);
+}
+
+void spec_initialize() {
+  running->spec.initialize(running->spec.data);
+}
+
+void spec_add(int v) {
+  running->spec.add(running->spec.data, v);
+}
+
+int spec_remove() {
+  return running->spec.remove(running->spec.data);
+}
+
+// A violin_object_t as an Object, whose functions forward to the running
+// check's obj, or spec.
+Object as_object(const violin_object_t *o, bool spec) {
+  Object obj = {NULL, NULL, NULL, NULL, NULL};
+  if (spec) {
+    obj.initialize = spec_initialize;
+    obj.add = spec_add;
+    obj.remove = spec_remove;
+  } else {
+    obj.initialize = obj_initialize;
+    obj.add = obj_add;
+    obj.remove = obj_remove;
+    if (o->add_batch != NULL)
+      obj.add_batch = obj_add_batch;
+    if (o->remove_batch != NULL)
+      obj.remove_batch = obj_remove_batch;
+  }
+  return obj;
+}
+
+// Forgets the replays of the last check, which ran on other objects or
+// monitors.
+void clear_replays(ViolinContext &c) {
+  for (map<pair<string,int>,pair<ReplayEnumerator*,ViolinListener*> >::iterator r =
+         c.replays.begin(); r != c.replays.end(); ++r) {
+    delete r->second.first;
+    delete r->second.second;
+  }
+  c.replays.clear();
+}
+
+}  // namespace
+
+extern "C" {
+
+violin_t *violin_new(void) {
+  violin_t *v = new violin_t;
+  v->context.out = &v->output;
+  return v;
+}
+
+void violin_delete(violin_t *v) {
+  clear_replays(v->context);
+  v->context.allocation.clear();
+  delete v;
+}
+
+void violin_config_init(violin_config_t *config) {
+  config->adds = 1;
+  config->removes = 1;
+  config->workload = NULL;
+  config->batch_size = 1;
+  config->mode = VIOLIN_COUNTING_MODE;
+  config->order = VIOLIN_NO_ORDER;
+  config->alloc = VIOLIN_DEFAULT_ALLOC;
+  config->barriers = 0;
+  config->delays = 0;
+  config->relaxation = 1;
+  config->show = VIOLIN_SHOW_NONE;
+  config->deepen = 0;
+  config->stop_at_violation = 0;
+  config->shrink = 0;
+  config->max_executions = 0;
+  config->max_seconds = 0;
+}
+
+int violin_check(violin_t *v, const violin_object_t *obj,
+                 const violin_object_t *spec, const violin_config_t *config,
+                 violin_result_t *result) {
+
+  bool lin = config->mode == VIOLIN_LINEARIZATIONS_MODE
+          || config->mode == VIOLIN_LIN_SKIP_ATOMIC_MODE
+          || config->mode == VIOLIN_VERSUS_MODE;
+  if (config->mode < VIOLIN_NOTHING_MODE || config->mode > VIOLIN_VERSUS_MODE
+      || config->order < VIOLIN_NO_ORDER || config->order > VIOLIN_PRIORITY_ORDER
+      || config->alloc < VIOLIN_DEFAULT_ALLOC || config->alloc > VIOLIN_MRF_ALLOC
+      || config->show < VIOLIN_SHOW_NONE || config->show > VIOLIN_SHOW_ALL
+      || config->batch_size < 1 || config->relaxation < 1
+      || (lin && spec == NULL))
+    return -1;
+
+  Workload workload;
+  if (config->workload != NULL && *config->workload != '\0') {
+    workload = violin_parse_workload(config->workload);
+    if (workload.empty())
+      return -1;
+  }
+
+  ViolinContext &c = v->context;
+  c.num_executions = 0;
+  c.num_violations = 0;
+  c.out_of_budget = false;
+  c.budget = {config->max_executions, config->max_seconds, 0, ""};
+  c.deepening = {config->deepen != 0, config->stop_at_violation != 0};
+  c.shrinking = config->shrink != 0;
+  c.workload = workload;
+  clear_replays(c);
+  v->output.str("");
+
+  violin_t *outer = running;
+  running = v;
+  v->obj = *obj;
+  v->spec = spec != NULL ? *spec : *obj;
+  {
+    ViolinContextScope scope(&c);
+    violin(as_object(obj,false), as_object(spec,true),
+           config->adds, config->removes,
+           (violin_mode_t) config->mode,
+           (violin_alloc_policy_t) config->alloc,
+           (violin_order_t) config->order,
+           config->barriers, config->delays,
+           (violin_show_t) config->show,
+           config->relaxation, config->batch_size);
+  }
+  running = outer;
+
+  v->report = v->output.str();
+  if (result != NULL) {
+    result->executions = c.num_executions;
+    result->violations = c.num_violations;
+    result->out_of_budget = c.out_of_budget;
+  }
+  return 0;
+}
+
+const char *violin_output(violin_t *v) {
+  return v->report.c_str();
+}
+
+void violin_yield(void) {
+  DoYield();
+}
+
+int violin_block(void *channel, int timed) {
+  return DoBlock(channel, timed != 0);
+}
+
+void violin_wake(void *channel) {
+  DoWake(channel);
+}
+
+void *violin_allocate(size_t size) {
+  return violin_malloc(size);
+}
+
+void violin_release(void *p) {
+  violin_free(p);
+}
+
+}  // extern "C"
@@ -0,0 +1,355 @@
+// Native throughput benchmark for the SCAL data structures.
+//
+// Runs the objects registered in scal_initialize on real pthreads, with the
+// NoYield policy (see util/yield.h) so that no interleaving points remain,
+// and reports throughput and per-operation latency percentiles for each
+// thread count. With -payload, the items are tagged payloads of another type
+// than int (see util/payload.h); they are made before, and released after,
+// the timed operation.
+
+#include <gflags/gflags.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "scal.h"
+#include "util/malloc.h"
+#include "util/numa.h"
+#include "util/operation_logger.h"
+#include "util/payload.h"
+#include "util/platform.h"
+#include "util/threadlocals.h"
+#include "util/time.h"
+#include "util/workloads.h"
+
+DEFINE_string(objects, "", "comma-separated objects to measure (default: all)");
+DEFINE_string(threads, "1,2,4,8", "comma-separated thread counts");
+DEFINE_uint64(operations, 100000, "operations per thread");
+DEFINE_string(workload, "prodcon", "which workload? {prodcon,mixed}");
+DEFINE_int32(c, 0, "computational load between operations (calculate_pi)");
+DEFINE_bool(pin, true, "pin each thread to its own core?");
+DEFINE_string(prealloc_size, "64m", "thread-local allocation buffer per thread");
+DEFINE_uint64(batch, 1, "items per put_batch and get_batch call; 1 uses put and get");
+DEFINE_string(trace, "", "write operation logs to TRACE.OBJ.THREADS (slows the operations down)");
+DEFINE_string(payload, "int", "which items? {int,pointer,inline,moved}");
+DEFINE_uint64(payload_size, 64, "bytes per pointer, inline (16, 64 or 256) or moved item");
+DEFINE_uint64(numa_nodes, 0, "split the cores into this many NUMA nodes for NUMA-aware objects; 0=the actual ones");
+
+enum bench_role_t { PRODUCER, CONSUMER, MIXED };
+
+template<typename T>
+struct BenchRound {
+  Pool<T> *obj;
+  unsigned num_threads;
+  unsigned num_producers;
+  volatile unsigned producers_done;
+  pthread_barrier_t start_barrier;
+};
+
+template<typename T>
+struct BenchThread {
+  BenchRound<T> *round;
+  uint64_t id;
+  bench_role_t role;
+  uint64_t ops;
+  uint64_t start_time, end_time;
+  vector<uint64_t> latencies;
+  scal::TLOperationLoggerInterface<uint64_t> *log;
+  uint64_t logged_empty;
+  pthread_t handle;
+};
+
+vector<string> split(string s) {
+  vector<string> parts;
+  stringstream ss(s);
+  string part;
+  while (getline(ss, part, ','))
+    if (part != "")
+      parts.push_back(part);
+  return parts;
+}
+
+void pin_thread(uint64_t id) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(id % scal::number_of_cores(), &cpus);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+inline void compute() {
+  if (FLAGS_c > 0)
+    calculate_pi(FLAGS_c);
+}
+
+// Puts the values v..v+n-1, with one put_batch call unless n is 1.
+template<typename T>
+inline void timed_put(BenchThread<T> *t, uint64_t v, uint64_t n) {
+  typedef scal::PayloadTraits<T> Traits;
+  if (n == 1) {
+    T item = Traits::make(v, FLAGS_payload_size);
+    if (t->log) t->log->invoke(scal::kEnqueue);
+    uint64_t start = get_hwtime();
+    t->round->obj->put(std::move(item));
+    t->latencies.push_back(get_hwtime() - start);
+  } else {
+    vector<T> items;
+    items.reserve(n);
+    for (uint64_t i = 0; i < n; i++)
+      items.push_back(Traits::make(v + i, FLAGS_payload_size));
+    if (t->log) t->log->invoke(scal::kEnqueue);
+    uint64_t start = get_hwtime();
+    t->round->obj->put_batch(&items[0], n);
+    t->latencies.push_back(get_hwtime() - start);
+  }
+  if (t->log) t->log->response(true, v);
+  t->ops += n;
+}
+
+// Failed gets are logged as empty removes, up to -operations of them per
+// thread, which bounds the log of a consumer spinning on an empty object; an
+// invocation without a response is dropped. Returns how many values were got.
+template<typename T>
+inline uint64_t timed_get(BenchThread<T> *t, uint64_t n) {
+  typedef scal::PayloadTraits<T> Traits;
+  T item;
+  vector<T> items(n > 1 ? n : 0);
+  T *slots = n == 1 ? &item : &items[0];
+  if (t->log) t->log->invoke(scal::kDequeue);
+  uint64_t start = get_hwtime();
+  uint64_t got = n == 1
+    ? (t->round->obj->get(&item) ? 1 : 0)
+    : t->round->obj->get_batch(slots, n);
+  uint64_t end = get_hwtime();
+  if (got > 0) {
+    t->latencies.push_back(end - start);
+    if (t->log) t->log->response(true, Traits::tag(slots[0]));
+    t->ops += got;
+  } else if (t->log && t->logged_empty < FLAGS_operations) {
+    t->log->response(false, 0);
+    t->logged_empty++;
+  }
+  for (uint64_t i = 0; i < got; i++)
+    Traits::release(&slots[i]);
+  return got;
+}
+
+template<typename T>
+void* bench_thread(void *context) {
+  BenchThread<T> *t = (BenchThread<T>*) context;
+  BenchRound<T> *r = t->round;
+
+  scal::ThreadContext::assign_context(t->id);
+  scal::tlalloc_init(scal::human_size_to_pages(
+    FLAGS_prealloc_size.c_str(), FLAGS_prealloc_size.size()), true);
+  if (FLAGS_pin)
+    pin_thread(t->id - 1);
+  t->latencies.reserve(FLAGS_operations);
+  t->log = FLAGS_trace != "" ? &scal::StdOperationLogger::get() : NULL;
+  t->logged_empty = 0;
+
+  // Values must be non-zero since some objects use NULL as the empty slot.
+  uint64_t base = t->id * FLAGS_operations + 1;
+
+  pthread_barrier_wait(&r->start_barrier);
+  t->start_time = get_utime();
+
+  switch (t->role) {
+  case PRODUCER:
+    for (uint64_t i = 0; i < FLAGS_operations; i += FLAGS_batch) {
+      timed_put(t, base + i, min(FLAGS_batch, FLAGS_operations - i));
+      compute();
+    }
+    __sync_fetch_and_add(&r->producers_done, 1);
+    break;
+
+  case CONSUMER:
+    while (true) {
+      bool done = r->producers_done == r->num_producers;
+      if (!timed_get(t, FLAGS_batch) && done)
+        break;
+      compute();
+    }
+    break;
+
+  case MIXED:
+    for (uint64_t i = 0; i < FLAGS_operations; i += 2 * FLAGS_batch) {
+      timed_put(t, base + i, min(FLAGS_batch, FLAGS_operations - i));
+      compute();
+      timed_get(t, FLAGS_batch);
+      compute();
+    }
+    break;
+  }
+
+  t->end_time = get_utime();
+  pthread_barrier_wait(&r->start_barrier);
+  scal::tlalloc_destroy();
+  return NULL;
+}
+
+uint64_t percentile(vector<uint64_t> &v, double p) {
+  if (v.empty())
+    return 0;
+  size_t n = min(v.size()-1, (size_t) (p * v.size()));
+  nth_element(v.begin(), v.begin() + n, v.end());
+  return v[n];
+}
+
+template<typename T>
+void run_round(string id, unsigned num_threads) {
+  BenchRound<T> r;
+  r.obj = obj_create_payload<T>(id, NO_YIELD);
+  if (r.obj == NULL) {
+    cerr << "\"" << id << "\" does not take " << FLAGS_payload
+         << " payloads; skipping." << endl;
+    exit(0);
+  }
+  r.num_threads = num_threads;
+  r.producers_done = 0;
+
+  bool mixed = FLAGS_workload == "mixed" || num_threads < 2;
+  r.num_producers = mixed ? 0 : num_threads / 2;
+  pthread_barrier_init(&r.start_barrier, NULL, num_threads + 1);
+
+  if (FLAGS_trace != "")
+    scal::StdOperationLogger::reset();
+
+  vector<BenchThread<T> > threads(num_threads);
+  for (unsigned i = 0; i < num_threads; i++) {
+    BenchThread<T> &t = threads[i];
+    t.round = &r;
+    t.id = i + 1;
+    t.role = mixed ? MIXED : (i < r.num_producers ? PRODUCER : CONSUMER);
+    t.ops = 0;
+    pthread_create(&t.handle, NULL, bench_thread<T>, &t);
+  }
+
+  pthread_barrier_wait(&r.start_barrier);
+  pthread_barrier_wait(&r.start_barrier);
+
+  uint64_t ops = 0;
+  uint64_t start_time = UINT64_MAX, end_time = 0;
+  vector<uint64_t> latencies;
+  for (unsigned i = 0; i < num_threads; i++) {
+    pthread_join(threads[i].handle, NULL);
+    ops += threads[i].ops;
+    start_time = min(start_time, threads[i].start_time);
+    end_time = max(end_time, threads[i].end_time);
+    latencies.insert(latencies.end(),
+      threads[i].latencies.begin(), threads[i].latencies.end());
+  }
+  pthread_barrier_destroy(&r.start_barrier);
+  delete r.obj;
+
+  if (FLAGS_trace != "") {
+    stringstream path;
+    path << FLAGS_trace << "." << id << "." << num_threads;
+    FILE *out = fopen(path.str().c_str(), "w");
+    if (out == NULL) {
+      cerr << "Cannot write trace \"" << path.str() << "\"." << endl;
+      exit(-1);
+    }
+    scal::StdOperationLogger::print_summary(out);
+    fclose(out);
+  }
+
+  double secs = (end_time - start_time) / 1000000.0;
+  cout << id << " "
+       << num_threads << " "
+       << ops << " "
+       << secs << " "
+       << (uint64_t) (secs > 0 ? ops / secs : 0) << " "
+       << percentile(latencies, 0.5) << " "
+       << percentile(latencies, 0.9) << " "
+       << percentile(latencies, 0.99) << " "
+       << percentile(latencies, 0.999) << endl;
+}
+
+void run_payload_round(string id, unsigned num_threads) {
+  if (FLAGS_payload == "pointer")
+    run_round<scal::MovablePayload*>(id, num_threads);
+  else if (FLAGS_payload == "moved")
+    run_round<scal::MovablePayload>(id, num_threads);
+  else if (FLAGS_payload == "inline" && FLAGS_payload_size <= 16)
+    run_round< scal::Payload<16> >(id, num_threads);
+  else if (FLAGS_payload == "inline" && FLAGS_payload_size <= 64)
+    run_round< scal::Payload<64> >(id, num_threads);
+  else if (FLAGS_payload == "inline")
+    run_round< scal::Payload<256> >(id, num_threads);
+  else
+    run_round<int>(id, num_threads);
+}
+
+int main(int argc, char **argv) {
+
+  stringstream usage;
+  usage << "usage" << endl;
+  usage << "  " << argv[0] << " [flags]" << endl;
+  usage << "  measures native throughput of the SCAL objects; latencies in cycles.";
+
+  google::SetUsageMessage(usage.str());
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  // The operation logs have one value per operation.
+  if (FLAGS_batch < 1 || (FLAGS_batch > 1 && FLAGS_trace != "")) {
+    cerr << "Batches must be of at least one value, and cannot be traced." << endl;
+    exit(-1);
+  }
+
+  vector<unsigned> thread_counts;
+  vector<string> counts = split(FLAGS_threads);
+  for (int i = 0; i < counts.size(); i++)
+    thread_counts.push_back(atoi(counts[i].c_str()));
+  unsigned max_threads = *max_element(thread_counts.begin(), thread_counts.end());
+
+  if (FLAGS_numa_nodes > 0)
+    scal::numa_configure(FLAGS_numa_nodes);
+
+  // Worker threads use context ids 1..max_threads; 0 is the main thread.
+  scal_initialize(max_threads + 1);
+
+  // The loggers serve all rounds. A consumer may get everything the
+  // producers put, plus its logged empty gets.
+  if (FLAGS_trace != "")
+    scal::StdOperationLogger::prepare(
+      max_threads + 1, FLAGS_operations * (max(1u, max_threads / 2) + 1));
+
+  vector<string> ids = split(FLAGS_objects);
+  if (ids.empty())
+    for (map<string,obj_desc>::iterator I = objects.begin(), E = objects.end(); I != E; ++I)
+      ids.push_back(I->first);
+
+  for (int i = 0; i < ids.size(); i++) {
+    if (objects.count(ids[i]) == 0) {
+      cerr << "Invalid data structure name \"" << ids[i] << "\"; see --help for usage." << endl;
+      exit(-1);
+    }
+  }
+
+  cout << "1:object 2:threads 3:ops 4:time 5:ops_per_sec "
+       << "6:p50 7:p90 8:p99 9:p999" << endl;
+  // Each object is measured in its own process, so that objects which are
+  // known to crash (see README.md) do not take the whole run down.
+  for (int i = 0; i < ids.size(); i++) {
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+      for (int j = 0; j < thread_counts.size(); j++)
+        run_payload_round(ids[i], thread_counts[j]);
+      exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      cerr << "Benchmark of \"" << ids[i] << "\" failed; skipping." << endl;
+  }
+
+  return 0;
+}
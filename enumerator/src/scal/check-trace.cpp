@@ -0,0 +1,63 @@
+// Offline checker for operation logs of the SCAL data structures.
+//
+// Reads traces in the format of TLOperationLogger::print_summary, e.g. as
+// written by ./bench -trace, merges them by timestamp and checks them
+// against queue or stack semantics; see util/trace_checker.h.
+
+#include <gflags/gflags.h>
+#include <sys/time.h>
+#include <sstream>
+#include <iostream>
+
+#include "util/trace_checker.h"
+
+using namespace std;
+
+DEFINE_string(order, "fifo", "which order? {fifo,lifo}");
+DEFINE_uint64(max_reports, 10, "how many violations to print?");
+
+int main(int argc, char **argv) {
+
+  stringstream usage;
+  usage << "usage" << endl;
+  usage << "  " << argv[0] << " [flags] TRACE..." << endl;
+  usage << "  checks operation logs against queue or stack semantics.";
+
+  google::SetUsageMessage(usage.str());
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 2) {
+    cerr << "Must specify at least one trace; see --help for usage." << endl;
+    exit(-1);
+  }
+
+  scal::TraceReader reader;
+  for (int i = 1; i < argc; i++) {
+    if (!reader.open(argv[i])) {
+      cerr << "Cannot read trace \"" << argv[i] << "\"." << endl;
+      exit(-1);
+    }
+  }
+
+  scal::TraceChecker checker(
+    FLAGS_order == "lifo" ? scal::kLifoOrder : scal::kFifoOrder,
+    FLAGS_max_reports);
+
+  timeval start_time, end_time;
+  gettimeofday(&start_time,0);
+
+  scal::TraceEvent event;
+  while (reader.next(&event))
+    checker.process(event);
+
+  gettimeofday(&end_time,0);
+  double secs = (end_time.tv_sec - start_time.tv_sec) +
+    (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+
+  cout << checker.num_operations() << " operations from "
+       << reader.num_runs() << " sequential runs checked in " << secs << "s; "
+       << "window at most " << checker.max_window() << " values." << endl;
+  cout << "Saw " << checker.num_violations() << " violations." << endl;
+
+  return checker.num_violations() > 0 ? 1 : 0;
+}
@@ -0,0 +1,316 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Implementing the queue with the dynamic publication list from:
+//
+// D. Hendler, I. Incze, N. Shavit, and M. Tzafrir. Flat combining and the
+// synchronization-parallelism tradeoff. In Proceedings of the 22nd ACM
+// symposium on Parallelism in algorithms and architectures, SPAA ’10, pages
+// 355–364, New York, NY, USA, 2010. ACM.
+//
+// Unlike FlatCombiningQueue, which scans one request per configured thread,
+// threads register their record in a publication list on their first
+// operation, and the combiner unlinks records which stayed idle for more than
+// max_age passes; a pass costs the number of active threads. Threads which
+// find their record unlinked register it again.
+//
+// A pass applies its enqueues first, as one chain of nodes spliced to the
+// tail of the sequential queue, and then its dequeues. The combiner keeps
+// making passes while they find requests, but at most max_passes, before it
+// releases the lock to the waiting threads.
+//
+// Threads find their record by the thread hook of the reclamation records
+// (see util/reclamation.h), which the enumerator sets such that each of its
+// threads has its own.
+
+#ifndef SCAL_DATASTRUCTURES_ADAPTIVE_FC_QUEUE_H_
+#define SCAL_DATASTRUCTURES_ADAPTIVE_FC_QUEUE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <utility>
+
+#include "datastructures/flatcombining_queue.h"
+#include "datastructures/queue.h"
+#include "util/malloc.h"
+#include "util/platform.h"
+#include "util/reclamation.h"
+#include "util/yield.h"
+
+namespace afc_details {
+
+// As fc_details::Operation, plus the publication list. `age` is the last
+// pass which served the record, and is only accessed by the combiner;
+// `active` is set by the owner when it registers the record, and cleared by
+// the combiner once it unlinked it.
+template<typename T>
+struct Record {
+  volatile fc_details::Opcode opcode;
+  T data;
+  T *batch;
+  uint64_t count;
+  uint64_t age;
+  volatile bool active;
+  Record * volatile next;
+};
+
+template<typename T>
+struct Node {
+  Node *next;
+  T value;
+};
+
+}  // namespace afc_details
+
+template<typename T, typename YieldPolicy = scal::NoYield>
+class AdaptiveFlatCombiningQueue : public Queue<T> {
+ public:
+  AdaptiveFlatCombiningQueue(uint64_t max_passes, uint64_t max_age);
+  bool enqueue(T item);
+  bool dequeue(T *item);
+
+  // A batch is published as a single request; enqueued batches are spliced
+  // along with the other enqueues of a pass.
+  uint64_t put_batch(T *items, uint64_t n);
+  uint64_t get_batch(T *items, uint64_t n);
+
+ private:
+  typedef fc_details::Opcode Opcode;
+  typedef afc_details::Record<T> Record;
+  typedef afc_details::Node<T> Node;
+
+  static const uint64_t kMaxThreads = 1024;
+
+  uint64_t max_passes_;
+  uint64_t max_age_;
+  Record* *records_;  // By thread, allocated on first use.
+  Record * volatile *publication_;
+  bool *global_lock_;
+
+  // Owned by the combiner.
+  Node *head_;
+  Node *tail_;
+  uint64_t pass_;
+
+  Record* my_record(void);
+  void register_record(Record *r);
+  void publish(Record *r, Opcode opcode);
+  void wait_or_combine(Record *r);
+  uint64_t combine_pass(void);
+
+  inline void chain(Node **first, Node **last, T item);
+  inline bool take(T *item);
+};
+
+template<typename T, typename YieldPolicy>
+AdaptiveFlatCombiningQueue<T, YieldPolicy>::AdaptiveFlatCombiningQueue(
+    uint64_t max_passes, uint64_t max_age)
+    : max_passes_(max_passes), max_age_(max_age) {
+  if (max_passes_ == 0) {
+    max_passes_ = 1;
+  }
+  records_ = static_cast<Record**>(scal::calloc_aligned(
+      kMaxThreads, sizeof(*records_), 0));
+  publication_ = scal::get<Record*>(128);
+  global_lock_ = scal::get<bool>(128);
+  head_ = scal::get<Node>(0);
+  tail_ = head_;
+  pass_ = 0;
+}
+
+template<typename T, typename YieldPolicy>
+typename AdaptiveFlatCombiningQueue<T, YieldPolicy>::Record*
+AdaptiveFlatCombiningQueue<T, YieldPolicy>::my_record(void) {
+  uint64_t id = scal::reclaim_thread_hook() % kMaxThreads;
+  if (records_[id] == NULL) {
+    records_[id] = scal::get<Record>(128);
+  }
+  return records_[id];
+}
+
+// Only pushes in front of the head, such that the combiner may unlink any
+// other record.
+template<typename T, typename YieldPolicy>
+void AdaptiveFlatCombiningQueue<T, YieldPolicy>::register_record(Record *r) {
+  r->active = true;
+  while (true) {
+    YieldPolicy::yield();
+    Record *head = *publication_;
+    r->next = head;
+    YieldPolicy::yield();
+    if (__sync_bool_compare_and_swap(publication_, head, r)) {
+      return;
+    }
+  }
+}
+
+template<typename T, typename YieldPolicy>
+void AdaptiveFlatCombiningQueue<T, YieldPolicy>::publish(
+    Record *r, Opcode opcode) {
+  scal::compiler_barrier();
+  r->opcode = opcode;
+  if (!r->active) {
+    register_record(r);
+  }
+}
+
+template<typename T, typename YieldPolicy>
+inline void AdaptiveFlatCombiningQueue<T, YieldPolicy>::chain(
+    Node **first, Node **last, T item) {
+  Node *n = scal::tlget<Node>(0);
+  n->value = std::move(item);
+  if (*first == NULL) {
+    *first = n;
+  } else {
+    (*last)->next = n;
+  }
+  *last = n;
+}
+
+template<typename T, typename YieldPolicy>
+inline bool AdaptiveFlatCombiningQueue<T, YieldPolicy>::take(T *item) {
+  if (head_ == tail_) {
+    return false;
+  }
+  *item = std::move(head_->next->value);
+  head_ = head_->next;
+  return true;
+}
+
+// Returns how many requests the pass served. The combiner does not yield
+// while it holds the lock: under the enumerator, threads spinning on a
+// preempted combiner would never return.
+template<typename T, typename YieldPolicy>
+uint64_t AdaptiveFlatCombiningQueue<T, YieldPolicy>::combine_pass(void) {
+  pass_++;
+  uint64_t served = 0;
+  Node *first = NULL;
+  Node *last = NULL;
+  for (Record *r = *publication_; r != NULL; r = r->next) {
+    Opcode opcode = r->opcode;
+    scal::compiler_barrier();
+    if (opcode == Opcode::Enqueue) {
+      chain(&first, &last, std::move(r->data));
+      r->age = pass_;
+    } else if (opcode == Opcode::EnqueueBatch) {
+      for (uint64_t j = 0; j < r->count; j++) {
+        chain(&first, &last, r->batch[j]);
+      }
+      r->age = pass_;
+    }
+  }
+  if (first != NULL) {
+    tail_->next = first;
+    tail_ = last;
+  }
+
+  // Completes the spliced enqueues, serves the dequeues, and prunes.
+  Record *prev = NULL;
+  Record *r = *publication_;
+  while (r != NULL) {
+    Record *next = r->next;
+    Opcode opcode = r->opcode;
+    scal::compiler_barrier();
+    if ((opcode == Opcode::Enqueue || opcode == Opcode::EnqueueBatch) &&
+        r->age == pass_) {
+      served++;
+      scal::compiler_barrier();
+      r->opcode = Opcode::Done;
+    } else if (opcode == Opcode::Dequeue) {
+      r->count = take(&r->data) ? 1 : 0;
+      r->age = pass_;
+      served++;
+      scal::compiler_barrier();
+      r->opcode = Opcode::Done;
+    } else if (opcode == Opcode::DequeueBatch) {
+      uint64_t j = 0;
+      while (j < r->count && take(&r->batch[j])) {
+        j++;
+      }
+      r->count = j;
+      r->age = pass_;
+      served++;
+      scal::compiler_barrier();
+      r->opcode = Opcode::Done;
+    } else if (opcode == Opcode::Done && prev != NULL &&
+               pass_ - r->age > max_age_) {
+        prev->next = next;
+      scal::compiler_barrier();
+      r->active = false;
+      r = next;
+      continue;
+    }
+    prev = r;
+    r = next;
+  }
+  return served;
+}
+
+// The owner re-registers its record whenever it finds it unlinked, which
+// the combiner may do after it read the previous Done.
+template<typename T, typename YieldPolicy>
+void AdaptiveFlatCombiningQueue<T, YieldPolicy>::wait_or_combine(Record *r) {
+  while (true) {
+    YieldPolicy::yield();
+    if (__sync_bool_compare_and_swap(global_lock_, false, true)) {
+      for (uint64_t i = 0; i < max_passes_ && combine_pass() > 0; i++) {}
+      scal::compiler_barrier();
+      *global_lock_ = false;
+    }
+    YieldPolicy::yield();
+    if (r->opcode == Opcode::Done) {
+      scal::compiler_barrier();
+      return;
+    }
+    if (!r->active) {
+      register_record(r);
+    }
+  }
+}
+
+template<typename T, typename YieldPolicy>
+bool AdaptiveFlatCombiningQueue<T, YieldPolicy>::enqueue(T item) {
+  Record *r = my_record();
+  r->data = std::move(item);
+  publish(r, Opcode::Enqueue);
+  wait_or_combine(r);
+  return true;
+}
+
+template<typename T, typename YieldPolicy>
+bool AdaptiveFlatCombiningQueue<T, YieldPolicy>::dequeue(T *item) {
+  Record *r = my_record();
+  publish(r, Opcode::Dequeue);
+  wait_or_combine(r);
+  if (r->count == 0) {
+    return false;
+  }
+  *item = std::move(r->data);
+  return true;
+}
+
+template<typename T, typename YieldPolicy>
+uint64_t AdaptiveFlatCombiningQueue<T, YieldPolicy>::put_batch(
+    T *items, uint64_t n) {
+  Record *r = my_record();
+  r->batch = items;
+  r->count = n;
+  publish(r, Opcode::EnqueueBatch);
+  wait_or_combine(r);
+  return n;
+}
+
+template<typename T, typename YieldPolicy>
+uint64_t AdaptiveFlatCombiningQueue<T, YieldPolicy>::get_batch(
+    T *items, uint64_t n) {
+  Record *r = my_record();
+  r->batch = items;
+  r->count = n;
+  publish(r, Opcode::DequeueBatch);
+  wait_or_combine(r);
+  return r->count;
+}
+
+#endif  // SCAL_DATASTRUCTURES_ADAPTIVE_FC_QUEUE_H_
@@ -7,12 +7,20 @@
 
 #include <stdint.h>
 
-#include "datastructures/ms_queue.h"
+// What load-aware balancers see of the backends of a distributed data
+// structure.
+class BalancerBackends {
+ public:
+  virtual uint64_t approx_size(uint64_t index) = 0;
+  virtual ~BalancerBackends() {}
+};
 
+// Returns the index of the backend to put to, resp. get from first; backends
+// may be NULL for balancers which do not look at them.
 class BalancerInterface {
  public:
   virtual uint64_t get(uint64_t num_queues,
-                       MSQueue<uint64_t> **queues,
+                       BalancerBackends *backends,
                        bool enqueue) = 0;
   virtual ~BalancerInterface() {}
 };
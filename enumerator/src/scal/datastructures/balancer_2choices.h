@@ -0,0 +1,51 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// The power of two choices, after:
+//
+// M. Mitzenmacher. The power of two choices in randomized load balancing.
+// IEEE Transactions on Parallel and Distributed Systems, 12(10):1094–1104,
+// 2001.
+//
+// Samples two backends, and puts to the shorter, resp. gets from the longer
+// one, by their approx_size.
+
+#ifndef SCAL_DATASTRUCTURES_BALANCER_2CHOICES_H_
+#define SCAL_DATASTRUCTURES_BALANCER_2CHOICES_H_
+
+#include <stdint.h>
+
+#include "datastructures/balancer.h"
+#include "util/random.h"
+
+class BalancerTwoChoices : public BalancerInterface {
+ public:
+  BalancerTwoChoices() { }
+
+  uint64_t get(uint64_t num_queues, BalancerBackends *backends, bool enqueue) {
+    return choose(0, num_queues, backends, enqueue);
+  }
+
+  // Chooses among the backends first..first+n-1.
+  static inline uint64_t choose(uint64_t first, uint64_t n,
+                                BalancerBackends *backends, bool enqueue) {
+    if (n == 1) {
+      return first;
+    }
+    uint64_t a = first + pseudorand() % n;
+    uint64_t b = first + pseudorand() % n;
+    if (backends == NULL || a == b) {
+      return a;
+    }
+    uint64_t size_a = backends->approx_size(a);
+    uint64_t size_b = backends->approx_size(b);
+    if (enqueue) {
+      return size_a <= size_b ? a : b;
+    } else {
+      return size_a >= size_b ? a : b;
+    }
+  }
+};
+
+#endif  // SCAL_DATASTRUCTURES_BALANCER_2CHOICES_H_
@@ -12,7 +12,7 @@ class BalancerId : public BalancerInterface {
  public:
   BalancerId() { }
 
-  uint64_t get(uint64_t num_queues, MSQueue<uint64_t> **queues, bool enqueue) {
+  uint64_t get(uint64_t num_queues, BalancerBackends*, bool enqueue) {
     if (num_queues == 1) {
       return 0;
     }
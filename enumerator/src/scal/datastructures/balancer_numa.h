@@ -0,0 +1,43 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Splits the backends into one consecutive range per NUMA node (see
+// util/numa.h), and chooses by two choices within the range of the caller's
+// node. Items then stay on their node as long as its consumers keep up: the
+// nodes of a backend are allocated by the threads putting to it, and gets
+// start scanning in the local range.
+
+#ifndef SCAL_DATASTRUCTURES_BALANCER_NUMA_H_
+#define SCAL_DATASTRUCTURES_BALANCER_NUMA_H_
+
+#include <stdint.h>
+
+#include "datastructures/balancer.h"
+#include "datastructures/balancer_2choices.h"
+#include "util/numa.h"
+
+class BalancerNumaLocal : public BalancerInterface {
+ public:
+  explicit BalancerNumaLocal(uint64_t num_queues) {
+    num_nodes_ = scal::numa_num_nodes();
+    if (num_nodes_ > num_queues) {
+      num_nodes_ = num_queues;
+    }
+    if (num_nodes_ == 0) {
+      num_nodes_ = 1;
+    }
+  }
+
+  uint64_t get(uint64_t num_queues, BalancerBackends *backends, bool enqueue) {
+    uint64_t node = scal::numa_current_node() % num_nodes_;
+    uint64_t first = node * num_queues / num_nodes_;
+    uint64_t last = (node + 1) * num_queues / num_nodes_;
+    return BalancerTwoChoices::choose(first, last - first, backends, enqueue);
+  }
+
+ private:
+  uint64_t num_nodes_;
+};
+
+#endif  // SCAL_DATASTRUCTURES_BALANCER_NUMA_H_
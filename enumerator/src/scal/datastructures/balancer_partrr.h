@@ -15,10 +15,10 @@ class BalancerPartitionedRoundRobin : public BalancerInterface {
   BalancerPartitionedRoundRobin(uint64_t partitions, uint64_t num_queues) {
     num_queues_ = num_queues;
     partitions_ = partitions;
-    enqueue_rrs_ = static_cast<uint64_t**>(calloc(
-        partitions_, sizeof(*enqueue_rrs_)));
-    dequeue_rrs_ = static_cast<uint64_t**>(calloc(
-        partitions_, sizeof(*dequeue_rrs_)));
+    enqueue_rrs_ = static_cast<uint64_t**>(scal::calloc_aligned(
+        partitions_, sizeof(*enqueue_rrs_), 0));
+    dequeue_rrs_ = static_cast<uint64_t**>(scal::calloc_aligned(
+        partitions_, sizeof(*dequeue_rrs_), 0));
     for (uint64_t i = 0; i < partitions_; i++) {
       enqueue_rrs_[i] = scal::get<uint64_t>(scal::kCachePrefetch);
       dequeue_rrs_[i] = scal::get<uint64_t>(scal::kCachePrefetch);
@@ -27,7 +27,7 @@ class BalancerPartitionedRoundRobin : public BalancerInterface {
     }
   }
 
-  uint64_t get(uint64_t num_queues, MSQueue<uint64_t> **queues, bool enqueue) {
+  uint64_t get(uint64_t num_queues, BalancerBackends*, bool enqueue) {
     uint64_t thread_id = scal::ThreadContext::get().thread_id();
     if (enqueue) {
       return __sync_fetch_and_add(enqueue_rrs_[thread_id % partitions_], 1)
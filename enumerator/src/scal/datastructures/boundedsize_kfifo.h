@@ -22,15 +22,16 @@
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
+#include "util/yield.h"
 
-template<typename T>
+template<typename T, typename YieldPolicy = scal::NoYield>
 class BoundedSizeKFifo : public Queue<T> {
  public:
-  static BoundedSizeKFifo<T> *get_aligned(
+  static BoundedSizeKFifo *get_aligned(
       uint64_t k, uint64_t num_segments, size_t alignment) {
     using scal::malloc_aligned;
-    void *mem = malloc_aligned(sizeof(BoundedSizeKFifo<T>), alignment);
-    BoundedSizeKFifo<T>* kfifo = new(mem) BoundedSizeKFifo<T>(k, num_segments);
+    void *mem = malloc_aligned(sizeof(BoundedSizeKFifo), alignment);
+    BoundedSizeKFifo* kfifo = new(mem) BoundedSizeKFifo(k, num_segments);
     return kfifo;
   }
 
@@ -38,6 +39,11 @@ class BoundedSizeKFifo : public Queue<T> {
   bool enqueue(T item);
   bool dequeue(T *item);
 
+  // Fill, resp. empty, several slots of a segment per head and tail
+  // snapshot, as long as that snapshot stays current.
+  uint64_t put_batch(T *items, uint64_t n);
+  uint64_t get_batch(T *items, uint64_t n);
+
  private:
   static const uint64_t kPtrAlignment = scal::kCachePrefetch;
   static const int64_t kNoIndexFound = -1;
@@ -64,12 +70,12 @@ class BoundedSizeKFifo : public Queue<T> {
                        uint64_t head_current_pointer);
 };
 
-template<typename T>
-BoundedSizeKFifo<T>::BoundedSizeKFifo(uint64_t k, uint64_t num_segments) {
+template<typename T, typename YieldPolicy>
+BoundedSizeKFifo<T, YieldPolicy>::BoundedSizeKFifo(uint64_t k, uint64_t num_segments) {
   k_ = k;
   queue_size_ = k * num_segments;
-  queue_ = static_cast<AtomicValue<T>**>(calloc(
-      queue_size_, sizeof(AtomicValue<T>*)));
+  queue_ = static_cast<AtomicValue<T>**>(scal::calloc_aligned(
+      queue_size_, sizeof(AtomicValue<T>*), 0));
   for (uint64_t i = 0; i < queue_size_; i++) {
     queue_[i] = scal::get<AtomicValue<T> >(kPtrAlignment * 4);
   }
@@ -79,8 +85,8 @@ BoundedSizeKFifo<T>::BoundedSizeKFifo(uint64_t k, uint64_t num_segments) {
   tail_ = scal::get_aligned<AtomicValue<uint64_t> >(kPtrAlignment);
 }
 
-template<typename T>
-void BoundedSizeKFifo<T>::find_index(uint64_t start_index,
+template<typename T, typename YieldPolicy>
+void BoundedSizeKFifo<T, YieldPolicy>::find_index(uint64_t start_index,
                                      bool empty,
                                      int64_t *item_index,
                                      AtomicValue<T> *old) {
@@ -98,20 +104,20 @@ void BoundedSizeKFifo<T>::find_index(uint64_t start_index,
   }
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::advance_head(AtomicValue<uint64_t> head_old) {
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::advance_head(AtomicValue<uint64_t> head_old) {
   AtomicValue<uint64_t> newcp(head_old.value() + k_, head_old.aba() + 1);
   return head_->cas(head_old, newcp);
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::advance_tail(AtomicValue<uint64_t> tail_old) {
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::advance_tail(AtomicValue<uint64_t> tail_old) {
   AtomicValue<uint64_t> newcp(tail_old.value() + k_, tail_old.aba() + 1);
   return tail_->cas(tail_old, newcp);
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::queue_full(uint64_t head_old_pointer,
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::queue_full(uint64_t head_old_pointer,
                                      uint64_t tail_old_pointer) {
   AtomicValue<uint64_t> head_current = *head_;
   if ((head_old_pointer == head_current.value())
@@ -121,8 +127,8 @@ bool BoundedSizeKFifo<T>::queue_full(uint64_t head_old_pointer,
   return false;
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::segment_not_empty(uint64_t head_old_pointer) {
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::segment_not_empty(uint64_t head_old_pointer) {
   for (size_t i = 0; i < k_; i++) {
     if (queue_[(head_old_pointer + i) % queue_size_]->value() != (T)NULL) {
       return true;
@@ -131,8 +137,8 @@ bool BoundedSizeKFifo<T>::segment_not_empty(uint64_t head_old_pointer) {
   return false;
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::in_valid_region(uint64_t tail_old_pointer,
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::in_valid_region(uint64_t tail_old_pointer,
                                           uint64_t tail_current_pointer,
                                           uint64_t head_current_pointer) {
   bool wrap_around = (tail_current_pointer < head_current_pointer)
@@ -145,8 +151,8 @@ bool BoundedSizeKFifo<T>::in_valid_region(uint64_t tail_old_pointer,
           || tail_old_pointer <= tail_current_pointer) ? true : false;
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::not_in_valid_region(uint64_t tail_old_pointer,
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::not_in_valid_region(uint64_t tail_old_pointer,
                                               uint64_t tail_current_pointer,
                                               uint64_t head_current_pointer) {
   bool wrap_around = (tail_current_pointer < head_current_pointer)
@@ -159,8 +165,8 @@ bool BoundedSizeKFifo<T>::not_in_valid_region(uint64_t tail_old_pointer,
           && head_current_pointer < tail_old_pointer) ? true : false;
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::committed(uint64_t tail_old_pointer,
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::committed(uint64_t tail_old_pointer,
                                     AtomicValue<T> *new_item,
                                     uint64_t item_index) {
   if (queue_[item_index]->value() != new_item->value()) {
@@ -192,8 +198,8 @@ bool BoundedSizeKFifo<T>::committed(uint64_t tail_old_pointer,
   return false;
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::dequeue(T *item) {
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::dequeue(T *item) {
   AtomicValue<uint64_t> tail_old;
   AtomicValue<uint64_t> head_old;
   int64_t item_index;
@@ -201,23 +207,23 @@ bool BoundedSizeKFifo<T>::dequeue(T *item) {
   while (true) {
     head_old = *head_;
     tail_old = *tail_;
-    Yield();
+    YieldPolicy::yield();
     find_index(head_old.value(), false, &item_index, &old_item);
     if (head_old.raw() == head_->raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (item_index != kNoIndexFound) {
-        Yield();
+        YieldPolicy::yield();
         if (head_old.value() == tail_old.value()) {
           advance_tail(tail_old);
         }
         AtomicValue<T> newcp((T)NULL, old_item.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (queue_[item_index]->cas(old_item, newcp)) {
           *item = old_item.value();
           return true;
         }
       } else {
-        Yield();
+        YieldPolicy::yield();
         if (head_old.value() == tail_old.value()
             && tail_old.value() == tail_->value()) {
           return false;
@@ -228,8 +234,8 @@ bool BoundedSizeKFifo<T>::dequeue(T *item) {
   }
 }
 
-template<typename T>
-bool BoundedSizeKFifo<T>::enqueue(T item) {
+template<typename T, typename YieldPolicy>
+bool BoundedSizeKFifo<T, YieldPolicy>::enqueue(T item) {
   if (item == (T)NULL) {
     printf("%s: unable to enqueue NULL or equivalent value\n", __func__);
     abort();
@@ -241,23 +247,23 @@ bool BoundedSizeKFifo<T>::enqueue(T item) {
   while (true) {
     tail_old = *tail_;
     head_old = *head_;
-    Yield();
+    YieldPolicy::yield();
     find_index(tail_old.value(), true, &item_index, &old_item);
     if (tail_old.raw() == tail_->raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (item_index != kNoIndexFound) {
         AtomicValue<T> newcp(item, old_item.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (queue_[item_index]->cas(old_item, newcp)) {
-          Yield();
+          YieldPolicy::yield();
           if (committed(tail_old.value(), &newcp, item_index)) {
             return true;
           }
         }
       } else {
-        Yield();
+        YieldPolicy::yield();
         if (queue_full(head_old.value(), tail_old.value())) {
-          Yield();
+          YieldPolicy::yield();
           if (segment_not_empty(head_old.value()) &&
               head_old.value() == head_->value()) {
             return false;
@@ -270,4 +276,112 @@ bool BoundedSizeKFifo<T>::enqueue(T item) {
   }
 }
 
+template<typename T, typename YieldPolicy>
+uint64_t BoundedSizeKFifo<T, YieldPolicy>::get_batch(T *items, uint64_t n) {
+  AtomicValue<uint64_t> tail_old;
+  AtomicValue<uint64_t> head_old;
+  int64_t item_index;
+  AtomicValue<T> old_item;
+  uint64_t done = 0;
+  while (done < n) {
+    head_old = *head_;
+    tail_old = *tail_;
+    YieldPolicy::yield();
+    find_index(head_old.value(), false, &item_index, &old_item);
+    if (head_old.raw() == head_->raw()) {
+      YieldPolicy::yield();
+      if (item_index != kNoIndexFound) {
+        YieldPolicy::yield();
+        if (head_old.value() == tail_old.value()) {
+          advance_tail(tail_old);
+        }
+        // Keep taking items from this segment until it looks empty.
+        while (item_index != kNoIndexFound) {
+          AtomicValue<T> newcp((T)NULL, old_item.aba() + 1);
+          YieldPolicy::yield();
+          if (!queue_[item_index]->cas(old_item, newcp)) {
+            break;
+          }
+          items[done++] = old_item.value();
+          if (done == n) {
+            return done;
+          }
+          YieldPolicy::yield();
+          find_index(head_old.value(), false, &item_index, &old_item);
+          if (head_old.raw() != head_->raw()) {
+            break;
+          }
+        }
+      } else {
+        YieldPolicy::yield();
+        if (head_old.value() == tail_old.value()
+            && tail_old.value() == tail_->value()) {
+          return done;
+        }
+        advance_head(head_old);
+      }
+    }
+  }
+  return done;
+}
+
+template<typename T, typename YieldPolicy>
+uint64_t BoundedSizeKFifo<T, YieldPolicy>::put_batch(T *items, uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    if (items[i] == (T)NULL) {
+      printf("%s: unable to enqueue NULL or equivalent value\n", __func__);
+      abort();
+    }
+  }
+  AtomicValue<uint64_t> tail_old;
+  AtomicValue<uint64_t> head_old;
+  int64_t item_index;
+  AtomicValue<T> old_item;
+  uint64_t done = 0;
+  while (done < n) {
+    tail_old = *tail_;
+    head_old = *head_;
+    YieldPolicy::yield();
+    find_index(tail_old.value(), true, &item_index, &old_item);
+    if (tail_old.raw() == tail_->raw()) {
+      YieldPolicy::yield();
+      if (item_index != kNoIndexFound) {
+        // Keep filling this segment until it looks full; each item is
+        // committed on its own.
+        while (item_index != kNoIndexFound) {
+          AtomicValue<T> newcp(items[done], old_item.aba() + 1);
+          YieldPolicy::yield();
+          if (!queue_[item_index]->cas(old_item, newcp)) {
+            break;
+          }
+          YieldPolicy::yield();
+          if (!committed(tail_old.value(), &newcp, item_index)) {
+            break;
+          }
+          if (++done == n) {
+            return done;
+          }
+          YieldPolicy::yield();
+          find_index(tail_old.value(), true, &item_index, &old_item);
+          if (tail_old.raw() != tail_->raw()) {
+            break;
+          }
+        }
+      } else {
+        YieldPolicy::yield();
+        if (queue_full(head_old.value(), tail_old.value())) {
+          YieldPolicy::yield();
+          if (segment_not_empty(head_old.value()) &&
+              head_old.value() == head_->value()) {
+            return done;
+          }
+          advance_head(head_old);
+        }
+        advance_tail(tail_old);
+      }
+    }
+  }
+  return done;
+}
+
 #endif  // SCAL_DATASTRUCTURES_BOUNDEDSIZE_KFIFO_H_
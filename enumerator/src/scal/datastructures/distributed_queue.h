@@ -14,8 +14,9 @@
 #include "util/malloc.h"
 #include "util/platform.h"
 
+// The balancer sees the backends through their approx_size.
 template<typename T, class P>
-class DistributedQueue : public Pool<T> {
+class DistributedQueue : public Pool<T>, private BalancerBackends {
  public:
   DistributedQueue(size_t num_queues,
            uint64_t num_threads,
@@ -30,6 +31,10 @@ class DistributedQueue : public Pool<T> {
   size_t num_queues_;
   BalancerInterface *balancer_;
   AtomicRaw **tails_;
+
+  uint64_t approx_size(uint64_t index) {
+    return backend_[index]->approx_size();
+  }
 };
 
 template<typename T, class P>
@@ -37,11 +42,13 @@ DistributedQueue<T, P>::DistributedQueue(
     size_t num_queues, uint64_t num_threads, BalancerInterface *balancer) {
   num_queues_ = num_queues;
   balancer_ = balancer;
-  backend_ = static_cast<P**>(calloc(num_queues_, sizeof(P*)));
+  backend_ = static_cast<P**>(scal::calloc_aligned(
+      num_queues_, sizeof(P*), 0));
   for (uint64_t i = 0; i < num_queues_; i++) {
     backend_[i] = scal::get<P>(kPtrAlignment);
   }
-  tails_ = static_cast<AtomicRaw**>(calloc(num_threads, sizeof(*tails_)));
+  tails_ = static_cast<AtomicRaw**>(scal::calloc_aligned(
+      num_threads, sizeof(*tails_), 0));
   for (uint64_t i = 0; i < num_threads; i++) {
     tails_[i] = static_cast<AtomicRaw*>(scal::tlcalloc_aligned(
         num_queues_, sizeof(AtomicRaw), kPtrAlignment));
@@ -50,7 +57,7 @@ DistributedQueue<T, P>::DistributedQueue(
 
 template<typename T, class P>
 bool DistributedQueue<T, P>::put(T item) {
-  uint64_t index = balancer_->get(num_queues_, NULL, true);
+  uint64_t index = balancer_->get(num_queues_, this, true);
   return backend_[index]->put(item);
 }
 
@@ -58,7 +65,7 @@ template<typename T, class P>
 bool DistributedQueue<T, P>::get(T *item) {
   size_t i;
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
-  uint64_t start = balancer_->get(num_queues_, NULL, false);
+  uint64_t start = balancer_->get(num_queues_, this, false);
   size_t index;
   while (true) {
     for (i = 0; i < num_queues_; i++) {
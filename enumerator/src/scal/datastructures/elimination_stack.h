@@ -0,0 +1,189 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Implementing the elimination-backoff stack from:
+//
+// D. Hendler, N. Shavit, and L. Yerushalmi. A scalable lock-free stack
+// algorithm. In Proceedings of the 16th annual ACM symposium on Parallelism in
+// algorithms and architectures, SPAA ’04, New York, NY, USA, 2004. ACM.
+//
+// The elimination array follows the exchanger variant of M. Herlihy and N.
+// Shavit. The Art of Multiprocessor Programming, 2008, rather than the
+// per-thread location array of the paper (and of src/toys/EliminationStack.c),
+// such that it does not depend on thread ids: a push which fails its CAS on
+// the top offers its item in a random slot, and waits for a pop which failed
+// its CAS to take it. Slots use NULL as the empty value, so items must be
+// non-NULL.
+
+#ifndef SCAL_DATASTRUCTURES_ELIMINATION_STACK_H_
+#define SCAL_DATASTRUCTURES_ELIMINATION_STACK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "datastructures/stack.h"
+#include "util/atomic_value.h"
+#include "util/malloc.h"
+#include "util/platform.h"
+#include "util/random.h"
+#include "util/yield.h"
+
+namespace es_internal {
+
+template<typename T>
+struct Node {
+  AtomicPointer<Node*> next;
+  T data;
+};
+
+}  // namespace es_internal
+
+// The elimination array has width slots; an offered item waits in its slot
+// for up to spins reads before it is withdrawn, and a pop looks for an offer
+// for as long.
+template<typename T, typename YieldPolicy = scal::NoYield>
+class EliminationStack : public Stack<T> {
+ public:
+  EliminationStack(uint64_t width, uint64_t spins);
+  bool push(T item);
+  bool pop(T *item);
+
+ private:
+  typedef es_internal::Node<T> Node;
+
+  AtomicPointer<Node*> *top_;
+  AtomicValue<T> **slots_;
+  uint64_t width_;
+  uint64_t spins_;
+
+  inline bool try_push(Node *n);
+  inline bool try_pop(T *item, bool *empty);
+  // The slow paths stay out of line, to keep push and pop as fast as the
+  // Treiber stack when there is no contention.
+  __attribute__((noinline)) bool eliminate_push(T item);
+  __attribute__((noinline)) bool eliminate_pop(T *item);
+};
+
+template<typename T, typename YieldPolicy>
+EliminationStack<T, YieldPolicy>::EliminationStack(
+    uint64_t width, uint64_t spins) : width_(width), spins_(spins) {
+  if (width_ == 0) {
+    width_ = 1;
+  }
+  top_ = scal::get<AtomicPointer<Node*> >(scal::kCachePrefetch);
+  slots_ = static_cast<AtomicValue<T>**>(scal::malloc_aligned(
+      width_ * sizeof(*slots_), scal::kCachePrefetch));
+  for (uint64_t i = 0; i < width_; i++) {
+    slots_[i] = scal::get<AtomicValue<T> >(scal::kCachePrefetch * 2);
+  }
+}
+
+template<typename T, typename YieldPolicy>
+bool EliminationStack<T, YieldPolicy>::push(T item) {
+  if (item == (T)NULL) {
+    fprintf(stderr, "%s: error: item may not be NULL\n", __func__);
+    abort();
+  }
+  Node *n = scal::tlget_aligned<Node>(0);
+  n->data = item;
+  while (true) {
+    if (try_push(n) || eliminate_push(item)) {
+      return true;
+    }
+  }
+}
+
+template<typename T, typename YieldPolicy>
+bool EliminationStack<T, YieldPolicy>::pop(T *item) {
+  bool empty;
+  while (true) {
+    if (try_pop(item, &empty)) {
+      return true;
+    }
+    if (empty) {
+      return false;
+    }
+    if (eliminate_pop(item)) {
+      return true;
+    }
+  }
+}
+
+template<typename T, typename YieldPolicy>
+inline bool EliminationStack<T, YieldPolicy>::try_push(Node *n) {
+  YieldPolicy::yield();
+  AtomicPointer<Node*> top_old = *top_;
+  YieldPolicy::yield();
+  n->next.weak_set_value(top_old.value());
+  AtomicPointer<Node*> top_new(n, top_old.aba() + 1);
+  YieldPolicy::yield();
+  return top_->cas(top_old, top_new);
+}
+
+template<typename T, typename YieldPolicy>
+inline bool EliminationStack<T, YieldPolicy>::try_pop(T *item, bool *empty) {
+  YieldPolicy::yield();
+  AtomicPointer<Node*> top_old = *top_;
+  YieldPolicy::yield();
+  *empty = top_old.value() == NULL;
+  if (*empty) {
+    return false;
+  }
+  AtomicPointer<Node*> top_new(top_old.value()->next.value(),
+                               top_old.aba() + 1);
+  YieldPolicy::yield();
+  if (!top_->cas(top_old, top_new)) {
+    return false;
+  }
+  *item = top_old.value()->data;
+  return true;
+}
+
+// The push is linearized when a pop takes its offer, right before that pop.
+template<typename T, typename YieldPolicy>
+bool EliminationStack<T, YieldPolicy>::eliminate_push(T item) {
+  AtomicValue<T> *slot = slots_[pseudorand() % width_];
+  YieldPolicy::yield();
+  AtomicValue<T> slot_old = *slot;
+  if (slot_old.value() != (T)NULL) {
+    return false;  // Another push waits here.
+  }
+  AtomicValue<T> offer(item, slot_old.aba() + 1);
+  YieldPolicy::yield();
+  if (!slot->cas(slot_old, offer)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < spins_; i++) {
+    YieldPolicy::yield();
+    if (slot->raw() != offer.raw()) {
+      return true;
+    }
+  }
+  AtomicValue<T> withdrawn((T)NULL, offer.aba() + 1);
+  YieldPolicy::yield();
+  // Failing to withdraw the offer means a pop took it.
+  return !slot->cas(offer, withdrawn);
+}
+
+template<typename T, typename YieldPolicy>
+bool EliminationStack<T, YieldPolicy>::eliminate_pop(T *item) {
+  AtomicValue<T> *slot = slots_[pseudorand() % width_];
+  for (uint64_t i = 0; i < spins_; i++) {
+    YieldPolicy::yield();
+    AtomicValue<T> slot_old = *slot;
+    if (slot_old.value() == (T)NULL) {
+      continue;
+    }
+    AtomicValue<T> taken((T)NULL, slot_old.aba() + 1);
+    YieldPolicy::yield();
+    if (slot->cas(slot_old, taken)) {
+      *item = slot_old.value();
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif  // SCAL_DATASTRUCTURES_ELIMINATION_STACK_H_
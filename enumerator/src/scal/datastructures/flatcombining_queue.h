@@ -8,6 +8,10 @@
 // synchronization-parallelism tradeoff. In Proceedings of the 22nd ACM
 // symposium on Parallelism in algorithms and architectures, SPAA ’10, pages
 // 355–364, New York, NY, USA, 2010. ACM.
+//
+// Each thread publishes its requests in a slot of its own, which it finds by
+// the thread hook of the reclamation records (see util/reclamation.h), modulo
+// num_ops.
 
 #ifndef SCAL_DATASTRUCTURES_FLATCOMBINING_QUEUE_H_
 #define SCAL_DATASTRUCTURES_FLATCOMBINING_QUEUE_H_
@@ -17,33 +21,52 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <utility>
+
 #include "datastructures/queue.h"
 #include "datastructures/single_list.h"
 #include "util/malloc.h"
+#include "util/platform.h"
+#include "util/reclamation.h"
 #include "util/threadlocals.h"
+#include "util/yield.h"
 
 namespace fc_details {
 
 enum Opcode {
   Done = 0,
   Enqueue = 1,
-  Dequeue = 2
+  Dequeue = 2,
+  EnqueueBatch = 3,
+  DequeueBatch = 4
 };
 
+// Items move through `data`, which is only accessed by whoever owns the
+// request: its thread while the opcode is Done, the combiner otherwise. Batch
+// operations pass their items through `batch`; `count` holds the batch size.
+// Once Done, `count` holds the number of items dequeued, for Dequeue and
+// DequeueBatch.
 template<typename T>
 struct Operation {
   Opcode opcode;
   T data;
+  T *batch;
+  uint64_t count;
 };
 }  // fc_details
 
-template<typename T>
+template<typename T, typename YieldPolicy = scal::NoYield>
 class FlatCombiningQueue : public Queue<T> {
  public:
   explicit FlatCombiningQueue(uint64_t num_ops);
   bool enqueue(T item);
   bool dequeue(T *item);
 
+  // A batch is published as a single request and applied as a whole by
+  // the combiner.
+  uint64_t put_batch(T *items, uint64_t n);
+  uint64_t get_batch(T *items, uint64_t n);
+
  private:
   typedef fc_details::Opcode Opcode;
   typedef fc_details::Operation<T> Operation;
@@ -53,19 +76,26 @@ class FlatCombiningQueue : public Queue<T> {
   SingleList<T> *queue_;
   bool *global_lock_;
 
-  inline void set_op(uint64_t index, Opcode opcode, T data) {
-    operations_[index]->data = data;
+  // The request itself, for the owner of its data.
+  inline Operation* op(uint64_t index) {
+    return const_cast<Operation*>(operations_[index]);
+  }
+
+  // Hands the request over, after its data.
+  inline void set_op(uint64_t index, Opcode opcode) {
+    scal::compiler_barrier();
     operations_[index]->opcode = opcode;
   }
 
   void scan_combine_apply(void);
+  void wait_or_combine(uint64_t thread_id);
 };
 
-template<typename T>
-FlatCombiningQueue<T>::FlatCombiningQueue(uint64_t num_ops) {
+template<typename T, typename YieldPolicy>
+FlatCombiningQueue<T, YieldPolicy>::FlatCombiningQueue(uint64_t num_ops) {
   num_ops_ = num_ops;
-  operations_ = static_cast<volatile Operation**>(calloc(
-      num_ops, sizeof(*operations_)));
+  operations_ = static_cast<volatile Operation**>(scal::calloc_aligned(
+      num_ops, sizeof(*operations_), 0));
   for (uint64_t i = 0; i < num_ops; i++) {
     operations_[i] = scal::get<Operation>(128);
   }
@@ -73,68 +103,99 @@ FlatCombiningQueue<T>::FlatCombiningQueue(uint64_t num_ops) {
   global_lock_ = scal::get<bool>(128);
 }
 
-template<typename T>
-void FlatCombiningQueue<T>::scan_combine_apply(void) {
+// Runs under the lock, and thus without yielding, on the sequential list; see
+// AdaptiveFlatCombiningQueue::combine_pass.
+template<typename T, typename YieldPolicy>
+void FlatCombiningQueue<T, YieldPolicy>::scan_combine_apply(void) {
   for (uint64_t i = 0; i < num_ops_; i++) {
-    if (operations_[i]->opcode == Opcode::Enqueue) {
-      queue_->enqueue(operations_[i]->data);
-      Yield();
-      set_op(i, Opcode::Done, (T)NULL);
-    } else if (operations_[i]->opcode == Opcode::Dequeue) {
+    Opcode opcode = operations_[i]->opcode;
+    scal::compiler_barrier();
+    Operation *request = op(i);
+    if (opcode == Opcode::Enqueue) {
+      queue_->enqueue(std::move(request->data));
+      set_op(i, Opcode::Done);
+    } else if (opcode == Opcode::Dequeue) {
       if (!queue_->is_empty()) {
-        T item;
-        Yield();
-        queue_->dequeue(&item);
-        set_op(i, Opcode::Done, item);
+        queue_->dequeue(&request->data);
+        request->count = 1;
       } else {
-        set_op(i, Opcode::Done, (T)NULL);
+        request->count = 0;
       }
+      set_op(i, Opcode::Done);
+    } else if (opcode == Opcode::EnqueueBatch) {
+      for (uint64_t j = 0; j < request->count; j++) {
+        queue_->enqueue(request->batch[j]);
+      }
+      set_op(i, Opcode::Done);
+    } else if (opcode == Opcode::DequeueBatch) {
+      uint64_t j = 0;
+      while (j < request->count && !queue_->is_empty()) {
+        queue_->dequeue(&request->batch[j]);
+        j++;
+      }
+      request->count = j;
+      set_op(i, Opcode::Done);
     }
   }
 }
 
-
-template<typename T>
-bool FlatCombiningQueue<T>::enqueue(T item) {
-  uint64_t thread_id = scal::ThreadContext::get().thread_id();
-  set_op(thread_id, Opcode::Enqueue, item);
+template<typename T, typename YieldPolicy>
+void FlatCombiningQueue<T, YieldPolicy>::wait_or_combine(uint64_t thread_id) {
   while (true) {
-    Yield();
+    YieldPolicy::yield();
     if (!__sync_bool_compare_and_swap(global_lock_, false, true)) {
       if (operations_[thread_id]->opcode == Opcode::Done) {
-        return true;
+        scal::compiler_barrier();
+        return;
       }
     } else {
       scan_combine_apply();
       *global_lock_ = false;
-      return true;
+      return;
     }
   }
 }
 
-template<typename T>
-bool FlatCombiningQueue<T>::dequeue(T *item) {
-  uint64_t thread_id = scal::ThreadContext::get().thread_id();
-  set_op(thread_id, Opcode::Dequeue, (T)NULL);
-  while (true) {
-    Yield();
-    if (!__sync_bool_compare_and_swap(global_lock_, false, true)) {
-      if (operations_[thread_id]->opcode == Opcode::Done) {
-        break;
-      }
-    } else {
-      scan_combine_apply();
-      *global_lock_ = false;
-      break;
-    }
-  }
-  *item = operations_[thread_id]->data;
-  set_op(thread_id, Opcode::Done, (T)NULL);
-  if (*item == (T)NULL) {
+
+template<typename T, typename YieldPolicy>
+bool FlatCombiningQueue<T, YieldPolicy>::enqueue(T item) {
+  uint64_t thread_id = scal::reclaim_thread_hook() % num_ops_;
+  op(thread_id)->data = std::move(item);
+  set_op(thread_id, Opcode::Enqueue);
+  wait_or_combine(thread_id);
+  return true;
+}
+
+template<typename T, typename YieldPolicy>
+bool FlatCombiningQueue<T, YieldPolicy>::dequeue(T *item) {
+  uint64_t thread_id = scal::reclaim_thread_hook() % num_ops_;
+  set_op(thread_id, Opcode::Dequeue);
+  wait_or_combine(thread_id);
+  if (op(thread_id)->count == 0) {
     return false;
-  } else {
-    return true;
   }
+  *item = std::move(op(thread_id)->data);
+  return true;
+}
+
+template<typename T, typename YieldPolicy>
+uint64_t FlatCombiningQueue<T, YieldPolicy>::put_batch(T *items, uint64_t n) {
+  uint64_t thread_id = scal::reclaim_thread_hook() % num_ops_;
+  op(thread_id)->batch = items;
+  op(thread_id)->count = n;
+  set_op(thread_id, Opcode::EnqueueBatch);
+  wait_or_combine(thread_id);
+  return n;
+}
+
+template<typename T, typename YieldPolicy>
+uint64_t FlatCombiningQueue<T, YieldPolicy>::get_batch(T *items, uint64_t n) {
+  uint64_t thread_id = scal::reclaim_thread_hook() % num_ops_;
+  op(thread_id)->batch = items;
+  op(thread_id)->count = n;
+  set_op(thread_id, Opcode::DequeueBatch);
+  wait_or_combine(thread_id);
+  return op(thread_id)->count;
 }
 
 #endif  // SCAL_DATASTRUCTURES_FLATCOMBINING_QUEUE_H_
@@ -14,10 +14,13 @@
 #include <string.h>     // strerror_r
 #include <sys/time.h>   // gettimeofday
 
+#include <utility>
+
 #include "datastructures/queue.h"
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/threadlocals.h"
+#include "util/yield.h"
 
 namespace lb_details {
 
@@ -29,7 +32,11 @@ struct Node {
 
 }  // namespace lb_details
 
-template<typename T>
+// Dequeue modes: 0 returns false on an empty queue; 1 blocks until an item
+// arrives; 2 blocks for up to dequeue_timeout milliseconds. Blocked consumers
+// park on a condition variable through the YieldPolicy (see util/yield.h),
+// and enqueue only signals it while consumers are waiting.
+template<typename T, typename YieldPolicy = scal::NoYield>
 class LockBasedQueue : public Queue<T> {
  public:
   LockBasedQueue(uint64_t dequeue_mode, uint64_t dequeue_timeout);
@@ -57,6 +64,7 @@ class LockBasedQueue : public Queue<T> {
   Node *tail_;
   pthread_mutex_t *global_lock_;
   pthread_cond_t *enqueue_cond_;
+  uint64_t num_waiters_;  // Protected by global_lock_.
   uint64_t dequeue_mode_;
   uint64_t dequeue_timeout_;
 
@@ -72,10 +80,11 @@ class LockBasedQueue : public Queue<T> {
   bool dequeue_default(T *item);
   bool dequeue_blocking(T *item);
   bool dequeue_timeout(T *item, uint64_t timeout_ms);
+  bool dequeue_waiting(T *item, const struct timespec *deadline);
 };
 
-template<typename T>
-LockBasedQueue<T>::LockBasedQueue(uint64_t dequeue_mode,
+template<typename T, typename YieldPolicy>
+LockBasedQueue<T, YieldPolicy>::LockBasedQueue(uint64_t dequeue_mode,
                                   uint64_t dequeue_timeout) {
   global_lock_ = scal::get<pthread_mutex_t>(kPtrAlignment);
   int rc = pthread_mutex_init(global_lock_, NULL);
@@ -86,70 +95,58 @@ LockBasedQueue<T>::LockBasedQueue(uint64_t dequeue_mode,
   Node *node = scal::get<Node>(kPtrAlignment);
   head_ = node;
   tail_ = node;
+  num_waiters_ = 0;
   dequeue_mode_ = dequeue_mode;
   dequeue_timeout_ = dequeue_timeout;
 }
 
-template<typename T>
-bool LockBasedQueue<T>::enqueue(T item) {
+template<typename T, typename YieldPolicy>
+bool LockBasedQueue<T, YieldPolicy>::enqueue(T item) {
   Node *node = scal::tlget<Node>(kPtrAlignment);
-  node->value = item;
-  Yield();
+  node->value = std::move(item);
+  YieldPolicy::yield();
   int rc = pthread_mutex_lock(global_lock_);
   check_error("pthread_mutex_lock", rc);
   Node *tail_old = tail_;
   tail_old->next = node;
   tail_ = node;
-  rc = pthread_cond_broadcast(enqueue_cond_);
-  check_error("pthread_cond_broadcast", rc);
+  if (num_waiters_ > 0) {
+    // One item wakes one consumer.
+    rc = YieldPolicy::notify(enqueue_cond_);
+    check_error("pthread_cond_signal", rc);
+  }
   rc = pthread_mutex_unlock(global_lock_);
-  Yield();
+  YieldPolicy::yield();
   check_error("pthread_mutex_unlock", rc);
   return true;
 }
 
-template<typename T>
-bool LockBasedQueue<T>::dequeue_default(T *item) {
-  Yield();
+template<typename T, typename YieldPolicy>
+bool LockBasedQueue<T, YieldPolicy>::dequeue_default(T *item) {
+  YieldPolicy::yield();
   int rc = pthread_mutex_lock(global_lock_);
   check_error("pthread_mutex_lock", rc);
   if (head_ == tail_) {
     pthread_mutex_unlock(global_lock_);
-    Yield();
+    YieldPolicy::yield();
     check_error("pthread_mutex_unlock", rc);
     return false;
   }
-  *item = head_->next->value;
+  *item = std::move(head_->next->value);
   head_ = head_->next;
   rc = pthread_mutex_unlock(global_lock_);
-  Yield();
+  YieldPolicy::yield();
   check_error("pthread_mutex_unlock", rc);
   return true;
 }
 
-template<typename T>
-bool LockBasedQueue<T>::dequeue_blocking(T *item) {
-  int rc;
-  while (true) {
-    Yield();
-    rc = pthread_mutex_lock(global_lock_);
-    check_error("pthread_mutex_lock", rc);
-    while (head_ == tail_) {
-      pthread_cond_wait(enqueue_cond_, global_lock_);
-      Yield();
-    }
-    assert(head_ != tail_);
-    *item = head_->next->value;
-    head_ = head_->next;
-    rc = pthread_mutex_unlock(global_lock_);
-    Yield();
-    check_error("pthread_mutex_unlock", rc);
-    return true;
-  }
+template<typename T, typename YieldPolicy>
+bool LockBasedQueue<T, YieldPolicy>::dequeue_blocking(T *item) {
+  return dequeue_waiting(item, NULL);
 }
 
-template<typename T>
-bool LockBasedQueue<T>::dequeue_timeout(T *item, uint64_t timeout_ms) {
+template<typename T, typename YieldPolicy>
+bool LockBasedQueue<T, YieldPolicy>::dequeue_timeout(T *item, uint64_t timeout_ms) {
   int rc;
   struct timeval tp;
   struct timespec ts;
@@ -167,30 +164,41 @@ bool LockBasedQueue<T>::dequeue_timeout(T *item, uint64_t timeout_ms) {
   } else {
      ts.tv_nsec = tmp_nsec;
   }
+  return dequeue_waiting(item, &ts);
+}
 
-  while (true) {
-    Yield();
-    rc =pthread_mutex_lock(global_lock_);
-    check_error("pthread_mutex_lock", rc);
-    while (head_ == tail_) {
-      rc = pthread_cond_timedwait(enqueue_cond_, global_lock_, &ts);
-      Yield();
-      if (rc == ETIMEDOUT) {
-        rc = pthread_mutex_unlock(global_lock_);
-        Yield();
-        check_error("pthread_mutex_unlock", rc);
-        return false;
-      }
-      check_error("pthread_cond_timedwait", rc);
+// Waits until the queue is non-empty, or the deadline passed unless it is
+// NULL. A consumer which timed out still takes an item which arrived in the
+// meantime, since it may have consumed the signal for it.
+template<typename T, typename YieldPolicy>
+bool LockBasedQueue<T, YieldPolicy>::dequeue_waiting(
+    T *item, const struct timespec *deadline) {
+  YieldPolicy::yield();
+  int rc = pthread_mutex_lock(global_lock_);
+  check_error("pthread_mutex_lock", rc);
+  bool timed_out = false;
+  while (head_ == tail_) {
+    if (timed_out) {
+      rc = pthread_mutex_unlock(global_lock_);
+      YieldPolicy::yield();
+      check_error("pthread_mutex_unlock", rc);
+      return false;
+    }
+    num_waiters_++;
+    rc = YieldPolicy::wait(enqueue_cond_, global_lock_, deadline);
+    num_waiters_--;
+    if (rc == ETIMEDOUT) {
+      timed_out = true;
+    } else {
+      check_error("pthread_cond_wait", rc);
     }
-    assert(head_ != tail_);
-    *item = head_->next->value;
-    head_ = head_->next;
-    rc = pthread_mutex_unlock(global_lock_);
-    Yield();
-    check_error("pthread_mutex_unlock", rc);
-    return true;
   }
+  *item = std::move(head_->next->value);
+  head_ = head_->next;
+  rc = pthread_mutex_unlock(global_lock_);
+  YieldPolicy::yield();
+  check_error("pthread_mutex_unlock", rc);
+  return true;
 }
 
 #endif  // SCAL_DATASTRUCTURES_LOCKBASED_QUEUE_
@@ -14,6 +14,7 @@
 #define SCAL_DATASTRUCTURES_MS_QUEUE_H_
 
 #include <new>
+#include <utility>
 
 #include "datastructures/distributed_queue_interface.h"
 #include "datastructures/queue.h"
@@ -21,7 +22,9 @@
 #include "util/malloc.h"
 #include "util/operation_logger.h"
 #include "util/platform.h"
+#include "util/reclamation.h"
 #include "util/threadlocals.h"
+#include "util/yield.h"
 
 namespace ms_details {
 
@@ -33,7 +36,16 @@ struct Node {
 
 }  // namespace ms_details
 
-template<typename T>
+// With a Reclamation policy other than NoReclamation (see util/reclamation.h),
+// dequeued nodes are retired. try_enqueue and try_dequeue, whose callers read
+// the tail and head themselves, do not protect the nodes and need
+// NoReclamation.
+//
+// Only the dequeue whose CAS takes a node touches its item: it moves the item
+// out once the node is the sentinel, and destroys what is left, so that no
+// sentinel, retired or freed node holds a payload.
+template<typename T, typename YieldPolicy = scal::NoYield,
+         typename Reclamation = scal::NoReclamation>
 class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
  public:
   /*
@@ -62,6 +74,11 @@ class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
   bool enqueue(T item);
   bool dequeue(T *item);
 
+  // Links a whole chain of nodes with one CAS on the last next pointer, and
+  // unlinks up to n nodes with one CAS on the head.
+  uint64_t put_batch(T *items, uint64_t n);
+  uint64_t get_batch(T *items, uint64_t n);
+
   bool dequeue_return_tail(T *item, AtomicRaw *tail_raw);
   bool try_enqueue(T item, AtomicPointer<ms_details::Node<T>*> tail_old);
   uint8_t try_dequeue(T *item,
@@ -71,7 +88,7 @@ class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
   // Satisfy the DistributedQueueInterface
 
   inline bool put(T item) {
-    return enqueue(item);
+    return enqueue(std::move(item));
   }
 
   inline AtomicRaw empty_state() {
@@ -89,79 +106,97 @@ class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
   AtomicPointer<Node*> *tail_;
 
   inline Node* node_new(T item) const {
-    Node *node = scal::tlget_aligned<Node>(scal::kCachePrefetch);
+    Node *node = Reclamation::template get<Node>(scal::kCachePrefetch);
     node->next.weak_set_value(NULL);
     node->next.weak_set_aba(0);
-    node->value = item;
+    node->value = std::move(item);
     return node;
   }
+
+  static inline void take_value(Node *node, T *item) {
+    *item = std::move(node->value);
+    node->value.~T();
+  }
 };
 
-template<typename T>
-MSQueue<T>::MSQueue(void) {
+template<typename T, typename YieldPolicy, typename Reclamation>
+MSQueue<T, YieldPolicy, Reclamation>::MSQueue(void) {
   head_ = scal::get_aligned<AtomicPointer<Node*> >(4 * 128);
   tail_ = scal::get_aligned<AtomicPointer<Node*> >(4 * 128);
-  Node *node = node_new((T)NULL);
+  Node *node = node_new(T());
+  node->value.~T();
   head_->weak_set_value(node);
   tail_->weak_set_value(node);
 }
 
-template<typename T>
-bool MSQueue<T>::enqueue(T item) {
-  Node *node = node_new(item);
+template<typename T, typename YieldPolicy, typename Reclamation>
+bool MSQueue<T, YieldPolicy, Reclamation>::enqueue(T item) {
+  Node *node = node_new(std::move(item));
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> next;
+  Reclamation::enter();
   while (true) {
     tail_old = *tail_;
+    Reclamation::protect(0, tail_old.value());
+    if (tail_old.raw() != tail_->raw()) {
+      continue;
+    }
     next = tail_old.value()->next;
-    Yield();
+    YieldPolicy::yield();
     if (tail_old.raw() == tail_->raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (next.value() == NULL) {
         AtomicPointer<Node*> new_next(node, next.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (tail_old.value()->next.cas(next, new_next)) {
           scal::StdOperationLogger::get().linearization();
           break;
         }
       } else {
         AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, tail_new);
       }
     }
   }
   AtomicPointer<Node*> tail_new(node, tail_old.aba() + 1);
-  Yield();
+  YieldPolicy::yield();
   tail_->cas(tail_old, tail_new);
+  Reclamation::leave();
   return true;
 }
 
-template<typename T>
-bool MSQueue<T>::dequeue(T *item) {
+template<typename T, typename YieldPolicy, typename Reclamation>
+bool MSQueue<T, YieldPolicy, Reclamation>::dequeue(T *item) {
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> next;
+  Reclamation::enter();
   while (true) {
     head_old = *head_;
+    Reclamation::protect(0, head_old.value());
+    if (head_->raw() != head_old.raw()) {
+      continue;
+    }
     tail_old = *tail_;
     next = head_old.value()->next;
-    Yield();
+    Reclamation::protect(1, next.value());
+    YieldPolicy::yield();
     if (head_->raw() == head_old.raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (head_old.value() == tail_old.value()) {
-        Yield();
+        YieldPolicy::yield();
         if (next.value() == NULL) {
           scal::StdOperationLogger::get().linearization();
+          Reclamation::leave();
           return false;
         }
         AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, tail_new);
       } else {
-        *item = next.value()->value;
         AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (head_->cas(head_old, head_new)) {
           scal::StdOperationLogger::get().linearization();
           break;
@@ -169,32 +204,156 @@ bool MSQueue<T>::dequeue(T *item) {
       }
     }
   }
+  take_value(next.value(), item);
+  Reclamation::retire(head_old.value());
+  Reclamation::leave();
   return true;
 }
 
-template<typename T>
-bool MSQueue<T>::dequeue_return_tail(T *item, AtomicRaw *tail_raw) {
+template<typename T, typename YieldPolicy, typename Reclamation>
+uint64_t MSQueue<T, YieldPolicy, Reclamation>::put_batch(T *items, uint64_t n) {
+  if (n == 0) {
+    return 0;
+  }
+  Node *first = node_new(items[0]);
+  Node *last = first;
+  for (uint64_t i = 1; i < n; i++) {
+    Node *node = node_new(items[i]);
+    last->next.weak_set_value(node);
+    last = node;
+  }
+  AtomicPointer<Node*> tail_old;
+  AtomicPointer<Node*> next;
+  Reclamation::enter();
+  while (true) {
+    tail_old = *tail_;
+    Reclamation::protect(0, tail_old.value());
+    if (tail_old.raw() != tail_->raw()) {
+      continue;
+    }
+    next = tail_old.value()->next;
+    YieldPolicy::yield();
+    if (tail_old.raw() == tail_->raw()) {
+      YieldPolicy::yield();
+      if (next.value() == NULL) {
+        AtomicPointer<Node*> new_next(first, next.aba() + 1);
+        YieldPolicy::yield();
+        if (tail_old.value()->next.cas(next, new_next)) {
+          scal::StdOperationLogger::get().linearization();
+          break;
+        }
+      } else {
+        AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
+        YieldPolicy::yield();
+        tail_->cas(tail_old, tail_new);
+      }
+    }
+  }
+  // Others may help the tail along the chain one node at a time; the tail
+  // aba counter ends up n ahead either way.
+  AtomicPointer<Node*> tail_new(last, tail_old.aba() + n);
+  YieldPolicy::yield();
+  tail_->cas(tail_old, tail_new);
+  Reclamation::leave();
+  return n;
+}
+
+template<typename T, typename YieldPolicy, typename Reclamation>
+uint64_t MSQueue<T, YieldPolicy, Reclamation>::get_batch(T *items, uint64_t n) {
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> next;
+  uint64_t done = 0;
+  Reclamation::enter();
+  while (done < n) {
+    head_old = *head_;
+    Reclamation::protect(0, head_old.value());
+    if (head_->raw() != head_old.raw()) {
+      continue;
+    }
+    tail_old = *tail_;
+    next = head_old.value()->next;
+    Reclamation::protect(1, next.value());
+    YieldPolicy::yield();
+    if (head_->raw() == head_old.raw()) {
+      YieldPolicy::yield();
+      if (head_old.value() == tail_old.value()) {
+        YieldPolicy::yield();
+        if (next.value() == NULL) {
+          scal::StdOperationLogger::get().linearization();
+          break;
+        }
+        AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
+        YieldPolicy::yield();
+        tail_->cas(tail_old, tail_new);
+      } else {
+        // Never move the head past the tail we have seen, so that the head
+        // does not overtake a lagging tail. Nodes are protected hand over
+        // hand; they stay in the queue as long as the head does not change.
+        Node *last = next.value();
+        uint64_t count = 1;
+        int hazard = 1;
+        while (done + count < n && last != tail_old.value()) {
+          next = last->next;
+          if (next.value() == NULL) {
+            break;
+          }
+          hazard = 3 - hazard;
+          Reclamation::protect(hazard, next.value());
+          if (head_->raw() != head_old.raw()) {
+            break;
+          }
+          last = next.value();
+          count++;
+        }
+        AtomicPointer<Node*> head_new(last, head_old.aba() + count);
+        YieldPolicy::yield();
+        if (head_->cas(head_old, head_new)) {
+          scal::StdOperationLogger::get().linearization();
+          Node *node = head_old.value();
+          while (node != last) {
+            Node *unlinked = node;
+            node = node->next.value();
+            take_value(node, &items[done++]);
+            Reclamation::retire(unlinked);
+          }
+        }
+      }
+    }
+  }
+  Reclamation::leave();
+  return done;
+}
+
+template<typename T, typename YieldPolicy, typename Reclamation>
+bool MSQueue<T, YieldPolicy, Reclamation>::dequeue_return_tail(T *item, AtomicRaw *tail_raw) {
+  AtomicPointer<Node*> tail_old;
+  AtomicPointer<Node*> head_old;
+  AtomicPointer<Node*> next;
+  Reclamation::enter();
   while (true) {
     head_old = *head_;
+    Reclamation::protect(0, head_old.value());
+    if (head_->raw() != head_old.raw()) {
+      continue;
+    }
     tail_old = *tail_;
     next = head_old.value()->next;
+    Reclamation::protect(1, next.value());
     if (head_->raw() == head_old.raw()) {
       if (head_old.value() == tail_old.value()) {
         if (next.value() == NULL) {
           scal::StdOperationLogger::get().linearization();
           *tail_raw = tail_old.raw();
+          Reclamation::leave();
           return false;
         }
         AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, tail_new);
       } else {
-        *item = next.value()->value;
         AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (head_->cas(head_old, head_new)) {
           scal::StdOperationLogger::get().linearization();
           *tail_raw = tail_old.raw();
@@ -203,36 +362,39 @@ bool MSQueue<T>::dequeue_return_tail(T *item, AtomicRaw *tail_raw) {
       }
     }
   }
+  take_value(next.value(), item);
+  Reclamation::retire(head_old.value());
+  Reclamation::leave();
   return true;
 }
 
-template<typename T>
-bool MSQueue<T>::try_enqueue(
+template<typename T, typename YieldPolicy, typename Reclamation>
+bool MSQueue<T, YieldPolicy, Reclamation>::try_enqueue(
     T item, AtomicPointer<ms_details::Node<T>*> tail_old) {
   AtomicPointer<Node*> next = tail_old.value()->next;
   if (tail_->raw() == tail_old.raw()) {
     if (next.value() == NULL) {
       Node *node = node_new(item);
       AtomicPointer<Node*> new_next(node, next.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       if (tail_old.value()->next.cas(next, new_next)) {
         scal::StdOperationLogger::get().linearization();
         AtomicPointer<Node*> tail_new(node, tail_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, tail_new);
         return true;
       }
     } else {
       AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       tail_->cas(tail_old, tail_new);
     }
   }
   return false;
 }
 
-template<typename T>
-uint8_t MSQueue<T>::try_dequeue(
+template<typename T, typename YieldPolicy, typename Reclamation>
+uint8_t MSQueue<T, YieldPolicy, Reclamation>::try_dequeue(
     T *item, AtomicPointer<ms_details::Node<T>*> head_old, uint64_t *tail_raw) {
   AtomicPointer<Node*> tail_old = *tail_;
   AtomicPointer<Node*> next = head_old.value()->next;
@@ -244,15 +406,15 @@ uint8_t MSQueue<T>::try_dequeue(
         return 1;  // empty
       }
       AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       tail_->cas(tail_old, tail_new);
       *tail_raw = tail_new.aba();
     } else {
-      *item = next.value()->value;
       AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       if (head_->cas(head_old, head_new)) {
         scal::StdOperationLogger::get().linearization();
+        take_value(next.value(), item);
         *tail_raw = tail_old.aba();
         return 0;  // ok
       }
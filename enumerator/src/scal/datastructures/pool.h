@@ -5,12 +5,34 @@
 #ifndef SCAL_DATASTRUCTURES_POOL_H_
 #define SCAL_DATASTRUCTURES_POOL_H_
 
+#include <inttypes.h>
+
 template<typename T>
 class Pool {
  public:
   virtual bool put(T item) = 0;
   virtual bool get(T *item) = 0;
 
+  // Batch operations are not atomic: each item is put or got on its own,
+  // in batch order, within the call. They return how many items were put,
+  // resp. got; get_batch gets fewer than n items only if the pool was empty.
+  // These generic versions loop over put and get.
+  virtual uint64_t put_batch(T *items, uint64_t n) {
+    uint64_t i = 0;
+    while (i < n && put(items[i])) {
+      i++;
+    }
+    return i;
+  }
+
+  virtual uint64_t get_batch(T *items, uint64_t n) {
+    uint64_t i = 0;
+    while (i < n && get(&items[i])) {
+      i++;
+    }
+    return i;
+  }
+
   virtual ~Pool() {}
 };
 
@@ -5,6 +5,8 @@
 #ifndef SCAL_DATASTRUCTURES_QUEUE_H_
 #define SCAL_DATASTRUCTURES_QUEUE_H_
 
+#include <utility>
+
 #include "datastructures/pool.h"
 
 template<typename T>
@@ -14,7 +16,7 @@ class Queue : public Pool<T> {
   virtual bool dequeue(T *item) = 0;
 
   virtual inline bool put(T item) {
-    return enqueue(item);
+    return enqueue(std::move(item));
   }
 
   virtual inline bool get(T *item) {
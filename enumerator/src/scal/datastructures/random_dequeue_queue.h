@@ -29,6 +29,7 @@
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
+#include "util/yield.h"
 
 namespace rd_details {
 
@@ -41,7 +42,7 @@ struct Node {
 
 }  // namespace rd_details
 
-template<typename T>
+template<typename T, typename YieldPolicy = scal::NoYield>
 class RandomDequeueQueue : public Queue<T> {
  public:
   RandomDequeueQueue(uint64_t quasi_factor, uint64_t max_retries);
@@ -57,8 +58,8 @@ class RandomDequeueQueue : public Queue<T> {
   AtomicPointer<Node*> *tail_;
 };
 
-template<typename T>
-RandomDequeueQueue<T>::RandomDequeueQueue(uint64_t quasi_factor,
+template<typename T, typename YieldPolicy>
+RandomDequeueQueue<T, YieldPolicy>::RandomDequeueQueue(uint64_t quasi_factor,
                                           uint64_t max_retries) {
   quasi_factor_ = quasi_factor;
   Node *n = scal::get<Node>(scal::kCachePrefetch);
@@ -68,8 +69,8 @@ RandomDequeueQueue<T>::RandomDequeueQueue(uint64_t quasi_factor,
   tail_->set_value(n);
 }
 
-template<typename T> bool
-RandomDequeueQueue<T>::enqueue(T item) {
+template<typename T, typename YieldPolicy> bool
+RandomDequeueQueue<T, YieldPolicy>::enqueue(T item) {
   assert(item != (T)NULL);
   Node *node = scal::tlget<Node>(scal::kCachePrefetch);
   node->value = item;
@@ -78,30 +79,30 @@ RandomDequeueQueue<T>::enqueue(T item) {
   while (true) {
     tail_old = *tail_;
     next = tail_old.value()->next;
-    Yield();
+    YieldPolicy::yield();
     if (tail_old.raw() == tail_->raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (next.value() == NULL) {
         AtomicPointer<Node*> next_new(node, next.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (tail_old.value()->next.cas(next, next_new)) {
           break;
         }
       } else {
         AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, tail_new);
       }
     }
   }
   AtomicPointer<Node*> tail_new(node, tail_old.aba() + 1);
-  Yield();
+  YieldPolicy::yield();
   tail_->cas(tail_old, tail_new);
   return true;
 }
 
-template<typename T>
-bool RandomDequeueQueue<T>::dequeue(T *item) {
+template<typename T, typename YieldPolicy>
+bool RandomDequeueQueue<T, YieldPolicy>::dequeue(T *item) {
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> next;
@@ -112,16 +113,16 @@ bool RandomDequeueQueue<T>::dequeue(T *item) {
     head_old = *head_;
     tail_old = *tail_;
     next = head_old.value()->next;
-    Yield();
+    YieldPolicy::yield();
     if (head_->raw() == head_old.raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (head_old.value() == tail_old.value()) {
-        Yield();
+        YieldPolicy::yield();
         if (next.value() == NULL) {
           return false;
         }
         AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, tail_new);
       } else {
         if (retries >= max_retries_) {
@@ -135,11 +136,11 @@ bool RandomDequeueQueue<T>::dequeue(T *item) {
         if (random_index == 0) {
           while (node != NULL && node->deleted == true) {
             AtomicPointer<Node*> head_new(node, head_old.aba() + 1);
-            Yield();
+            YieldPolicy::yield();
             if (!head_->cas(head_old, head_new) || node == tail_old.value()) {
               goto TOP_WHILE;
             }
-            Yield();
+            YieldPolicy::yield();
             head_old = head_new;
             next = head_old.value()->next;
             node = next.value();
@@ -147,7 +148,7 @@ bool RandomDequeueQueue<T>::dequeue(T *item) {
           if (node == NULL) {
             return false;
           }
-          Yield();
+          YieldPolicy::yield();
           if (node->deleted == false &&
               __sync_bool_compare_and_swap(&(node->deleted), false, true)) {
             *item = node->value;
@@ -158,7 +159,7 @@ bool RandomDequeueQueue<T>::dequeue(T *item) {
           for (i = 0; i < random_index && node->next.value() != NULL; ++i) {
             node = node->next.value();
           }
-          Yield();
+          YieldPolicy::yield();
           if (node->deleted == false &&
               __sync_bool_compare_and_swap(&(node->deleted), false, true)) {
             *item = node->value;
@@ -10,10 +10,13 @@
 
 #include <stdlib.h>
 
+#include <utility>
+
 #include "datastructures/queue.h"
 #include "util/malloc.h"
+#include "util/yield.h"
 
-template<typename T>
+template<typename T, typename YieldPolicy = scal::NoYield>
 class SingleList : public Queue<T> {
  public:
   SingleList();
@@ -32,15 +35,15 @@ class SingleList : public Queue<T> {
   Node<T> *tail_;
 };
 
-template<typename T>
-SingleList<T>::SingleList() {
+template<typename T, typename YieldPolicy>
+SingleList<T, YieldPolicy>::SingleList() {
   Node<T> *n = scal::get<Node<T> >(0);
   head_ = n;
   tail_ = n;
 }
 
-template<typename T>
-bool SingleList<T>::is_empty() const {
+template<typename T, typename YieldPolicy>
+bool SingleList<T, YieldPolicy>::is_empty() const {
   if (head_ == tail_) {
     return true;
   } else {
@@ -48,27 +51,26 @@ bool SingleList<T>::is_empty() const {
   }
 }
 
-template<typename T>
-bool SingleList<T>::enqueue(T item) {
+template<typename T, typename YieldPolicy>
+bool SingleList<T, YieldPolicy>::enqueue(T item) {
   Node<T> *n = scal::tlget<Node<T> >(0);
-  n->value = item;
-  Yield();
+  n->value = std::move(item);
+  YieldPolicy::yield();
   tail_->next = n;
-  Yield();
+  YieldPolicy::yield();
   tail_ = n;
   return true;
 }
 
-template<typename T>
-bool SingleList<T>::dequeue(T *item) {
+template<typename T, typename YieldPolicy>
+bool SingleList<T, YieldPolicy>::dequeue(T *item) {
   if (head_ == tail_) {
-    Yield();
-    *item = (T)NULL;
+    YieldPolicy::yield();
     return false;
   } else {
-    Yield();
-    *item = head_->next->value;
-    Yield();
+    YieldPolicy::yield();
+    *item = std::move(head_->next->value);
+    YieldPolicy::yield();
     head_ = head_->next;
     return true;
   }
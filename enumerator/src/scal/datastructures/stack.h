@@ -5,6 +5,8 @@
 #ifndef SCAL_DATASTRUCTURES_STACK_H_
 #define SCAL_DATASTRUCTURES_STACK_H_
 
+#include <utility>
+
 #include "datastructures/pool.h"
 
 template<typename T>
@@ -14,7 +16,7 @@ class Stack : public Pool<T> {
   virtual bool pop(T *item) = 0;
 
   inline bool put(T item) {
-    return push(item);
+    return push(std::move(item));
   }
 
   inline bool get(T *item) {
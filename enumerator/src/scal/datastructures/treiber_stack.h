@@ -10,11 +10,15 @@
 #ifndef SCAL_DATASTRUCTURES_TREIBER_STACK_H_
 #define SCAL_DATASTRUCTURES_TREIBER_STACK_H_
 
+#include <utility>
+
 #include "datastructures/distributed_queue_interface.h"
 #include "datastructures/stack.h"
 #include "util/atomic_value.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/reclamation.h"
+#include "util/yield.h"
 
 namespace ts_internal {
 
@@ -26,7 +30,11 @@ struct Node {
 
 }  // namespace ts_internal
 
-template<typename T>
+// With a Reclamation policy other than NoReclamation (see util/reclamation.h),
+// popped nodes are retired, once their item is moved out and what is left of
+// it destroyed.
+template<typename T, typename YieldPolicy = scal::NoYield,
+         typename Reclamation = scal::NoReclamation>
 class TreiberStack : public Stack<T> {
  public:
   TreiberStack();
@@ -36,7 +44,7 @@ class TreiberStack : public Stack<T> {
   // Satisfy the DistributedQueueInterface
 
   inline bool put(T item) {
-    return push(item);
+    return push(std::move(item));
   }
 
   inline AtomicRaw empty_state() {
@@ -51,68 +59,87 @@ class TreiberStack : public Stack<T> {
   AtomicPointer<Node*> *top_;
 };
 
-template<typename T>
-TreiberStack<T>::TreiberStack() {
+template<typename T, typename YieldPolicy, typename Reclamation>
+TreiberStack<T, YieldPolicy, Reclamation>::TreiberStack() {
   top_ = scal::get<AtomicPointer<Node*> >(scal::kCachePrefetch);
 }
 
-template<typename T>
-bool TreiberStack<T>::push(T item) {
-  Node *n = scal::tlget<Node>(0);
-  n->data = item;
+template<typename T, typename YieldPolicy, typename Reclamation>
+bool TreiberStack<T, YieldPolicy, Reclamation>::push(T item) {
+  Node *n = Reclamation::template get<Node>(0);
+  n->data = std::move(item);
   AtomicPointer<Node*> top_old;
   AtomicPointer<Node*> top_new;
   top_new.weak_set_value(n);
   do {
-    Yield();
+    YieldPolicy::yield();
     top_old = *top_;
-    Yield();
+    YieldPolicy::yield();
     n->next.weak_set_value(top_old.value());
-    Yield();
+    YieldPolicy::yield();
     top_new.weak_set_aba(top_old.aba() + 1);
-    Yield();
+    YieldPolicy::yield();
   } while (!top_->cas(top_old, top_new));
   return true;
 }
 
-template<typename T>
-bool TreiberStack<T>::pop(T *item) {
+template<typename T, typename YieldPolicy, typename Reclamation>
+bool TreiberStack<T, YieldPolicy, Reclamation>::pop(T *item) {
   AtomicPointer<Node*> top_old;
   AtomicPointer<Node*> top_new;
+  Reclamation::enter();
   do {
-    Yield();
+    YieldPolicy::yield();
     top_old = *top_;
-    Yield();
+    YieldPolicy::yield();
     if (top_old.value() == NULL) {
+      Reclamation::leave();
       return false;
     }
-    Yield();
+    Reclamation::protect(0, top_old.value());
+    if (top_old.raw() != top_->raw()) {
+      continue;  // The top changed, so the CAS below fails.
+    }
+    YieldPolicy::yield();
     top_new.weak_set_value(top_old.value()->next.value());
-    Yield();
+    YieldPolicy::yield();
     top_new.weak_set_aba(top_old.aba() + 1);
-    Yield();
+    YieldPolicy::yield();
   } while (!top_->cas(top_old, top_new));
-  Yield();
-  *item = top_old.value()->data;
+  YieldPolicy::yield();
+  *item = std::move(top_old.value()->data);
+  top_old.value()->data.~T();
+  Reclamation::retire(top_old.value());
+  Reclamation::leave();
   return true;
 }
 
-template<typename T>
-inline bool TreiberStack<T>::get_return_empty_state(T *item, AtomicRaw *state) {
+template<typename T, typename YieldPolicy, typename Reclamation>
+inline bool TreiberStack<T, YieldPolicy, Reclamation>::get_return_empty_state(
+    T *item, AtomicRaw *state) {
   AtomicPointer<Node*> top_old;
   AtomicPointer<Node*> top_new;
+  Reclamation::enter();
   do {
     top_old = *top_;
     if (top_old.value() == NULL) {
       *state = top_old.raw();
+      Reclamation::leave();
       return false;
     }
+    Reclamation::protect(0, top_old.value());
+    if (top_old.raw() != top_->raw()) {
+      continue;  // The top changed, so the CAS below fails.
+    }
     top_new.weak_set_value(top_old.value()->next.value());
     top_new.weak_set_aba(top_old.aba() + 1);
-    Yield();
+    YieldPolicy::yield();
   } while (!top_->cas(top_old, top_new));
-  *item = top_old.value()->data;
+  *item = std::move(top_old.value()->data);
+  top_old.value()->data.~T();
   *state = top_old.raw();
+  Reclamation::retire(top_old.value());
+  Reclamation::leave();
   return true;
 }
 
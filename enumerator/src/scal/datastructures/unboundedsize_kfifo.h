@@ -20,6 +20,7 @@
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
+#include "util/yield.h"
 
 namespace uskfifo_details {
 
@@ -33,13 +34,18 @@ struct KSegment {
 
 }  // namespace uskfifo_details
 
-template<typename T>
+template<typename T, typename YieldPolicy = scal::NoYield>
 class UnboundedSizeKFifo : public Queue<T> {
  public:
   explicit UnboundedSizeKFifo(uint64_t k);
   bool enqueue(T item);
   bool dequeue(T *item);
 
+  // Fill, resp. empty, several slots of a segment per head and tail
+  // snapshot, as long as that snapshot stays current.
+  uint64_t put_batch(T *items, uint64_t n);
+  uint64_t get_batch(T *items, uint64_t n);
+
  private:
   typedef uskfifo_details::KSegment<T> KSegment;
 
@@ -67,8 +73,8 @@ class UnboundedSizeKFifo : public Queue<T> {
   }
 };
 
-template<typename T>
-uskfifo_details::KSegment<T>* UnboundedSizeKFifo<T>::ksegment_new() {
+template<typename T, typename YieldPolicy>
+uskfifo_details::KSegment<T>* UnboundedSizeKFifo<T, YieldPolicy>::ksegment_new() {
   KSegment *ksegment = static_cast<KSegment*>(scal::tlcalloc(
       1, sizeof(KSegment)));
   ksegment->k = k_;
@@ -82,8 +88,8 @@ uskfifo_details::KSegment<T>* UnboundedSizeKFifo<T>::ksegment_new() {
   return ksegment;
 }
 
-template<typename T>
-UnboundedSizeKFifo<T>::UnboundedSizeKFifo(uint64_t k) {
+template<typename T, typename YieldPolicy>
+UnboundedSizeKFifo<T, YieldPolicy>::UnboundedSizeKFifo(uint64_t k) {
   k_ = k;
   KSegment *ksegment = ksegment_new();
 
@@ -93,8 +99,8 @@ UnboundedSizeKFifo<T>::UnboundedSizeKFifo(uint64_t k) {
   tail_->weak_set_value(ksegment);
 }
 
-template<typename T>
-void UnboundedSizeKFifo<T>::advance_head(
+template<typename T, typename YieldPolicy>
+void UnboundedSizeKFifo<T, YieldPolicy>::advance_head(
     AtomicPointer<uskfifo_details::KSegment<T>*> head_old) {
   AtomicPointer<KSegment*> head_current = get_head();
   if (head_current.raw() == head_old.raw()) {
@@ -108,20 +114,20 @@ void UnboundedSizeKFifo<T>::advance_head(
         }
         if (tail_current.raw() == get_tail().raw()) {
           tail_next_ksegment.set_aba(tail_current.aba() + 1);
-          Yield();
+          YieldPolicy::yield();
           tail_->cas(tail_current, tail_next_ksegment);
         }
       }
       head_old.value()->deleted = true;
       head_next_ksegment.set_aba(head_old.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       head_->cas(head_old, head_next_ksegment);
     }
   }
 }
 
-template<typename T>
-void UnboundedSizeKFifo<T>::advance_tail(
+template<typename T, typename YieldPolicy>
+void UnboundedSizeKFifo<T, YieldPolicy>::advance_tail(
     AtomicPointer<uskfifo_details::KSegment<T>*> tail_old) {
   AtomicPointer<KSegment*> tail_current = get_tail();
   AtomicPointer<KSegment*> next_ksegment;
@@ -130,16 +136,16 @@ void UnboundedSizeKFifo<T>::advance_tail(
     if (tail_old.raw() == get_tail().raw()) {
       if (next_ksegment.value() != NULL) {
         next_ksegment.set_aba(next_ksegment.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         tail_->cas(tail_old, next_ksegment);
       } else {
         KSegment *ksegment = ksegment_new();
         AtomicPointer<KSegment*> new_ksegment(
             ksegment, next_ksegment.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (tail_old.value()->next.cas(next_ksegment, new_ksegment)) {
           new_ksegment.set_aba(tail_old.aba() + 1);
-          Yield();
+          YieldPolicy::yield();
           tail_->cas(tail_old, new_ksegment);
         }
       }
@@ -147,8 +153,8 @@ void UnboundedSizeKFifo<T>::advance_tail(
   }
 }
 
-template<typename T>
-void UnboundedSizeKFifo<T>::find_index(
+template<typename T, typename YieldPolicy>
+void UnboundedSizeKFifo<T, YieldPolicy>::find_index(
     uskfifo_details::KSegment<T> *start_index, bool empty, int64_t *item_index,
     AtomicValue<T> *old) {
   uint64_t random_index = pseudorand() % start_index->k;
@@ -165,8 +171,8 @@ void UnboundedSizeKFifo<T>::find_index(
   }
 }
 
-template<typename T>
-bool UnboundedSizeKFifo<T>::committed(
+template<typename T, typename YieldPolicy>
+bool UnboundedSizeKFifo<T, YieldPolicy>::committed(
     AtomicPointer<uskfifo_details::KSegment<T>*> tail_old,
     AtomicValue<T> *new_item,
     uint64_t item_index) {
@@ -178,18 +184,18 @@ bool UnboundedSizeKFifo<T>::committed(
 
   if (tail_old.value()->deleted == true) {
     // Not in queue anymore.
-    Yield();
+    YieldPolicy::yield();
     if (!tail_old.value()->items[item_index]->cas(*new_item, empty_item)) {
       return true;
     }
   } else if (tail_old.value() == head_current.value()) {
     AtomicPointer<KSegment*> head_new = head_current;
     head_new.weak_set_aba(head_new.aba() + 1);
-    Yield();
+    YieldPolicy::yield();
     if (head_->cas(head_current, head_new)) {
       return true;
     }
-    Yield();
+    YieldPolicy::yield();
     if (!tail_old.value()->items[item_index]->cas(*new_item, empty_item)) {
       return true;
     }
@@ -197,7 +203,7 @@ bool UnboundedSizeKFifo<T>::committed(
     // In queue and inserted tail not head.
     return true;
   } else {
-    Yield();
+    YieldPolicy::yield();
     if (!tail_old.value()->items[item_index]->cas(*new_item, empty_item)) {
       return true;
     }
@@ -205,8 +211,8 @@ bool UnboundedSizeKFifo<T>::committed(
   return false;
 }
 
-template<typename T>
-bool UnboundedSizeKFifo<T>::dequeue(T *item) {
+template<typename T, typename YieldPolicy>
+bool UnboundedSizeKFifo<T, YieldPolicy>::dequeue(T *item) {
   AtomicPointer<KSegment*> tail_old;
   AtomicPointer<KSegment*> head_old;
   int64_t item_index;
@@ -221,7 +227,7 @@ bool UnboundedSizeKFifo<T>::dequeue(T *item) {
           advance_tail(tail_old);
         }
         AtomicValue<T> newcp((T)NULL, old_item.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (head_old.value()->items[item_index]->cas(old_item, newcp)) {
           *item = old_item.value();
           return true;
@@ -236,8 +242,8 @@ bool UnboundedSizeKFifo<T>::dequeue(T *item) {
   }
 }
 
-template<typename T>
-bool UnboundedSizeKFifo<T>::enqueue(T item) {
+template<typename T, typename YieldPolicy>
+bool UnboundedSizeKFifo<T, YieldPolicy>::enqueue(T item) {
   if (item == (T)NULL) {
     printf("%s: unable to enqueue NULL or equivalent value\n", __func__);
     abort();
@@ -249,13 +255,13 @@ bool UnboundedSizeKFifo<T>::enqueue(T item) {
   while (true) {
     tail_old = get_tail();
     head_old = get_head();
-    Yield();
+    YieldPolicy::yield();
     find_index(tail_old.value(), true, &item_index, &old_item);
     if (tail_old.raw() == tail_->raw()) {
       if (item_index != kNoIndexFound) {
-        Yield();
+        YieldPolicy::yield();
         AtomicValue<T> newcp(item, old_item.aba() + 1);
-        Yield();
+        YieldPolicy::yield();
         if (tail_old.value()->items[item_index]->cas(old_item, newcp)) {
           if (committed(tail_old, &newcp, item_index)) {
             return true;
@@ -268,4 +274,93 @@ bool UnboundedSizeKFifo<T>::enqueue(T item) {
   }
 }
 
+template<typename T, typename YieldPolicy>
+uint64_t UnboundedSizeKFifo<T, YieldPolicy>::get_batch(T *items, uint64_t n) {
+  AtomicPointer<KSegment*> tail_old;
+  AtomicPointer<KSegment*> head_old;
+  int64_t item_index;
+  AtomicValue<T> old_item;
+  uint64_t done = 0;
+  while (done < n) {
+    head_old = get_head();
+    find_index(head_old.value(), false, &item_index, &old_item);
+    tail_old = get_tail();
+    if (head_old.raw() == head_->raw()) {
+      if (item_index != kNoIndexFound) {
+        if (head_old.value() == tail_old.value()) {
+          advance_tail(tail_old);
+        }
+        // Keep taking items from this segment until it looks empty.
+        while (item_index != kNoIndexFound) {
+          AtomicValue<T> newcp((T)NULL, old_item.aba() + 1);
+          YieldPolicy::yield();
+          if (!head_old.value()->items[item_index]->cas(old_item, newcp)) {
+            break;
+          }
+          items[done++] = old_item.value();
+          if (done == n) {
+            return done;
+          }
+          find_index(head_old.value(), false, &item_index, &old_item);
+          if (head_old.raw() != head_->raw()) {
+            break;
+          }
+        }
+      } else {
+        if (head_old.value() == tail_old.value()) {
+          return done;
+        }
+        advance_head(head_old);
+      }
+    }
+  }
+  return done;
+}
+
+template<typename T, typename YieldPolicy>
+uint64_t UnboundedSizeKFifo<T, YieldPolicy>::put_batch(T *items, uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    if (items[i] == (T)NULL) {
+      printf("%s: unable to enqueue NULL or equivalent value\n", __func__);
+      abort();
+    }
+  }
+  AtomicPointer<KSegment*> tail_old;
+  AtomicPointer<KSegment*> head_old;
+  int64_t item_index;
+  AtomicValue<T> old_item;
+  uint64_t done = 0;
+  while (done < n) {
+    tail_old = get_tail();
+    head_old = get_head();
+    YieldPolicy::yield();
+    find_index(tail_old.value(), true, &item_index, &old_item);
+    if (tail_old.raw() == tail_->raw()) {
+      if (item_index != kNoIndexFound) {
+        // Keep filling this segment until it looks full; each item is
+        // committed on its own.
+        while (item_index != kNoIndexFound) {
+          YieldPolicy::yield();
+          AtomicValue<T> newcp(items[done], old_item.aba() + 1);
+          YieldPolicy::yield();
+          if (!tail_old.value()->items[item_index]->cas(old_item, newcp)
+              || !committed(tail_old, &newcp, item_index)) {
+            break;
+          }
+          if (++done == n) {
+            return done;
+          }
+          find_index(tail_old.value(), true, &item_index, &old_item);
+          if (tail_old.raw() != tail_->raw()) {
+            break;
+          }
+        }
+      } else {
+        advance_tail(tail_old);
+      }
+    }
+  }
+  return done;
+}
+
 #endif  // SCAL_DATASTRUCTURES_UNBOUNDEDSIZE_KFIFO_H_
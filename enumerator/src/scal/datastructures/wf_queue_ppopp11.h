@@ -8,6 +8,10 @@
 // dequeuers. In Proceedings of the 16th ACM symposium on Principles and
 // practice of parallel programming, PPoPP ’11, pages 223–234, New York, NY,
 // USA, 2011. ACM.
+//
+// Each thread announces its operations in a state slot of its own, which it
+// finds by the thread hook of the reclamation records (see
+// util/reclamation.h), modulo the number of threads.
 
 #ifndef SCAL_DATASTRUCTURES_WF_QUEUE_PPOPP11_H_
 #define SCAL_DATASTRUCTURES_WF_QUEUE_PPOPP11_H_
@@ -19,7 +23,9 @@
 #include "util/atomic_value.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/reclamation.h"
 #include "util/threadlocals.h"
+#include "util/yield.h"
 
 namespace wf_details {
 
@@ -80,7 +86,7 @@ struct OperationDescriptor {
 
 }  // namespace wf_details
 
-template<typename T>
+template<typename T, typename YieldPolicy = scal::NoYield>
 class WaitfreeQueue : public Queue<T> {
  public:
   explicit WaitfreeQueue(uint64_t num_threads);
@@ -107,8 +113,8 @@ class WaitfreeQueue : public Queue<T> {
   volatile AtomicPointer<OperationDescriptor*> **state_;
 };
 
-template<typename T>
-WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads) {
+template<typename T, typename YieldPolicy>
+WaitfreeQueue<T, YieldPolicy>::WaitfreeQueue(uint64_t num_threads) {
   num_threads_ = num_threads;
 
   // Create sentinel node.
@@ -123,8 +129,8 @@ WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads) {
 
   // Each thread gets its own OperationDescriptor.
   state_ = const_cast<volatile AtomicPointer<OperationDescriptor*>**>(
-      static_cast<AtomicPointer<OperationDescriptor*>**>(calloc(
-          num_threads_, sizeof(AtomicPointer<OperationDescriptor*>*))));
+      static_cast<AtomicPointer<OperationDescriptor*>**>(scal::calloc_aligned(
+          num_threads_, sizeof(AtomicPointer<OperationDescriptor*>*), 0)));
   for (uint64_t i = 0; i < num_threads_; i++) {
     OperationDescriptor *opdesc = scal::get<OperationDescriptor>(kPtrAlignment);
     opdesc->init(OperationDescriptor::kNoPhase,
@@ -136,8 +142,8 @@ WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads) {
   }
 }
 
-template<typename T>
-int64_t WaitfreeQueue<T>::max_phase(void) {
+template<typename T, typename YieldPolicy>
+int64_t WaitfreeQueue<T, YieldPolicy>::max_phase(void) {
   int64_t max_phase = OperationDescriptor::kNoPhase;
   for (uint64_t i = 0; i < num_threads_; i++) {
     int64_t phase = state_[i]->value()->phase;
@@ -148,14 +154,14 @@ int64_t WaitfreeQueue<T>::max_phase(void) {
   return max_phase;
 }
 
-template <typename T>
-bool WaitfreeQueue<T>::is_still_pending(uint64_t thread_id, int64_t phase) {
+template<typename T, typename YieldPolicy>
+bool WaitfreeQueue<T, YieldPolicy>::is_still_pending(uint64_t thread_id, int64_t phase) {
   return state_[thread_id]->value()->pending &&
          state_[thread_id]->value()->phase <= phase;
 }
 
-template<typename T>
-void WaitfreeQueue<T>::help(int64_t phase) {
+template<typename T, typename YieldPolicy>
+void WaitfreeQueue<T, YieldPolicy>::help(int64_t phase) {
   for (uint64_t i = 0; i < num_threads_; i++) {
     volatile OperationDescriptor *desc = state_[i]->value();
     if (desc->pending && desc->phase <= phase) {
@@ -171,11 +177,11 @@ void WaitfreeQueue<T>::help(int64_t phase) {
   }
 }
 
-template<typename T>
-bool WaitfreeQueue<T>::enqueue(T item) {
+template<typename T, typename YieldPolicy>
+bool WaitfreeQueue<T, YieldPolicy>::enqueue(T item) {
   assert(item != (T)NULL);
   int64_t phase = max_phase() + 1;
-  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  uint64_t thread_id = scal::reclaim_thread_hook() % num_threads_;
   Node *node = scal::tlget<Node>(kPtrAlignment);
   node->init(item, thread_id);
   OperationDescriptor *opdesc = scal::tlget<OperationDescriptor>(kPtrAlignment);
@@ -188,23 +194,23 @@ bool WaitfreeQueue<T>::enqueue(T item) {
   return true;
 }
 
-template<typename T>
-void WaitfreeQueue<T>::help_enqueue(uint64_t thread_id, int64_t phase) {
+template<typename T, typename YieldPolicy>
+void WaitfreeQueue<T, YieldPolicy>::help_enqueue(uint64_t thread_id, int64_t phase) {
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> next;
   while (is_still_pending(thread_id, phase)) {
-    Yield();
+    YieldPolicy::yield();
     tail_old = *tail_;
     next = tail_old.value()->next;
-    Yield();
+    YieldPolicy::yield();
     if (tail_old.raw() == tail_->raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (next.value() == NULL) {
-        Yield();
+        YieldPolicy::yield();
         if (is_still_pending(thread_id, phase)) {
           AtomicPointer<Node*> new_next(state_[thread_id]->value()->node,
                                         next.aba() + 1);
-          Yield();
+          YieldPolicy::yield();
           if (tail_old.value()->next.cas(next, new_next)) {
             help_finish_enqueue();
             return;
@@ -217,16 +223,16 @@ void WaitfreeQueue<T>::help_enqueue(uint64_t thread_id, int64_t phase) {
   }
 }
 
-template<typename T>
-void WaitfreeQueue<T>::help_finish_enqueue(void) {
+template<typename T, typename YieldPolicy>
+void WaitfreeQueue<T, YieldPolicy>::help_finish_enqueue(void) {
   AtomicPointer<Node*> tail_old = *tail_;
   AtomicPointer<Node*> next = tail_old.value()->next;
-  Yield();
+  YieldPolicy::yield();
   if (next.value() != NULL) {
-    Yield();
+    YieldPolicy::yield();
     uint64_t thread_id = next.value()->enq_tid;
     AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
-    Yield();
+    YieldPolicy::yield();
     if ((tail_old.raw() == tail_->raw())
         && ((state_[thread_id]->value())->node == next.value())) {
       OperationDescriptor *new_desc =
@@ -235,19 +241,19 @@ void WaitfreeQueue<T>::help_finish_enqueue(void) {
                      OperationDescriptor::Type::kEnqueue, next.value());
       AtomicPointer<OperationDescriptor*> new_state(new_desc,
                                                     cur_state.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       state_[thread_id]->cas(cur_state, new_state);
       AtomicPointer<Node*> new_tail(next.value(), tail_old.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       tail_->cas(tail_old, new_tail);
     }
   }
 }
 
-template<typename T>
-bool WaitfreeQueue<T>::dequeue(T *item) {
+template<typename T, typename YieldPolicy>
+bool WaitfreeQueue<T, YieldPolicy>::dequeue(T *item) {
   int64_t phase = max_phase() + 1;
-  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  uint64_t thread_id = scal::reclaim_thread_hook() % num_threads_;
   OperationDescriptor *opdesc = scal::tlget<OperationDescriptor>(kPtrAlignment);
   opdesc->init(phase, true, OperationDescriptor::Type::kDequeue, NULL);
   AtomicPointer<OperationDescriptor*> new_state(opdesc,
@@ -263,24 +269,24 @@ bool WaitfreeQueue<T>::dequeue(T *item) {
   return true;
 }
 
-template<typename T>
-void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
+template<typename T, typename YieldPolicy>
+void WaitfreeQueue<T, YieldPolicy>::help_dequeue(uint64_t thread_id, int64_t phase) {
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> next;
   while (is_still_pending(thread_id, phase)) {
-    Yield();
+    YieldPolicy::yield();
     head_old = *head_;
     tail_old = *tail_;
     next = head_old.value()->next;
-    Yield();
+    YieldPolicy::yield();
     if (head_->raw() == head_old.raw()) {
-      Yield();
+      YieldPolicy::yield();
       if (head_old.value() == tail_old.value()) {
-        Yield();
+        YieldPolicy::yield();
         if (next.value() == NULL) {  // Queue is empty.
           AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
-          Yield();
+          YieldPolicy::yield();
           if (tail_old.value() == tail_->value()
               && is_still_pending(thread_id, phase)) {
             OperationDescriptor *new_desc =
@@ -291,7 +297,7 @@ void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
                            NULL);
             AtomicPointer<OperationDescriptor*> new_state(new_desc,
                                                         cur_state.aba() + 1);
-            Yield();
+            YieldPolicy::yield();
             // If the next CAS fails, another thread changed the state, which
             // is also ok since the descriptor will not indicate pending in the
             // next try.
@@ -301,26 +307,26 @@ void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
           help_finish_enqueue();
         }
       } else {  // Queue is not empty.
-        Yield();
+        YieldPolicy::yield();
         AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
         OperationDescriptor *cur_desc = cur_state.value();
         Node *node = cur_desc->node;
-        Yield();
+        YieldPolicy::yield();
         if (!is_still_pending(thread_id, phase)) {
           break;
         }
-        Yield();
+        YieldPolicy::yield();
         if (head_->raw() == head_old.raw()
             && node != head_old.value()) {
           OperationDescriptor *new_desc =
               scal::tlget<OperationDescriptor>(kPtrAlignment);
-          Yield();
+          YieldPolicy::yield();
           new_desc->init(state_[thread_id]->value()->phase, true,
                          OperationDescriptor::Type::kDequeue,
                          head_old.value());
           AtomicPointer<OperationDescriptor*> new_state(new_desc,
               cur_state.aba() + 1);
-          Yield();
+          YieldPolicy::yield();
           if (!state_[thread_id]->cas(cur_state, new_state)) {
             continue;
           }
@@ -328,7 +334,7 @@ void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
         // We ignore ABA counter on this one.
         AtomicValue<uint64_t> old_deq_tid(Node::kTidNotSet, 0);
         AtomicValue<uint64_t> new_deq_tid(thread_id, 0);
-        Yield();
+        YieldPolicy::yield();
         head_old.value()->deq_tid.cas(old_deq_tid, new_deq_tid);
         help_finish_dequeue();
       }
@@ -336,15 +342,15 @@ void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
   }
 }
 
-template<typename T>
-void WaitfreeQueue<T>::help_finish_dequeue(void) {
+template<typename T, typename YieldPolicy>
+void WaitfreeQueue<T, YieldPolicy>::help_finish_dequeue(void) {
   AtomicPointer<Node*> head_old = *head_;
   AtomicPointer<Node*> next = head_old.value()->next;
   uint64_t thread_id = head_old.value()->deq_tid.value();
-  Yield();
+  YieldPolicy::yield();
   if (thread_id != Node::kTidNotSet) {
     AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
-    Yield();
+    YieldPolicy::yield();
     if (head_old.raw() == head_->raw()
         && next.value() != NULL) {
       OperationDescriptor *new_desc =
@@ -355,10 +361,10 @@ void WaitfreeQueue<T>::help_finish_dequeue(void) {
                      state_[thread_id]->value()->node);
       AtomicPointer<OperationDescriptor*> new_state(new_desc,
                                                     cur_state.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       state_[thread_id]->cas(cur_state, new_state);
       AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
-      Yield();
+      YieldPolicy::yield();
       head_->cas(head_old, head_new);
     }
   }
@@ -200,8 +200,8 @@ WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads,
 
   // Each thread gets its own OperationDescriptor.
   state_ = const_cast<volatile AtomicPointer<OperationDescriptor*>**>(
-      static_cast<AtomicPointer<OperationDescriptor*>**>(calloc(
-          num_threads_, sizeof(AtomicPointer<OperationDescriptor*>*))));
+      static_cast<AtomicPointer<OperationDescriptor*>**>(scal::calloc_aligned(
+          num_threads_, sizeof(AtomicPointer<OperationDescriptor*>*), 0)));
   for (uint64_t i = 0; i < num_threads_; i++) {
     OperationDescriptor *opdesc = scal::get<OperationDescriptor>(kPtrAlignment);
     opdesc->init(OperationDescriptor::kNoPhase,
@@ -214,8 +214,8 @@ WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads,
 
   HelpRecord::prepare(num_threads_, helping_delay_, state_);
   // Each thread gets its own HelpRecord.
-  records_ = const_cast<volatile HelpRecord**>(static_cast<HelpRecord**>(calloc(
-      num_threads_, sizeof(*records_))));
+  records_ = const_cast<volatile HelpRecord**>(static_cast<HelpRecord**>(
+      scal::calloc_aligned(num_threads_, sizeof(*records_), 0)));
   for (uint64_t i = 0; i < num_threads_; i++) {
     records_[i] = scal::get<HelpRecord>(kPtrAlignment);
   }
@@ -0,0 +1,30 @@
+// Merges the results of the shards of a search, as written by
+// ./scal -shard I/N -shard_results FILE, into the summary which the whole
+// search prints; see violin_merge_shards in include/violin.h.
+
+#include <gflags/gflags.h>
+#include <sstream>
+#include <iostream>
+
+#include "violin.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+
+  stringstream usage;
+  usage << "usage" << endl;
+  usage << "  " << argv[0] << " RESULTS..." << endl;
+  usage << "  merges the results files of all shards of a search.";
+
+  google::SetUsageMessage(usage.str());
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 2) {
+    cerr << "Must specify the results of each shard; see --help for usage." << endl;
+    exit(-1);
+  }
+
+  vector<string> files(argv + 1, argv + argc);
+  return violin_merge_shards(files) == 0 ? 0 : 1;
+}
@@ -6,10 +6,14 @@
 
 #include "scal.h"
 
+#include "datastructures/balancer_2choices.h"
+#include "datastructures/balancer_numa.h"
 #include "datastructures/balancer_partrr.h"
 #include "datastructures/boundedsize_kfifo.h"
 #include "datastructures/distributed_queue.h"
 #include "datastructures/dts_queue.h"
+#include "datastructures/elimination_stack.h"
+#include "datastructures/adaptive_fc_queue.h"
 #include "datastructures/flatcombining_queue.h"
 #include "datastructures/kstack.h"
 #include "datastructures/lockbased_queue.h"
@@ -27,6 +31,8 @@
 #include "datastructures/unboundedsize_kfifo.h"
 #include "datastructures/wf_queue_ppopp11.h"
 // #include "datastructures/wf_queue_ppopp12.h"
+#include "util/payload.h"
+#include "util/reclamation.h"
 
 const string DEFAULT_PAGE_SIZE = "1k";
 const unsigned DEFAULT_K = 10;
@@ -34,12 +40,15 @@ const unsigned DEFAULT_NUM_SEGMENTS = 1000;
 const unsigned DEFAULT_NUM_QUEUES = 2;
 const unsigned DEFAULT_PARTITIONS = 2;
 const unsigned DEFAULT_DEQUEUE_MODE = 0; // from 0,1,2
-const unsigned DEFAULT_DEQUEUE_TIMEOUT = 0;
+const unsigned DEFAULT_DEQUEUE_TIMEOUT = 1; // ms, for dequeue mode 2
 const unsigned DEFAULT_NUM_OPS = 2;
 const unsigned DEFAULT_QUASI_FACTOR = 2;
 const unsigned DEFAULT_MAX_RETRIES = 2;
 const unsigned DEFAULT_DELAY = 2;
 const unsigned DEFAULT_HELPING_DELAY = 2;
+const unsigned DEFAULT_ELIMINATION_SPINS = 2;
+const unsigned DEFAULT_COMBINING_PASSES = 3;
+const unsigned DEFAULT_COMBINING_MAX_AGE = 16; // passes
 
 extern uint64_t g_num_threads;
 uint64_t g_num_threads;
@@ -50,10 +59,15 @@ unsigned partitions;
 unsigned dequeue_mode;
 unsigned dequeue_timeout;
 unsigned num_ops;               // must be at least the number of threads
+unsigned num_slots;             // of wfq11, likewise
 unsigned quasi_factor;
 unsigned max_retries;
 unsigned delay;
 unsigned helping_delay;
+unsigned elimination_width;     // half the number of threads, at least 1
+unsigned elimination_spins;
+unsigned combining_passes;
+unsigned combining_max_age;
 
 map<string,obj_desc> objects;
 map<uint64_t,bool> thread_initialized;
@@ -69,23 +83,36 @@ void thread_initialize(uint64_t id) {
 #define DECLARE_OBJ(ID,NAME,SPEC) \
   objects[ID] = { .id = ID, .name = NAME, .spec = SPEC }
 
-void scal_initialize(unsigned num_threads) {
-  DECLARE_OBJ("bkq",    "Bounded-size-K-FIFO",    "atomic-queue");
-  DECLARE_OBJ("dq",     "Distributed-Queue",      "atomic-queue");
+void scal_declare_objects(void) {
+  DECLARE_OBJ("afcq",   "Adaptive-FC-Queue",      "atomic-queue");
+  DECLARE_OBJ("bkq",    "Bounded-size-K-FIFO",    "relaxed-queue");
+  DECLARE_OBJ("dq",     "Distributed-Queue",      "relaxed-queue");
+  DECLARE_OBJ("dq-2c",  "Distributed-Queue-2C",   "relaxed-queue");
+  DECLARE_OBJ("dq-numa","Distributed-Queue-NUMA", "relaxed-queue");
   DECLARE_OBJ("dtsq",   "DTS-Queue",              "atomic-queue");
+  DECLARE_OBJ("es",     "Elimination-Stack",      "atomic-stack");
   DECLARE_OBJ("fcq",    "Flat-combining-Queue",   "atomic-queue");
-  DECLARE_OBJ("ks",     "K-Stack",                "atomic-stack");
+  DECLARE_OBJ("ks",     "K-Stack",                "relaxed-stack");
   DECLARE_OBJ("lbq",    "Lock-based-Queue",       "atomic-queue");
+  DECLARE_OBJ("lbq-b",  "Lock-based-Queue-Blocking", "atomic-queue");
   DECLARE_OBJ("msq",    "MS-Queue",               "atomic-queue");
-  DECLARE_OBJ("rdq",    "Random-dequeue-Queue",   "atomic-queue");
+  DECLARE_OBJ("msq-ebr","MS-Queue-EBR",           "atomic-queue");
+  DECLARE_OBJ("msq-hp", "MS-Queue-HP",            "atomic-queue");
+  DECLARE_OBJ("rdq",    "Random-dequeue-Queue",   "relaxed-queue");
   DECLARE_OBJ("sl",     "Single-List",            "atomic-queue");
   DECLARE_OBJ("ts",     "Treiber-Stack",          "atomic-stack");
+  DECLARE_OBJ("ts-ebr", "Treiber-Stack-EBR",      "atomic-stack");
+  DECLARE_OBJ("ts-hp",  "Treiber-Stack-HP",       "atomic-stack");
   DECLARE_OBJ("tsd",    "TS-Deque",               "atomic-collection");
   DECLARE_OBJ("tss",    "TS-Stack",               "atomic-stack");
   DECLARE_OBJ("tsq",    "TS-Queue",               "atomic-queue");
-  DECLARE_OBJ("ukq",    "Unbounded-size-K-FIFO",  "atomic-queue");
+  DECLARE_OBJ("ukq",    "Unbounded-size-K-FIFO",  "relaxed-queue");
   DECLARE_OBJ("wfq11",  "Wait-free-Queue-2011", "atomic-queue");
   DECLARE_OBJ("wfq12",  "Wait-free-Queue-2012", "atomic-queue");
+}
+
+void scal_initialize(unsigned num_threads) {
+  scal_declare_objects();
 
 	k = DEFAULT_K;
 	num_segments = DEFAULT_NUM_SEGMENTS;
@@ -94,10 +121,15 @@ void scal_initialize(unsigned num_threads) {
 	dequeue_mode = DEFAULT_DEQUEUE_MODE;
 	dequeue_timeout = DEFAULT_DEQUEUE_TIMEOUT;
 	num_ops = max(DEFAULT_NUM_OPS,num_threads);
+	num_slots = num_threads;
 	quasi_factor = DEFAULT_QUASI_FACTOR;
 	max_retries = DEFAULT_MAX_RETRIES;
 	delay = DEFAULT_DELAY;
 	helping_delay = DEFAULT_HELPING_DELAY;
+	elimination_width = max(1u,num_threads/2);
+	elimination_spins = DEFAULT_ELIMINATION_SPINS;
+	combining_passes = DEFAULT_COMBINING_PASSES;
+	combining_max_age = DEFAULT_COMBINING_MAX_AGE;
 
 	g_num_threads = num_threads;
   thread_initialize(0);
@@ -105,48 +137,133 @@ void scal_initialize(unsigned num_threads) {
   scal::ThreadContext::assign_context();
 }
 
-Pool<int>* obj_create(string obj) {
-  if (obj == "bkq")
-    return new BoundedSizeKFifo<int>(k, num_segments);
+void scal_initialize_slots(unsigned num_threads) {
+  num_ops = max(num_ops,num_threads);
+  num_slots = max(num_slots,num_threads);
+}
+
+void scal_initialize_thread(void) {
+  uint64_t tlsize = scal::human_size_to_pages(
+    DEFAULT_PAGE_SIZE.c_str(),DEFAULT_PAGE_SIZE.size());
+  scal::tlalloc_init(tlsize, true /* touch pages */);
+  scal::ThreadContext::assign_private_context(0);
+}
+
+void scal_finalize_thread(void) {
+  scal::ThreadContext::release_private_context();
+  scal::tlalloc_destroy();
+}
+
+// Objects which keep their items in nodes take payloads of any type (see
+// util/payload.h); returns NULL for the others.
+template<typename T, typename Y>
+Pool<T>* node_obj_create_with(string obj) {
+  if (obj == "afcq")
+    return new AdaptiveFlatCombiningQueue<T,Y>(combining_passes, combining_max_age);
+  else if (obj == "fcq")
+    return new FlatCombiningQueue<T,Y>(num_ops);
+  else if (obj == "lbq")
+    return new LockBasedQueue<T,Y>(dequeue_mode, dequeue_timeout);
+  else if (obj == "lbq-b")
+    return new LockBasedQueue<T,Y>(2, dequeue_timeout);
+  else if (obj == "msq")
+    return new MSQueue<T,Y>();
+  else if (obj == "msq-ebr")
+    return new MSQueue<T,Y,scal::EpochReclamation>();
+  else if (obj == "msq-hp")
+    return new MSQueue<T,Y,scal::HazardPointerReclamation>();
+  else if (obj == "sl")
+    // Sequential, so only atomic without yields inside.
+    return new SingleList<T>();
+  else if (obj == "ts")
+    return new TreiberStack<T,Y>();
+  else if (obj == "ts-ebr")
+    return new TreiberStack<T,Y,scal::EpochReclamation>();
+  else if (obj == "ts-hp")
+    return new TreiberStack<T,Y,scal::HazardPointerReclamation>();
+  else
+    return NULL;
+}
+
+// The others take word-sized payloads only.
+template<typename T, typename Y>
+Pool<T>* obj_create_with(string obj) {
+  Pool<T> *node_obj = node_obj_create_with<T,Y>(obj);
+  if (node_obj != NULL)
+    return node_obj;
+  else if (obj == "bkq")
+    return new BoundedSizeKFifo<T,Y>(k, num_segments);
   else if (obj == "dq")
-    return new DistributedQueue< int, MSQueue<int> >(num_queues,g_num_threads,new BalancerPartitionedRoundRobin(partitions,num_queues));
+    return new DistributedQueue< T, MSQueue<T,Y> >(num_queues,g_num_threads,new BalancerPartitionedRoundRobin(partitions,num_queues));
+  else if (obj == "dq-2c")
+    return new DistributedQueue< T, MSQueue<T,Y> >(num_queues,g_num_threads,new BalancerTwoChoices());
+  else if (obj == "dq-numa")
+    return new DistributedQueue< T, MSQueue<T,Y> >(num_queues,g_num_threads,new BalancerNumaLocal(num_queues));
   else if (obj == "dtsq")
     // FIXME malloc-checksum error in the constructor
-    return new DTSQueue<int>(g_num_threads);
-  else if (obj == "lbq")
-    return new LockBasedQueue<int>(dequeue_mode, dequeue_timeout);
-  else if (obj == "msq")
-    return new MSQueue<int>();
-  else if (obj == "fcq")
-    return new FlatCombiningQueue<int>(num_ops);
+    return new DTSQueue<T>(g_num_threads);
+  else if (obj == "es")
+    return new EliminationStack<T,Y>(elimination_width, elimination_spins);
   else if (obj == "ks")
     // FIXME segmentation fault in the consructor
-    return new KStack<int>(k, g_num_threads);
+    return new KStack<T>(k, g_num_threads);
   else if (obj == "rdq")
-    return new RandomDequeueQueue<int>(quasi_factor, max_retries);
-  else if (obj == "sl")
-    return new SingleList<int>();
-  else if (obj == "ts")
-    return new TreiberStack<int>();
+    return new RandomDequeueQueue<T,Y>(quasi_factor, max_retries);
   else if (obj == "tsd")
     // FIXME malloc-checksum error in the constructor
-    return new TSDeque<int,TSDequeBuffer<int,HardwareTimestamp>,HardwareTimestamp>(g_num_threads, delay);
+    return new TSDeque<T,TSDequeBuffer<T,HardwareTimestamp>,HardwareTimestamp>(g_num_threads, delay);
   else if (obj == "tsq")
     // FIXME malloc-checksum error in the constructor
-    return new TSQueue<int,TSQueueBuffer<int,HardwareTimestamp>,HardwareTimestamp>(g_num_threads, delay);
+    return new TSQueue<T,TSQueueBuffer<T,HardwareTimestamp>,HardwareTimestamp>(g_num_threads, delay);
   else if (obj == "tss")
     // FIXME malloc-checksum error in the constructor
-    return new TSStack<int,TSStackBuffer<int,HardwareTimestamp>,HardwareTimestamp>(g_num_threads, delay);
+    return new TSStack<T,TSStackBuffer<T,HardwareTimestamp>,HardwareTimestamp>(g_num_threads, delay);
   else if (obj == "ukq")
-    return new UnboundedSizeKFifo<int>(k);
+    return new UnboundedSizeKFifo<T,Y>(k);
   else if (obj == "wfq11")
-    return new WaitfreeQueue<int>(g_num_threads);
+    return new WaitfreeQueue<T,Y>(num_slots);
   // else if (obj == "wfq12")
-  //   return new WaitfreeQueue<int>(g_num_threads, max_retries, helping_delay);
+  //   return new WaitfreeQueue<T>(g_num_threads, max_retries, helping_delay);
   else
     assert(false && "Unexpected object name.");
 }
 
+template<typename T, typename Y, bool word_sized = scal::PayloadTraits<T>::kWordSized>
+struct PayloadObjects {
+  static Pool<T>* create(string obj) {
+    return obj_create_with<T,Y>(obj);
+  }
+};
+
+template<typename T, typename Y>
+struct PayloadObjects<T,Y,false> {
+  static Pool<T>* create(string obj) {
+    return node_obj_create_with<T,Y>(obj);
+  }
+};
+
+template<typename T>
+Pool<T>* obj_create_payload(string obj, scal_yield_t yield) {
+  switch (yield) {
+  case NO_YIELD: return PayloadObjects<T,scal::NoYield>::create(obj);
+  case SWITCH_YIELD: return PayloadObjects<T,scal::SwitchYield>::create(obj);
+  case FOOTPRINT_YIELD: return PayloadObjects<T,scal::FootprintYield>::create(obj);
+  case PERTURB_YIELD: return PayloadObjects<T,scal::PerturbYield>::create(obj);
+  default: return PayloadObjects<T,scal::RandomDelayYield>::create(obj);
+  }
+}
+
+template Pool<int>* obj_create_payload(string, scal_yield_t);
+template Pool<scal::MovablePayload*>* obj_create_payload(string, scal_yield_t);
+template Pool<scal::MovablePayload>* obj_create_payload(string, scal_yield_t);
+template Pool<scal::Payload<16> >* obj_create_payload(string, scal_yield_t);
+template Pool<scal::Payload<64> >* obj_create_payload(string, scal_yield_t);
+template Pool<scal::Payload<256> >* obj_create_payload(string, scal_yield_t);
+
+Pool<int>* obj_create(string obj, scal_yield_t yield) {
+  return obj_create_payload<int>(obj, yield);
+}
+
 string obj_name(string id) {
   if (objects.count(id) > 0)
     return objects[id].name;
@@ -161,8 +278,22 @@ string obj_spec(string id) {
     return "???";
 }
 
+// How many of the first values a removal of a relaxed object may return.
+// The distributed queue has no strict bound; one value per partial queue
+// is its nominal relaxation.
+unsigned obj_relaxation(string id) {
+  if (id == "bkq" || id == "ukq" || id == "ks")
+    return k;
+  else if (id == "rdq")
+    return quasi_factor;
+  else if (id == "dq" || id == "dq-2c" || id == "dq-numa")
+    return num_queues;
+  else
+    return 1;
+}
+
 void* scal_object_create(const char* id) {
-  return static_cast<void*>(obj_create(string(id)));
+  return static_cast<void*>(obj_create(string(id), RANDOM_YIELD));
 }
 
 void scal_object_delete(void* obj) {
@@ -191,14 +322,3 @@ int scal_object_get(void* obj) {
   else
     return -1;
 }
-
-void dilly_dally() {
-  if (g_num_threads < 2)
-    return;
-
-  int x = rand();
-  if ((x % 2) == 0) {
-    int us = 1 << (x % 10 + 8);
-    usleep( us );
-  }
-}
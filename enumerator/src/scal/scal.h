@@ -17,6 +17,11 @@ extern "C" {
   int scal_object_get(void*);
 }
 
+// Which YieldPolicy the objects are instantiated with; see util/yield.h.
+enum scal_yield_t {
+  NO_YIELD, SWITCH_YIELD, FOOTPRINT_YIELD, RANDOM_YIELD, PERTURB_YIELD
+};
+
 struct obj_desc {
   string id;
   string name;
@@ -27,18 +32,32 @@ extern map<string,obj_desc> objects;
 
 string obj_name(string id);
 string obj_spec(string id);
+unsigned obj_relaxation(string id);
 
+// Fills objects; also done by scal_initialize.
+void scal_declare_objects(void);
 void scal_initialize(unsigned num_threads);
-
-Pool<int>* obj_create(string obj);
+// Objects with a request slot per thread, fcq and wfq11, find the slot of the
+// calling thread by scal::reclaim_thread_hook (see util/reclamation.h). Gives
+// them slots for num_threads threads, if more than those of scal_initialize,
+// e.g. for enumerated threads, which share the context of their OS thread.
+void scal_initialize_slots(unsigned num_threads);
+// Prepares another thread to create and use objects of its own, as the
+// first thread of scal_initialize: with thread id 0, and its own buffer;
+// scal_finalize_thread releases both.
+void scal_initialize_thread(void);
+void scal_finalize_thread(void);
+
+Pool<int>* obj_create(string obj, scal_yield_t yield);
+
+// Objects for other payload types than int (see util/payload.h): all objects
+// take word-sized ones, such as MovablePayload*, while for the others it
+// returns NULL unless the object keeps its items in nodes. Instantiated for
+// int, MovablePayload*, MovablePayload, and Payload<N> for N in 16, 64, 256.
+template<typename T>
+Pool<T>* obj_create_payload(string obj, scal_yield_t yield);
 void scal_object_delete(void*);
 void scal_object_put(void* obj, int v);
 int scal_object_get(void* obj);
 
-void dilly_dally();
-
-#ifndef Yield
-  #define Yield() dilly_dally();
-#endif
-
 #endif
@@ -0,0 +1,199 @@
+/*****************************************************************************/
+/** STRESS TESTING ON REAL THREADS                                          **/
+/*****************************************************************************
+ * Instead of enumerating schedules, run rounds of the same operations as
+ * violin() on real pthreads, with the object instantiated under the
+ * PerturbYield policy. Every invocation and response is stamped with
+ * get_hwtime through the scal operation logger; after each round the stamps
+ * are merged into one history, which is replayed into the usual
+ * ViolinListener and its counting monitor.
+ *
+ * Operation i runs on thread i % num_threads, in the order of the operation
+ * vector, so threads may issue several operations per round.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <algorithm>
+
+#include "util/malloc.h"
+#include "util/operation_logger.h"
+#include "util/threadlocals.h"
+#include "util/time.h"
+#include "util/yield.h"
+
+struct StressEvent {
+  uint64_t time;
+  int op;
+  bool is_return;
+
+  // On equal stamps calls go first, so such operations count as overlapping.
+  bool operator<(const StressEvent &e) const {
+    if (time != e.time) return time < e.time;
+    return !is_return && e.is_return;
+  }
+};
+
+struct StressThread {
+  uint64_t id;
+  vector<int> ops;
+  vector<bool> is_add;
+  pthread_t handle;
+};
+
+struct StressRun {
+  vector<Operation*> *operations;
+  vector<StressThread> threads;
+  uint64_t prealloc_pages;
+  pthread_barrier_t barrier;
+  volatile bool done;
+};
+
+void* stress_thread(void *context) {
+  pair<StressRun*,StressThread*> *args = (pair<StressRun*,StressThread*>*) context;
+  StressRun *run = args->first;
+  StressThread *t = args->second;
+  vector<Operation*> &operations = *run->operations;
+
+  scal::ThreadContext::assign_context(t->id);
+  scal::tlalloc_init(run->prealloc_pages, true);
+
+  while (true) {
+    pthread_barrier_wait(&run->barrier);
+    if (run->done)
+      break;
+
+    scal::TLOperationLoggerInterface<uint64_t> &log =
+      scal::StdOperationLogger::get();
+
+    for (int i = 0; i < t->ops.size(); i++) {
+      Operation *op = operations[t->ops[i]];
+      if (t->is_add[i]) {
+        log.invoke(scal::kEnqueue);
+        op->run();
+        log.response(true, ((AddOperation*) op)->getParameter());
+      } else {
+        log.invoke(scal::kDequeue);
+        op->run();
+        int r = ((RemoveOperation*) op)->getResult();
+        log.response(r != EMPTY_VAL, r);
+      }
+    }
+    pthread_barrier_wait(&run->barrier);
+  }
+  return NULL;
+}
+
+int violin_stress(
+    Object obj,
+    int num_adds,
+    int num_removes,
+    violin_order_t container_order,
+    int num_barriers,
+    int num_threads,
+    int num_rounds,
+    int pct_depth,
+    int spin_ns,
+    violin_show_t show,
+    int relaxation = 1) {
+
+  ViolinListener v(obj,show);
+  // The listener sees each operation as a thread of its own.
+  for (int i=0; i<num_adds; i++)
+    v.addProgram({new AddOperation(obj.add,i+1)});
+  for (int i=0; i<num_removes; i++)
+    v.addProgram({new RemoveOperation(obj.remove)});
+  v.addMonitor(
+    new CollectionCountingMonitor(
+      num_barriers+1, num_adds, container_order, true, false, relaxation));
+
+  violin_out() << "Violin: A Linearization-Violation Detector." << endl;
+  violin_out() << "Stress mode w/ "
+       << num_adds << " adds, "
+       << num_removes << " removes, "
+       << num_threads << " threads, "
+       << num_rounds << " rounds, "
+       << num_barriers << " barriers." << endl;
+
+  StressRun run;
+  run.operations = &v.operations;
+  run.threads.resize(num_threads);
+  run.done = false;
+  run.prealloc_pages = scal::human_size_to_pages("16m", 3);
+  pthread_barrier_init(&run.barrier, NULL, num_threads + 1);
+
+  // Worker threads use context ids 1..num_threads; 0 is the main thread.
+  for (int t=0; t<num_threads; t++)
+    run.threads[t].id = t + 1;
+  for (int i=0; i<v.operations.size(); i++) {
+    StressThread &t = run.threads[i % num_threads];
+    t.ops.push_back(i);
+    t.is_add.push_back(dynamic_cast<AddOperation*>(v.operations[i]) != NULL);
+  }
+
+  int ops_per_thread = (v.operations.size() + num_threads - 1) / num_threads;
+  scal::StdOperationLogger::prepare(num_threads + 1, ops_per_thread);
+  scal::perturb_configure(num_threads + 1, pct_depth, spin_ns);
+
+  vector< pair<StressRun*,StressThread*> > args(num_threads);
+  for (int t=0; t<num_threads; t++) {
+    args[t] = make_pair(&run, &run.threads[t]);
+    pthread_create(&run.threads[t].handle, NULL, stress_thread, &args[t]);
+  }
+
+  vector<StressEvent> events;
+  timeval start_time, end_time;
+  gettimeofday(&start_time,0);
+
+  for (int round=0; round<num_rounds; round++) {
+    v.onPreExecute();
+    scal::StdOperationLogger::reset();
+    scal::perturb_new_round(round);
+
+    pthread_barrier_wait(&run.barrier);
+    pthread_barrier_wait(&run.barrier);
+
+    events.clear();
+    for (int t=0; t<num_threads; t++) {
+      StressThread &thread = run.threads[t];
+      scal::TLOperationLogger<uint64_t> *log =
+        scal::StdOperationLogger::logger(thread.id);
+      for (int i=0; i<log->count(); i++) {
+        scal::Operation<uint64_t> *o = log->operation(i);
+        events.push_back({o->invocation, thread.ops[i], false});
+        events.push_back({o->response, thread.ops[i], true});
+      }
+    }
+    sort(events.begin(), events.end());
+    for (int i=0; i<events.size(); i++) {
+      if (events[i].is_return)
+        v.onComplete(events[i].op);
+      else
+        v.onResume(events[i].op);
+    }
+    v.onPostExecute();
+  }
+
+  gettimeofday(&end_time,0);
+  run.done = true;
+  pthread_barrier_wait(&run.barrier);
+  for (int t=0; t<num_threads; t++)
+    pthread_join(run.threads[t].handle, NULL);
+  pthread_barrier_destroy(&run.barrier);
+
+  float diff = round(
+    difftime(end_time.tv_sec,start_time.tv_sec)*100 +
+    difftime(end_time.tv_usec,start_time.tv_usec)/10000)/100;
+  long num_ops = (long) num_rounds * v.operations.size();
+
+  violin_out() << violin_context->num_executions << " rounds (" << num_ops << " operations) checked in "
+       << diff << "s";
+  if (diff > 0)
+    violin_out() << " (" << (long) (num_ops / diff) << " ops/s)";
+  violin_out() << "." << endl;
+
+  for (int i=0; i<v.monitors.size(); i++)
+    violin_out() << v.monitors[i]->getName() << " saw "
+         << v.monitors[i]->numViolations() << " violations." << endl;
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/arena.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+namespace {
+
+// As malloc, for allocations which ask for no alignment.
+const size_t kMinAlignment = 16;
+
+// Per thread, such that each thread may allocate from an arena of its own.
+__thread scal::Arena *active_arena = NULL;
+
+}  // namespace
+
+namespace scal {
+
+Arena::Arena(size_t capacity)
+    : capacity_(capacity), used_(0), image_(NULL) {
+  void *mem = mmap(NULL, capacity_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    abort();
+  }
+  memory_ = static_cast<char*>(mem);
+}
+
+Arena::~Arena() {
+  if (active_arena == this) {
+    active_arena = NULL;
+  }
+  munmap(memory_, capacity_);
+  free(image_);
+}
+
+void Arena::activate(void) {
+  active_arena = this;
+}
+
+void Arena::deactivate(void) {
+  if (active_arena == this) {
+    active_arena = NULL;
+  }
+}
+
+Arena* Arena::active(void) {
+  return active_arena;
+}
+
+// Fresh mmap pages are zeroed, and the arena is never freed into, so
+// allocations need no memset.
+void* Arena::allocate(size_t size, size_t alignment) {
+  if (alignment < kMinAlignment) {
+    alignment = kMinAlignment;
+  }
+  size_t start = used_;
+  if (start % alignment != 0) {
+    start = (start / alignment + 1) * alignment;
+  }
+  if (start + size > capacity_) {
+    fprintf(stderr, "%s: error: arena of %lu bytes is full\n",
+            __func__, static_cast<unsigned long>(capacity_));
+    abort();
+  }
+  used_ = start + size;
+  return memory_ + start;
+}
+
+bool Arena::contains(const void *p) const {
+  const char *c = static_cast<const char*>(p);
+  return c >= memory_ && c < memory_ + capacity_;
+}
+
+void Arena::save(void) {
+  free(image_);
+  image_ = static_cast<char*>(malloc(used_));
+  memcpy(image_, memory_, used_);
+}
+
+void Arena::restore(void) {
+  if (image_ != NULL) {
+    memcpy(memory_, image_, used_);
+  }
+}
+
+}  // namespace scal
@@ -0,0 +1,55 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// An arena takes the allocations of the scal allocators (get, malloc_aligned,
+// calloc_aligned, and the thread-local ones) while it is active, such that
+// an object constructed in it can be saved as an image and later restored by
+// a single copy, rather than deleted and constructed again. E.g. the
+// enumerator resets the object under test before each execution this way.
+//
+// Only the construction should happen in the arena: memory allocated later,
+// e.g. nodes, may stay reachable from the object until it is restored, and
+// arena memory must never be passed to free.
+
+#ifndef SCAL_UTIL_ARENA_H_
+#define SCAL_UTIL_ARENA_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace scal {
+
+class Arena {
+ public:
+  // Reserves capacity bytes of address space; pages are only backed once
+  // used.
+  explicit Arena(size_t capacity);
+  ~Arena();
+
+  // The allocators of the calling thread use this arena until deactivate.
+  void activate(void);
+  void deactivate(void);
+  static Arena* active(void);
+
+  // Zeroed memory, aligned to alignment, and at least as malloc; aborts once
+  // the arena is full.
+  void* allocate(size_t size, size_t alignment);
+  bool contains(const void *p) const;
+
+  // Keeps a copy of the memory used so far, which restore writes back.
+  void save(void);
+  void restore(void);
+
+  size_t used(void) const { return used_; }
+
+ private:
+  char *memory_;
+  size_t capacity_;
+  size_t used_;
+  char *image_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_ARENA_H_
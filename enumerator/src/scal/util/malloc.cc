@@ -14,6 +14,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "util/arena.h"
+
 DEFINE_bool(reuse_memory, true, "reuse memory, no matter what");
 DEFINE_bool(disable_tl_allocator, false, "all thread local calls are mapped"
                                          " to malloc");
@@ -62,6 +64,7 @@ MemBuffer* tl_buffer_get(void) {
     }
     buffer->memory = NULL;
     buffer->pointer = NULL;
+    buffer->start = NULL;
     if (pthread_setspecific(talloc_key, buffer)) {
       perror("pthread_setspecific");
       abort();
@@ -113,6 +116,12 @@ uint64_t human_size_to_pages(const char *hsize, size_t len) {
 }
 
 void* malloc_aligned(size_t size, size_t alignment) {
+  if (Arena::active() != NULL) {
+    return Arena::active()->allocate(size, alignment);
+  }
+  if (alignment == 0) {
+    return malloc(size);
+  }
   void *mem;
   int err;
   err = posix_memalign(&mem, alignment, size);
@@ -130,6 +139,12 @@ void* malloc_aligned(size_t size, size_t alignment) {
 }
 
 void* calloc_aligned(size_t num, size_t size, size_t alignment) {
+  if (Arena::active() != NULL) {
+    return Arena::active()->allocate(num * size, alignment);
+  }
+  if (alignment == 0) {
+    return calloc(num, size);
+  }
   void *mem = malloc_aligned(num * size, alignment);
   memset(mem, 0, align_size(num * size, alignment));
   return mem;
@@ -155,6 +170,9 @@ void tlalloc_init(uint64_t num_tlabs, bool touch_pages) {
 }
 
 void* tlmalloc(size_t size) {
+  if (Arena::active() != NULL) {
+    return Arena::active()->allocate(size, 2 * sizeof(kWord));
+  }
   if (FLAGS_disable_tl_allocator) {
     return malloc(size);
   }
@@ -198,6 +216,9 @@ void* tlcalloc(size_t num, size_t size) {
 }
 
 void* tlmalloc_aligned(size_t size, size_t alignment) {
+  if (Arena::active() != NULL) {
+    return Arena::active()->allocate(size, alignment);
+  }
   if (FLAGS_disable_tl_allocator) {
     return malloc_aligned(size, alignment);
   }
@@ -264,6 +285,22 @@ void tl_free_last(void) {
   buffer->last_size = 0;
 }
 
+// Releases the calling thread's buffer. Only safe once no object allocated
+// from it is reachable anymore, e.g., when a benchmark thread terminates.
+void tlalloc_destroy(void) {
+  if (FLAGS_disable_tl_allocator) {
+    return;
+  }
+  pthread_once(&key_once, make_pthread_key);
+  MemBuffer *buffer = static_cast<MemBuffer*>(pthread_getspecific(talloc_key));
+  if (buffer == NULL) {
+    return;
+  }
+  free(buffer->start);
+  free(buffer);
+  pthread_setspecific(talloc_key, NULL);
+}
+
 void tlprint_wrap_around(void) {
   pthread_once(&key_once, make_pthread_key);
   MemBuffer *buffer = tl_buffer_get();
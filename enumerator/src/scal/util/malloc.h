@@ -3,7 +3,8 @@
 // by a BSD license that can be found in the LICENSE file.
 
 // We use our own allocator where necessary. All functions use pthreads,
-// malloc, and posix_memalign underneath.
+// malloc, and posix_memalign underneath, or an active arena; see
+// util/arena.h.
 
 #ifndef SCAL_UTIL_MALLOC_H_
 #define SCAL_UTIL_MALLOC_H_
@@ -20,7 +21,7 @@ namespace scal {
 
 uint64_t human_size_to_pages(const char *hsize, size_t len);
 
-// convenience methods
+// convenience methods; an alignment of 0 means none
 void* malloc_aligned(size_t size, size_t alignment);
 void* calloc_aligned(size_t num, size_t size, size_t alignment);
 
@@ -41,7 +42,7 @@ template<typename T>
 T* get_aligned(uint64_t alignment) {
   void *mem;
   if (alignment == 0) {  // no alignment
-    mem = calloc(1, sizeof(T));
+    mem = calloc_aligned(1, sizeof(T), 0);
   } else {
     mem = malloc_aligned(sizeof(T), alignment);
     memset(mem, 0, sizeof(T));
@@ -66,6 +67,7 @@ void* tlcalloc(size_t num, size_t size);
 void* tlmalloc_aligned(size_t size, size_t alignment);
 void* tlcalloc_aligned(size_t num, size_t size, size_t alignment);
 void tl_free_last(void);
+void tlalloc_destroy(void);
 
 void tlprint_wrap_around(void);
 
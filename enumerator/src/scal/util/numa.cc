@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/numa.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "util/platform.h"
+
+namespace {
+
+const uint64_t kMaxNodes = 64;
+
+pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+std::vector<uint64_t> cpu_nodes;
+uint64_t num_nodes = 1;
+uint64_t configured_nodes = 0;
+uint64_t configured_cores;
+uint64_t configured_cores_per_node;
+
+// Parses a cpulist such as "0-3,8-11".
+void read_cpulist(FILE *f, uint64_t node) {
+  unsigned long first, last;
+  while (fscanf(f, "%lu", &first) == 1) {
+    last = first;
+    int c = fgetc(f);
+    if (c == '-') {
+      if (fscanf(f, "%lu", &last) != 1) {
+        return;
+      }
+      c = fgetc(f);
+    }
+    for (uint64_t cpu = first; cpu <= last; cpu++) {
+      if (cpu >= cpu_nodes.size()) {
+        cpu_nodes.resize(cpu + 1, 0);
+      }
+      cpu_nodes[cpu] = node;
+    }
+    if (c != ',') {
+      return;
+    }
+  }
+}
+
+void read_topology(void) {
+  char path[64];
+  for (uint64_t node = 0; node < kMaxNodes; node++) {
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/node/node%lu/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+      continue;
+    }
+    read_cpulist(f, node);
+    fclose(f);
+    if (node + 1 > num_nodes) {
+      num_nodes = node + 1;
+    }
+  }
+}
+
+inline void ensure_topology(void) {
+  pthread_once(&topology_once, read_topology);
+}
+
+}  // namespace
+
+namespace scal {
+
+void numa_configure(uint64_t num_nodes) {
+  configured_nodes = num_nodes;
+  if (num_nodes > 0) {
+    configured_cores = number_of_cores();
+    configured_cores_per_node = (configured_cores + num_nodes - 1) / num_nodes;
+  }
+}
+
+uint64_t numa_num_nodes(void) {
+  if (configured_nodes > 0) {
+    return configured_nodes;
+  }
+  ensure_topology();
+  return num_nodes;
+}
+
+uint64_t numa_node_of_cpu(uint64_t cpu) {
+  if (configured_nodes > 0) {
+    return (cpu % configured_cores) / configured_cores_per_node;
+  }
+  ensure_topology();
+  return cpu < cpu_nodes.size() ? cpu_nodes[cpu] : 0;
+}
+
+uint64_t numa_current_node(void) {
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : numa_node_of_cpu(cpu);
+}
+
+}  // namespace scal
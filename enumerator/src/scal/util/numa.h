@@ -0,0 +1,29 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// The NUMA topology, as far as balancers need it: which node each CPU is on.
+// It is read once from /sys/devices/system/node, and is a single node where
+// that is not available.
+
+#ifndef SCAL_UTIL_NUMA_H_
+#define SCAL_UTIL_NUMA_H_
+
+#include <stdint.h>
+
+namespace scal {
+
+// Replaces the topology by num_nodes nodes with equally many consecutive
+// CPUs, e.g. to try out NUMA-aware code on a single node; 0 restores the
+// actual topology.
+void numa_configure(uint64_t num_nodes);
+
+uint64_t numa_num_nodes(void);
+uint64_t numa_node_of_cpu(uint64_t cpu);
+
+// The node of the CPU the caller currently runs on.
+uint64_t numa_current_node(void);
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_NUMA_H_
@@ -82,13 +82,26 @@ class TLOperationLogger : public TLOperationLoggerInterface<T> {
     op->linearization = get_hwtime();
   }
 
-  void print_summary() {
+  inline uint64_t count() const {
+    return count_;
+  }
+
+  inline Operation<T>* operation(uint64_t i) const {
+    return &operations_[i];
+  }
+
+  // Forget the recorded operations, keeping the buffer.
+  inline void reset() {
+    count_ = 0;
+  }
+
+  void print_summary(FILE *out = stdout) {
     for (uint64_t i = 0; i < count_; i++) {
       Operation<T> *op = &operations_[i];
       if (!op->success) {
         op->item = 0;
       }
-      printf("%c %lu %lu %lu %lu\n",
+      fprintf(out, "%c %lu %lu %lu %lu\n",
           kLogTypeSymbols[op->op_type],
           op->item,
           op->invocation,
@@ -132,12 +145,22 @@ class OperationLogger {
     return *(tl_loggers_[thread_id]);
   }
 
-  static void print_summary(void) {
+  static inline TLOperationLogger<T>* logger(uint64_t thread_id) {
+    return tl_loggers_[thread_id];
+  }
+
+  static void reset(void) {
+    for (uint64_t i = 0; i < num_loggers_; i++) {
+      tl_loggers_[i]->reset();
+    }
+  }
+
+  static void print_summary(FILE *out = stdout) {
     if (!active_) {
       return;
     }
     for (uint64_t i = 0; i < num_loggers_; i++) {
-      tl_loggers_[i]->print_summary();
+      tl_loggers_[i]->print_summary(out);
     }
   }
 
@@ -0,0 +1,156 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Payload types for the data structures.
+//
+// The data structures are templates in their item type T, and the enumerator
+// and the benchmark identify items by a tag. PayloadTraits<T> provides, for a
+// payload type T:
+//
+// * make(tag, size)  a payload with the given non-zero tag; size is the
+//                    number of bytes, for payloads of variable size;
+// * tag(x)           the tag of x, which is 0 for the empty payload T();
+// * release(x)       frees what make allocated, if anything;
+// * kWordSized       whether T fits an AtomicValue.
+//
+// The payload types are:
+//
+// * int, and other integers, which are their own tag;
+// * Payload<N>, N bytes copied inline by value;
+// * MovablePayload, which owns a buffer on the heap, and is moved rather
+//   than copied by the data structures which support it;
+// * MovablePayload*, any such payload passed by pointer.
+//
+// Data structures which keep their items in AtomicValues (the k-FIFOs, the
+// k-stack, the elimination stack, ...) take word-sized payloads only, and use
+// the empty payload as sentinel; the ones which keep them in nodes take any.
+
+#ifndef SCAL_UTIL_PAYLOAD_H_
+#define SCAL_UTIL_PAYLOAD_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+
+namespace scal {
+
+template<size_t N>
+struct Payload {
+  uint64_t tag;
+  char data[N - sizeof(uint64_t)];
+
+  Payload() : tag(0) {}
+};
+
+class MovablePayload {
+ public:
+  MovablePayload() : tag_(0), size_(0), data_(NULL) {}
+
+  MovablePayload(uint64_t tag, size_t size)
+      : tag_(tag), size_(size), data_(static_cast<char*>(malloc(size))) {
+    memset(data_, static_cast<int>(tag), size_);
+  }
+
+  MovablePayload(const MovablePayload &other)
+      : tag_(other.tag_), size_(other.size_), data_(NULL) {
+    if (other.data_ != NULL) {
+      data_ = static_cast<char*>(malloc(size_));
+      memcpy(data_, other.data_, size_);
+    }
+  }
+
+  MovablePayload(MovablePayload &&other)
+      : tag_(other.tag_), size_(other.size_), data_(other.data_) {
+    other.tag_ = 0;
+    other.size_ = 0;
+    other.data_ = NULL;
+  }
+
+  MovablePayload& operator=(MovablePayload other) {
+    std::swap(tag_, other.tag_);
+    std::swap(size_, other.size_);
+    std::swap(data_, other.data_);
+    return *this;
+  }
+
+  ~MovablePayload() {
+    free(data_);
+    data_ = NULL;
+  }
+
+  inline uint64_t tag() const {
+    return tag_;
+  }
+
+ private:
+  uint64_t tag_;
+  size_t size_;
+  char *data_;
+};
+
+template<typename T>
+struct PayloadTraits {
+  static const bool kWordSized = true;
+
+  static inline T make(uint64_t tag, size_t) {
+    return static_cast<T>(tag);
+  }
+  static inline uint64_t tag(const T &x) {
+    return static_cast<uint64_t>(x);
+  }
+  static inline void release(T*) {}
+};
+
+template<size_t N>
+struct PayloadTraits<Payload<N> > {
+  static const bool kWordSized = false;
+
+  static inline Payload<N> make(uint64_t tag, size_t) {
+    Payload<N> x;
+    x.tag = tag;
+    memset(x.data, static_cast<int>(tag), sizeof(x.data));
+    return x;
+  }
+  static inline uint64_t tag(const Payload<N> &x) {
+    return x.tag;
+  }
+  static inline void release(Payload<N>*) {}
+};
+
+template<>
+struct PayloadTraits<MovablePayload> {
+  static const bool kWordSized = false;
+
+  static inline MovablePayload make(uint64_t tag, size_t size) {
+    return MovablePayload(tag, size);
+  }
+  static inline uint64_t tag(const MovablePayload &x) {
+    return x.tag();
+  }
+  static inline void release(MovablePayload *x) {
+    *x = MovablePayload();
+  }
+};
+
+template<>
+struct PayloadTraits<MovablePayload*> {
+  static const bool kWordSized = true;
+
+  static inline MovablePayload* make(uint64_t tag, size_t size) {
+    return new MovablePayload(tag, size);
+  }
+  static inline uint64_t tag(MovablePayload * const &x) {
+    return x == NULL ? 0 : x->tag();
+  }
+  static inline void release(MovablePayload **x) {
+    delete *x;
+    *x = NULL;
+  }
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_PAYLOAD_H_
@@ -21,6 +21,12 @@ inline long number_of_cores() {
   return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+// Keeps the compiler from reordering memory accesses across it; on x86 this
+// suffices to publish data before a volatile flag.
+inline void compiler_barrier() {
+  __asm__ __volatile__("" : : : "memory");
+}
+
 }  // namespace scal
 
 #endif  // SCAL_UTIL_PLATFORM_H_
@@ -0,0 +1,207 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/reclamation.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "util/malloc.h"
+#include "util/platform.h"
+#include "util/threadlocals.h"
+
+namespace {
+
+const uint64_t kMaxReclaimThreads = 1024;
+const uint64_t kNumEpochs = 3;
+
+struct ReclaimRecord {
+  volatile uint64_t epoch;
+  volatile bool active;
+  void * volatile hazards[scal::HazardPointerReclamation::kNumHazards];
+  // Nodes retired in global epoch e wait in limbo[e % kNumEpochs].
+  std::vector<void*> limbo[kNumEpochs];
+  std::vector<void*> retired;
+  uint64_t num_retired;
+} __attribute__((aligned(scal::kCachePrefetch)));
+
+// The records of the threads which share objects, and their epoch.
+struct ReclaimDomain {
+  ReclaimRecord * volatile records[kMaxReclaimThreads];
+  volatile uint64_t num_records;
+  volatile uint64_t global_epoch;
+};
+
+ReclaimDomain shared_domain;
+__thread ReclaimDomain *domain = &shared_domain;
+uint64_t reclaim_threshold = 64;
+
+uint64_t context_thread_id(void) {
+  return scal::ThreadContext::get().thread_id();
+}
+
+ReclaimRecord* my_record() {
+  uint64_t id = scal::reclaim_thread_hook() % kMaxReclaimThreads;
+  if (domain->records[id] == NULL) {
+    void *mem = scal::malloc_aligned(sizeof(ReclaimRecord), scal::kCachePrefetch);
+    domain->records[id] = new(mem) ReclaimRecord();
+    uint64_t n;
+    while ((n = domain->num_records) <= id) {
+      __sync_bool_compare_and_swap(&domain->num_records, n, id + 1);
+    }
+  }
+  return domain->records[id];
+}
+
+void free_all(std::vector<void*> *nodes) {
+  for (uint64_t i = 0; i < nodes->size(); i++) {
+    scal::reclaim_free_hook((*nodes)[i]);
+  }
+  nodes->clear();
+}
+
+// Nodes retired two epochs ago are unreachable for every active thread.
+inline void collect(ReclaimRecord *r, uint64_t epoch) {
+  free_all(&r->limbo[(epoch + 1) % kNumEpochs]);
+}
+
+// The global epoch advances once every active thread has seen it.
+void try_advance(void) {
+  uint64_t epoch = domain->global_epoch;
+  for (uint64_t i = 0; i < domain->num_records; i++) {
+    ReclaimRecord *r = domain->records[i];
+    if (r != NULL && r->active && r->epoch != epoch) {
+      return;
+    }
+  }
+  __sync_bool_compare_and_swap(&domain->global_epoch, epoch, epoch + 1);
+}
+
+void scan(ReclaimRecord *r) {
+  std::vector<void*> hazards;
+  for (uint64_t i = 0; i < domain->num_records; i++) {
+    ReclaimRecord *other = domain->records[i];
+    if (other == NULL) {
+      continue;
+    }
+    for (int j = 0; j < scal::HazardPointerReclamation::kNumHazards; j++) {
+      void *p = other->hazards[j];
+      if (p != NULL) {
+        hazards.push_back(p);
+      }
+    }
+  }
+  std::sort(hazards.begin(), hazards.end());
+  std::vector<void*> kept;
+  for (uint64_t i = 0; i < r->retired.size(); i++) {
+    void *p = r->retired[i];
+    if (std::binary_search(hazards.begin(), hazards.end(), p)) {
+      kept.push_back(p);
+    } else {
+      scal::reclaim_free_hook(p);
+    }
+  }
+  r->retired.swap(kept);
+}
+
+}  // namespace
+
+namespace scal {
+
+void* (*reclaim_malloc_hook)(size_t size) = malloc;
+void (*reclaim_free_hook)(void *p) = free;
+uint64_t (*reclaim_thread_hook)(void) = context_thread_id;
+
+void reclamation_configure(uint64_t threshold) {
+  reclaim_threshold = threshold > 0 ? threshold : 1;
+}
+
+void reclamation_reset(void) {
+  for (uint64_t i = 0; i < domain->num_records; i++) {
+    ReclaimRecord *r = domain->records[i];
+    if (r == NULL) {
+      continue;
+    }
+    for (uint64_t e = 0; e < kNumEpochs; e++) {
+      free_all(&r->limbo[e]);
+    }
+    free_all(&r->retired);
+    for (int j = 0; j < HazardPointerReclamation::kNumHazards; j++) {
+      r->hazards[j] = NULL;
+    }
+    r->active = false;
+    r->epoch = 0;
+    r->num_retired = 0;
+  }
+  domain->global_epoch = 0;
+}
+
+void reclamation_enter_private_domain(void) {
+  domain = static_cast<ReclaimDomain*>(calloc(1, sizeof(ReclaimDomain)));
+}
+
+void reclamation_leave_private_domain(void) {
+  if (domain == &shared_domain) {
+    return;
+  }
+  reclamation_reset();
+  for (uint64_t i = 0; i < domain->num_records; i++) {
+    ReclaimRecord *r = domain->records[i];
+    if (r != NULL) {
+      r->~ReclaimRecord();
+      free(r);
+    }
+  }
+  free(domain);
+  domain = &shared_domain;
+}
+
+void EpochReclamation::enter() {
+  ReclaimRecord *r = my_record();
+  uint64_t epoch = domain->global_epoch;
+  r->epoch = epoch;
+  r->active = true;
+  __sync_synchronize();
+  collect(r, epoch);
+}
+
+void EpochReclamation::leave() {
+  __sync_synchronize();
+  my_record()->active = false;
+}
+
+void EpochReclamation::retire(void *p) {
+  ReclaimRecord *r = my_record();
+  r->limbo[domain->global_epoch % kNumEpochs].push_back(p);
+  if (++r->num_retired >= reclaim_threshold) {
+    r->num_retired = 0;
+    try_advance();
+    collect(r, domain->global_epoch);
+  }
+}
+
+void HazardPointerReclamation::leave() {
+  ReclaimRecord *r = my_record();
+  for (int i = 0; i < kNumHazards; i++) {
+    r->hazards[i] = NULL;
+  }
+}
+
+void HazardPointerReclamation::protect(int i, void *p) {
+  my_record()->hazards[i] = p;
+  __sync_synchronize();
+}
+
+void HazardPointerReclamation::retire(void *p) {
+  ReclaimRecord *r = my_record();
+  r->retired.push_back(p);
+  if (r->retired.size() >= reclaim_threshold) {
+    scan(r);
+  }
+}
+
+}  // namespace scal
@@ -0,0 +1,108 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Reclamation policies for the nodes of the data structures.
+//
+// Data structures which unlink nodes take a Reclamation template argument and
+// call, for every operation:
+//
+// * enter() before touching any node, and leave() once done with them;
+// * protect(i, p) before dereferencing a shared node p, then re-validate that
+//   p is still reachable (e.g. that the head did not change);
+// * retire(p) for each node it unlinked.
+//
+// The policies are:
+//
+// * NoReclamation             nodes come from the thread-local bump allocator
+//                             and are never reused; the default.
+// * EpochReclamation          epoch-based reclamation, after K. Fraser.
+//                             Practical lock-freedom. PhD thesis, 2004.
+// * HazardPointerReclamation  after M. Michael. Hazard pointers: safe memory
+//                             reclamation for lock-free objects. IEEE TPDS
+//                             15(6), 2004.
+//
+// Reclaimed nodes are allocated and freed through hooks, which default to
+// malloc and free; the enumerator installs its own allocator, such that its
+// allocation policies reuse reclaimed nodes. Nodes allocated while an arena
+// is active, e.g. sentinels, come from the arena instead (see util/arena.h),
+// and the free hook must ignore them. Each thread keeps a record,
+// identified by another hook which defaults to the ThreadContext id.
+
+#ifndef SCAL_UTIL_RECLAMATION_H_
+#define SCAL_UTIL_RECLAMATION_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "util/arena.h"
+#include "util/malloc.h"
+
+namespace scal {
+
+extern void* (*reclaim_malloc_hook)(size_t size);
+extern void (*reclaim_free_hook)(void *p);
+extern uint64_t (*reclaim_thread_hook)(void);
+
+// How many nodes a thread retires before it tries to reclaim; 64 by default.
+void reclamation_configure(uint64_t threshold);
+
+// Frees the nodes still waiting for reclamation, and forgets all records.
+// Only call when no operation is running, e.g. between enumerated executions.
+void reclamation_reset(void);
+
+// The records and epochs are shared by all threads, unless a thread enters a
+// private domain: e.g. a worker of a parallel enumeration, whose instances
+// of the objects no other thread touches, such that the resets and epochs
+// of the others do not interfere with its own. Leaving frees the domain,
+// with the nodes still waiting in it.
+void reclamation_enter_private_domain(void);
+void reclamation_leave_private_domain(void);
+
+template<typename T>
+T* reclaim_get(void) {
+  void *mem = Arena::active() != NULL
+      ? Arena::active()->allocate(sizeof(T), 0)
+      : reclaim_malloc_hook(sizeof(T));
+  memset(mem, 0, sizeof(T));
+  return new(mem) T();
+}
+
+struct NoReclamation {
+  template<typename T>
+  static inline T* get(uint64_t alignment) {
+    return tlget_aligned<T>(alignment);
+  }
+  static inline void enter() {}
+  static inline void leave() {}
+  static inline void protect(int, void*) {}
+  static inline void retire(void*) {}
+};
+
+struct EpochReclamation {
+  template<typename T>
+  static inline T* get(uint64_t) {
+    return reclaim_get<T>();
+  }
+  static void enter();
+  static void leave();
+  static inline void protect(int, void*) {}
+  static void retire(void *p);
+};
+
+struct HazardPointerReclamation {
+  static const int kNumHazards = 3;
+
+  template<typename T>
+  static inline T* get(uint64_t) {
+    return reclaim_get<T>();
+  }
+  static inline void enter() {}
+  static void leave();
+  static void protect(int i, void *p);
+  static void retire(void *p);
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_RECLAMATION_H_
@@ -31,12 +31,39 @@ ThreadContext& ThreadContext::get() {
 
 void ThreadContext::assign_context() {
   uint64_t thread_id = __sync_fetch_and_add(&global_thread_id_cnt, 1);
+  assign_context(thread_id);
+}
+
+// Binds the calling thread to a specific prepared context. Used by harnesses
+// that run several rounds of threads and want stable ids in every round.
+void ThreadContext::assign_context(uint64_t thread_id) {
   if (pthread_setspecific(threadcontext_key, contexts[thread_id])) {
     fprintf(stderr, "%s: pthread_setspecific failed\n", __func__);
     exit(EXIT_FAILURE);
   }
 }
 
+void ThreadContext::assign_private_context(uint64_t thread_id) {
+  size_t size = (sizeof(ThreadContext) / scal::kPageSize + 1) * scal::kPageSize;
+  void *mem;
+  if (posix_memalign(&mem, scal::kPageSize, size)) {
+    fprintf(stderr, "%s: posix_memalign failed\n", __func__);
+    exit(EXIT_FAILURE);
+  }
+  ThreadContext *context = new(mem) ThreadContext();
+  context->thread_id_ = thread_id;
+  context->new_random_seed();
+  if (pthread_setspecific(threadcontext_key, context)) {
+    fprintf(stderr, "%s: pthread_setspecific failed\n", __func__);
+    exit(EXIT_FAILURE);
+  }
+}
+
+void ThreadContext::release_private_context() {
+  free(pthread_getspecific(threadcontext_key));
+  pthread_setspecific(threadcontext_key, NULL);
+}
+
 void ThreadContext::prepare(uint64_t num_threads) {
   pthread_key_create(&threadcontext_key, NULL);
   size_t size = (sizeof(ThreadContext) / scal::kPageSize + 1) * scal::kPageSize;
@@ -17,6 +17,12 @@ class ThreadContext {
   static ThreadContext& get();
   static void prepare(uint64_t num_threads);
   static void assign_context();
+  static void assign_context(uint64_t thread_id);
+  // Binds the calling thread to a new context of its own with the given id,
+  // e.g., when threads run separate instances of the objects; released with
+  // release_private_context.
+  static void assign_private_context(uint64_t thread_id);
+  static void release_private_context();
 
   inline uint64_t thread_id() {
     return thread_id_;
@@ -0,0 +1,253 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/trace_checker.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace {
+
+const int kMaxLineLength = 256;
+
+// Parses one line of TLOperationLogger::print_summary. Unsuccessful
+// operations are printed with item 0, so traces must use non-zero values.
+bool parse_operation(const char *line, scal::Operation<uint64_t> *op) {
+  char type;
+  unsigned long item, invocation, linearization, response;
+  if (sscanf(line, "%c %lu %lu %lu %lu",
+             &type, &item, &invocation, &linearization, &response) != 5) {
+    return false;
+  }
+  op->op_type = (type == '+') ? scal::kEnqueue : scal::kDequeue;
+  op->item = item;
+  op->success = item != 0;
+  op->invocation = invocation;
+  op->linearization = linearization;
+  op->response = response;
+  return true;
+}
+
+}  // namespace
+
+namespace scal {
+
+TraceReader::~TraceReader() {
+  for (uint64_t i = 0; i < runs_.size(); i++) {
+    fclose(runs_[i].file);
+  }
+}
+
+bool TraceReader::open(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+
+  // First pass: find where each run starts and how long it is. A run is a
+  // sequence of operations each invoked after the previous one returned.
+  std::vector<std::pair<long, uint64_t> > runs;
+  char line[kMaxLineLength];
+  Operation<uint64_t> op;
+  uint64_t last_response = 0;
+  long offset = ftell(file);
+  while (fgets(line, kMaxLineLength, file) != NULL) {
+    if (parse_operation(line, &op)) {
+      if (runs.empty() || op.invocation < last_response) {
+        runs.push_back(std::make_pair(offset, 0));
+      }
+      runs.back().second++;
+      last_response = op.response;
+    }
+    offset = ftell(file);
+  }
+  fclose(file);
+
+  for (uint64_t i = 0; i < runs.size(); i++) {
+    Run run;
+    run.file = fopen(path, "r");
+    if (run.file == NULL) {
+      return false;
+    }
+    fseek(run.file, runs[i].first, SEEK_SET);
+    run.remaining = runs[i].second;
+    runs_.push_back(run);
+    if (advance(runs_.size() - 1)) {
+      push(runs_.size() - 1);
+    }
+  }
+  return true;
+}
+
+bool TraceReader::advance(uint64_t run) {
+  Run *r = &runs_[run];
+  char line[kMaxLineLength];
+  while (r->remaining > 0 && fgets(line, kMaxLineLength, r->file) != NULL) {
+    if (parse_operation(line, &r->op)) {
+      r->remaining--;
+      r->responded = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TraceReader::push(uint64_t run) {
+  Run *r = &runs_[run];
+  uint64_t time = r->responded ? r->op.response : r->op.invocation;
+  heads_.insert(std::make_pair(std::make_pair(time, r->responded), run));
+}
+
+bool TraceReader::next(TraceEvent *event) {
+  if (heads_.empty()) {
+    return false;
+  }
+  uint64_t run = heads_.begin()->second;
+  heads_.erase(heads_.begin());
+
+  Run *r = &runs_[run];
+  event->is_response = r->responded;
+  event->time = r->responded ? r->op.response : r->op.invocation;
+  event->op = r->op;
+
+  // Operations of one thread do not overlap, so its events are ordered.
+  if (!r->responded) {
+    r->responded = true;
+    push(run);
+  } else if (advance(run)) {
+    push(run);
+  }
+  return true;
+}
+
+TraceChecker::TraceChecker(TraceOrder order, uint64_t max_reports)
+    : order_(order),
+      max_reports_(max_reports),
+      num_operations_(0),
+      num_violations_(0),
+      max_window_(0) {
+}
+
+void TraceChecker::process(const TraceEvent &event) {
+  const Operation<uint64_t> &op = event.op;
+  if (!event.is_response) {
+    if (op.op_type == kEnqueue) {
+      add_invoked(op);
+    } else {
+      remove_invoked(op);
+    }
+  } else {
+    num_operations_++;
+    if (op.op_type == kEnqueue) {
+      add_returned(op);
+    } else {
+      remove_returned(op);
+    }
+  }
+  if (values_.size() > max_window_) {
+    max_window_ = values_.size();
+  }
+}
+
+void TraceChecker::add_invoked(const Operation<uint64_t> &op) {
+  if (!op.success) {
+    return;
+  }
+  Value &v = values_[op.item];
+  if (v.added) {
+    report("value added twice", op, op.item);
+    return;
+  }
+  v.added = true;
+  v.add_invocation = op.invocation;
+}
+
+void TraceChecker::add_returned(const Operation<uint64_t> &op) {
+  if (!op.success) {
+    return;
+  }
+  std::map<uint64_t, Value>::iterator it = values_.find(op.item);
+  if (it == values_.end() || it->second.add_invocation != op.invocation) {
+    return;
+  }
+  Value &v = it->second;
+  v.add_done = true;
+  v.add_response = op.response;
+  if (v.remove_done) {
+    values_.erase(it);
+  } else if (!v.removing) {
+    inside_.insert(std::make_pair(v.add_response, op.item));
+  }
+}
+
+void TraceChecker::remove_invoked(const Operation<uint64_t> &op) {
+  if (!op.success) {
+    return;
+  }
+  Value &v = values_[op.item];
+  if (v.add_done && !v.removing) {
+    inside_.erase(std::make_pair(v.add_response, op.item));
+  }
+  v.removing = true;
+}
+
+void TraceChecker::remove_returned(const Operation<uint64_t> &op) {
+  // An empty remove must not overlap a value which was certainly inside.
+  if (!op.success) {
+    if (!inside_.empty() && inside_.begin()->first < op.invocation) {
+      report("removed empty", op, inside_.begin()->second);
+    }
+    return;
+  }
+
+  std::map<uint64_t, Value>::iterator it = values_.find(op.item);
+  Value &v = it->second;
+  if (!v.added || v.remove_done) {
+    report("removed without a matching add", op, op.item);
+  } else if (order_ == kFifoOrder) {
+    // No older value may still be waiting for its remove.
+    if (!inside_.empty() && inside_.begin()->first < v.add_invocation) {
+      report("removed before an older value", op, inside_.begin()->second);
+    }
+  } else if (v.add_done) {
+    // No value added between the add and this remove may still be inside.
+    // Candidates have their add returned in (add_response, invocation), so
+    // the scan stays within the concurrency window.
+    std::set<std::pair<uint64_t, uint64_t> >::iterator c =
+        inside_.lower_bound(std::make_pair(op.invocation, 0));
+    while (c != inside_.begin()) {
+      --c;
+      if (c->first <= v.add_response) {
+        break;
+      }
+      if (values_[c->second].add_invocation > v.add_response) {
+        report("removed before a younger value", op, c->second);
+        break;
+      }
+    }
+  }
+
+  v.remove_done = true;
+  if (!v.added || v.add_done) {
+    values_.erase(it);
+  }
+}
+
+void TraceChecker::report(const char *what,
+                          const Operation<uint64_t> &op,
+                          uint64_t other) {
+  num_violations_++;
+  if (num_violations_ > max_reports_) {
+    return;
+  }
+  printf("violation: %c %lu [%lu,%lu] %s; see %lu\n",
+         kLogTypeSymbols[op.op_type],
+         op.item,
+         op.invocation,
+         op.response,
+         what,
+         other);
+}
+
+}  // namespace scal
@@ -0,0 +1,133 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Offline checking of operation logs, as written by
+// TLOperationLogger::print_summary, against queue or stack semantics.
+//
+// TraceReader splits the input into sequential runs, normally one per thread
+// (a run ends where an operation is invoked before the previous one returned),
+// and merges the runs by timestamp with one open stream per run, so only one
+// operation per run is held in memory.
+//
+// TraceChecker consumes the merged events and checks, per value, conditions
+// after Henzinger et al. (CONCUR'13) for histories with unique values: every
+// removed value was added (and removed once), no remove returned empty while
+// a single value was certainly inside throughout, and no pair of values was
+// removed against the order in which their adds were certainly ordered. Each
+// violation it reports is one, but it does not catch all: an empty remove
+// may also be wrong because several values, none of them inside throughout,
+// kept the collection non-empty; and for stacks the pairwise LIFO check is
+// not complete either. It keeps only the values which are added but not yet
+// removed, plus the ones in flight, so memory is bounded by the size of the
+// collection and the concurrency window.
+
+#ifndef SCAL_UTIL_TRACE_CHECKER_H_
+#define SCAL_UTIL_TRACE_CHECKER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util/operation_logger.h"
+
+namespace scal {
+
+enum TraceOrder {
+  kFifoOrder = 0,
+  kLifoOrder = 1
+};
+
+struct TraceEvent {
+  uint64_t time;
+  bool is_response;
+  Operation<uint64_t> op;
+};
+
+class TraceReader {
+ public:
+  TraceReader() {}
+  ~TraceReader();
+
+  // Adds the runs of the trace at path; returns false if it cannot be read.
+  bool open(const char *path);
+
+  // Fetches the next event in timestamp order; returns false at the end.
+  bool next(TraceEvent *event);
+
+  inline uint64_t num_runs() const {
+    return runs_.size();
+  }
+
+ private:
+  struct Run {
+    FILE *file;
+    uint64_t remaining;
+    Operation<uint64_t> op;
+    bool responded;
+  };
+
+  bool advance(uint64_t run);
+  void push(uint64_t run);
+
+  std::vector<Run> runs_;
+  // Next event of each run, keyed by (time, response?, run); invocations
+  // sort first on equal stamps so that such operations count as overlapping.
+  std::set<std::pair<std::pair<uint64_t, bool>, uint64_t> > heads_;
+};
+
+class TraceChecker {
+ public:
+  TraceChecker(TraceOrder order, uint64_t max_reports);
+
+  void process(const TraceEvent &event);
+
+  inline uint64_t num_operations() const {
+    return num_operations_;
+  }
+
+  inline uint64_t num_violations() const {
+    return num_violations_;
+  }
+
+  inline uint64_t max_window() const {
+    return max_window_;
+  }
+
+ private:
+  struct Value {
+    uint64_t add_invocation;
+    uint64_t add_response;
+    bool added;
+    bool add_done;
+    bool removing;
+    bool remove_done;
+  };
+
+  void add_invoked(const Operation<uint64_t> &op);
+  void add_returned(const Operation<uint64_t> &op);
+  void remove_invoked(const Operation<uint64_t> &op);
+  void remove_returned(const Operation<uint64_t> &op);
+  void report(const char *what, const Operation<uint64_t> &op, uint64_t other);
+
+  TraceOrder order_;
+  uint64_t max_reports_;
+  uint64_t num_operations_;
+  uint64_t num_violations_;
+  uint64_t max_window_;
+
+  // Values which are added or in flight.
+  std::map<uint64_t, Value> values_;
+  // Values whose add returned and whose remove was not invoked yet, keyed by
+  // the response time of the add.
+  std::set<std::pair<uint64_t, uint64_t> > inside_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_TRACE_CHECKER_H_
@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/yield.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "util/platform.h"
+#include "util/threadlocals.h"
+#include "util/time.h"
+
+namespace {
+
+void no_yield(void) {}
+
+void no_footprint(void*) {}
+
+// Without an enumerator, no thread could wake a blocked one.
+bool no_block(void*, bool) {
+  return false;
+}
+
+void no_wake(void*) {}
+
+const uint64_t kMaxPerturbThreads = 1024;
+const uint64_t kMaxPerturbDepth = 16;
+
+struct PerturbState {
+  uint64_t rank;
+} __attribute__((aligned(scal::kCachePrefetch)));
+
+PerturbState perturb_states[kMaxPerturbThreads];
+uint64_t perturb_num_threads;
+uint64_t perturb_depth;
+uint64_t perturb_spins_per_unit;
+uint64_t perturb_change_points[kMaxPerturbDepth];
+uint64_t perturb_horizon;
+volatile uint64_t perturb_steps;
+
+inline void spin(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    __asm__ __volatile__("pause");
+  }
+}
+
+uint32_t next_rand(uint32_t *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 1;
+}
+
+}  // namespace
+
+namespace scal {
+
+void (*yield_hook)(void) = no_yield;
+void (*footprint_hook)(void *site) = no_footprint;
+bool (*block_hook)(void *channel, bool timed) = no_block;
+void (*wake_hook)(void *channel) = no_wake;
+
+// Enumerated threads run one at a time, so releasing the lock and blocking is
+// atomic, as long as block_hook does not yield before it disables the thread.
+int EnumeratedBlocking::wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+                             const struct timespec *deadline) {
+  int rc = pthread_mutex_unlock(lock);
+  if (rc != 0) {
+    return rc;
+  }
+  bool woken = block_hook(cond, deadline != NULL);
+  rc = pthread_mutex_lock(lock);
+  if (rc != 0) {
+    return rc;
+  }
+  return woken ? 0 : ETIMEDOUT;
+}
+
+int EnumeratedBlocking::notify(pthread_cond_t *cond) {
+  wake_hook(cond);
+  return 0;
+}
+
+void RandomDelayYield::yield() {
+  int x = ::rand();
+  if ((x % 2) == 0) {
+    int us = 1 << (x % 10 + 8);
+    usleep(us);
+  }
+}
+
+void perturb_configure(uint64_t num_threads, uint64_t depth, uint64_t unit_ns) {
+  perturb_num_threads = num_threads;
+  perturb_depth = depth < kMaxPerturbDepth ? depth : kMaxPerturbDepth;
+  perturb_horizon = 1;
+
+  // Calibrate the spin loop against wall-clock time.
+  const uint64_t kCalibrationSpins = 1 << 20;
+  uint64_t start = get_utime();
+  spin(kCalibrationSpins);
+  uint64_t elapsed_ns = (get_utime() - start) * 1000;
+  if (elapsed_ns == 0) {
+    elapsed_ns = 1;
+  }
+  perturb_spins_per_unit = kCalibrationSpins * unit_ns / elapsed_ns;
+}
+
+void perturb_new_round(uint32_t seed) {
+  // The number of steps of the last round estimates the length of this one.
+  if (perturb_steps > 0) {
+    perturb_horizon = perturb_steps;
+  }
+  perturb_steps = 0;
+
+  // A random permutation of the ranks 0..n-1 over the threads.
+  for (uint64_t i = 0; i < perturb_num_threads; i++) {
+    perturb_states[i].rank = i;
+  }
+  for (uint64_t i = perturb_num_threads; i > 1; i--) {
+    uint64_t j = next_rand(&seed) % i;
+    uint64_t rank = perturb_states[i - 1].rank;
+    perturb_states[i - 1].rank = perturb_states[j].rank;
+    perturb_states[j].rank = rank;
+  }
+  for (uint64_t i = 0; i + 1 < perturb_depth; i++) {
+    perturb_change_points[i] = next_rand(&seed) % perturb_horizon;
+  }
+}
+
+void PerturbYield::yield() {
+  uint64_t thread_id = ThreadContext::get().thread_id() % kMaxPerturbThreads;
+  PerturbState *state = &perturb_states[thread_id];
+  uint64_t step = __sync_fetch_and_add(&perturb_steps, 1);
+  for (uint64_t i = 0; i + 1 < perturb_depth; i++) {
+    if (perturb_change_points[i] == step) {
+      state->rank = perturb_num_threads + i;
+    }
+  }
+  spin(state->rank * perturb_spins_per_unit);
+}
+
+}  // namespace scal
@@ -0,0 +1,100 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Yield policies for the data structures.
+//
+// Every data structure that contains interleaving points takes a YieldPolicy
+// template argument and calls YieldPolicy::yield() at each of them. The policy
+// decides what happens there:
+//
+// * NoYield           nothing at all; native builds pay no cost.
+// * SwitchYield       switch back to the enumerator's scheduler.
+// * FootprintYield    like SwitchYield, but also reports the yield site.
+// * RandomDelayYield  sleep for a random while.
+// * PerturbYield      spin for a delay given by a PCT-style priority, for
+//                     stress testing on real threads.
+//
+// The switching policies call through hooks which the enumerator installs;
+// until then they do nothing.
+//
+// Data structures which park threads use the policy's blocking primitives:
+// with lock held, wait(cond, lock, deadline) releases lock, waits for
+// notify(cond), or until the absolute deadline unless it is NULL, and acquires
+// lock again; both return 0 or an error number, such as ETIMEDOUT. Natively,
+// these are pthread_cond_(timed)wait and pthread_cond_signal. The switching
+// policies instead disable the enumerated thread through block_hook, until
+// another one notifies it through wake_hook; a timed wait times out once no
+// thread can run.
+
+#ifndef SCAL_UTIL_YIELD_H_
+#define SCAL_UTIL_YIELD_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+namespace scal {
+
+extern void (*yield_hook)(void);
+extern void (*footprint_hook)(void *site);
+extern bool (*block_hook)(void *channel, bool timed);
+extern void (*wake_hook)(void *channel);
+
+struct NativeBlocking {
+  static inline int wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+                         const struct timespec *deadline) {
+    if (deadline == NULL) {
+      return pthread_cond_wait(cond, lock);
+    }
+    return pthread_cond_timedwait(cond, lock, deadline);
+  }
+
+  static inline int notify(pthread_cond_t *cond) {
+    return pthread_cond_signal(cond);
+  }
+};
+
+struct EnumeratedBlocking {
+  static int wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+                  const struct timespec *deadline);
+  static int notify(pthread_cond_t *cond);
+};
+
+struct NoYield : NativeBlocking {
+  static inline void yield() {}
+};
+
+struct SwitchYield : EnumeratedBlocking {
+  static inline void yield() {
+    yield_hook();
+  }
+};
+
+struct FootprintYield : EnumeratedBlocking {
+  // Not inlined, such that the return address identifies the yield site.
+  static __attribute__((noinline)) void yield() {
+    footprint_hook(__builtin_return_address(0));
+  }
+};
+
+struct RandomDelayYield : NativeBlocking {
+  static void yield();
+};
+
+// PCT-style perturbation (Burckhardt et al., ASPLOS'10) approximated on real
+// threads: every thread gets a random priority rank per round and spins for
+// rank * unit at each yield; at depth-1 random global steps the yielding
+// thread drops below all others. Threads are identified by their
+// ThreadContext id in [0,num_threads). Call perturb_configure once, and
+// perturb_new_round before each round of operations.
+struct PerturbYield : NativeBlocking {
+  static void yield();
+};
+
+void perturb_configure(uint64_t num_threads, uint64_t depth, uint64_t unit_ns);
+void perturb_new_round(uint32_t seed);
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_YIELD_H_
@@ -1,51 +1,284 @@
 #include <gflags/gflags.h>
 #include <sstream>
 #include <map>
+#include <vector>
 
-// NOTE order matters here, since Yield will be defined differently
 #include "violin.h"
 #include "scal.h"
+#include "util/arena.h"
+#include "util/payload.h"
+#include "util/reclamation.h"
+#include "util/yield.h"
+#include "stress.h"
 
 DEFINE_int32(adds, 1, "how many add operations?");
 DEFINE_int32(removes, 1, "how many remove operations?");
+DEFINE_string(workload, "", "operations of each enumerated thread, e.g. aar,rra for adds and removes; overrides -adds and -removes");
 DEFINE_int32(barriers, 0, "how many barriers?");
 DEFINE_int32(delays, 0, "how many delays?");
-DEFINE_string(mode, "counting", "which mode? {nothing,counting,counting-no-verify,linearization,versus}");
+DEFINE_string(mode, "counting", "which mode? {nothing,counting,counting-no-verify,linearization,versus,stress}");
 DEFINE_int32(alloc, 0, "allocation policy? 0=default, 1=LRF, 2=MRF");
 DEFINE_string(show, "all", "show which histories? {all,wins,violations,none}");
+DEFINE_string(yield, "switch", "how to yield? {switch,footprint}");
+DEFINE_int32(threads, 2, "how many threads in stress mode?");
+DEFINE_int32(rounds, 100000, "how many rounds in stress mode?");
+DEFINE_int32(pct_depth, 3, "how many priority changes per stress round, plus one?");
+DEFINE_int32(spin, 100, "stress-mode delay unit per priority rank, in nanoseconds");
+DEFINE_int32(batch, 1, "how many adds, resp. removes, per put_batch or get_batch?");
+DEFINE_int32(relaxation, 0, "accepted order relaxation k? 0=the object's own (k or quasi_factor), 1=strict; versus mode is always strict");
+DEFINE_string(payload, "int", "which items? {int,pointer,inline,moved}");
+DEFINE_int32(payload_size, 64, "how many bytes per pointer, inline (16, 64 or 256) or moved item?");
+DEFINE_uint64(max_executions, 0, "stop after how many schedules? 0=all");
+DEFINE_double(max_seconds, 0, "stop after how many seconds? 0=never");
+DEFINE_double(progress, 10, "report progress to stderr every how many seconds? 0=never");
+DEFINE_string(stats, "", "file to keep the latest progress report in, if any");
+DEFINE_string(deepen, "none", "explore exactly 0, 1, ... delays up to -delays? {none,first (until a violation),all}");
+DEFINE_bool(shrink, false, "shrink the first violation to a smallest reproducer?");
+DEFINE_string(record, "", "binary trace file to record the schedule of each execution in, if any");
+DEFINE_bool(record_violations, false, "record the violating executions only?");
+DEFINE_string(shard, "", "explore which shard of the schedules? i/n for the i-th of n, from 0");
+DEFINE_string(shard_results, "", "file to write the results of the shard to, for merge-shards, if any");
+DEFINE_string(replay, "", "binary trace file to replay an execution of, instead of enumerating");
+DEFINE_string(reset, "snapshot", "how to reset the object before each execution? {snapshot,recreate}");
+DEFINE_int32(workers, 1, "how many worker threads to search on? they steal prefixes of the schedules from each other");
+DEFINE_uint64(replay_execution, 0, "which execution to replay? N=execution N, 0=the shrunk reproducer if one was recorded, else the first violation");
 
-Pool<int> *obj, *spec_obj;
+// The enumerator identifies values by int; a TaggedPool puts the payload
+// tagged with each value, and gets the tags back.
+class TaggedPool {
+ public:
+  virtual ~TaggedPool() {}
+  virtual void put(int v) = 0;
+  virtual bool get(int *v) = 0;
+  virtual void put_batch(int *vs, int n) = 0;
+  virtual int get_batch(int *vs, int n) = 0;
+};
+
+template<typename T>
+class PayloadPool : public TaggedPool {
+ public:
+  typedef scal::PayloadTraits<T> Traits;
+
+  explicit PayloadPool(Pool<T> *pool) : pool_(pool) {}
+  ~PayloadPool() { delete pool_; }
+
+  void put(int v) {
+    pool_->put(Traits::make(v, FLAGS_payload_size));
+  }
+
+  bool get(int *v) {
+    T item;
+    if (!pool_->get(&item))
+      return false;
+    *v = Traits::tag(item);
+    Traits::release(&item);
+    return true;
+  }
+
+  void put_batch(int *vs, int n) {
+    vector<T> items;
+    for (int i = 0; i < n; i++)
+      items.push_back(Traits::make(vs[i], FLAGS_payload_size));
+    pool_->put_batch(&items[0], n);
+  }
+
+  int get_batch(int *vs, int n) {
+    vector<T> items(n);
+    int got = pool_->get_batch(&items[0], n);
+    for (int i = 0; i < got; i++) {
+      vs[i] = Traits::tag(items[i]);
+      Traits::release(&items[i]);
+    }
+    return got;
+  }
+
+ private:
+  Pool<T> *pool_;
+};
+
+template<typename T>
+TaggedPool* payload_create(string obj, scal_yield_t yield) {
+  Pool<T> *pool = obj_create_payload<T>(obj, yield);
+  return pool == NULL ? NULL : new PayloadPool<T>(pool);
+}
+
+TaggedPool* tagged_create(string obj, scal_yield_t yield) {
+  if (FLAGS_payload == "pointer")
+    return payload_create<scal::MovablePayload*>(obj, yield);
+  else if (FLAGS_payload == "moved")
+    return payload_create<scal::MovablePayload>(obj, yield);
+  else if (FLAGS_payload == "inline" && FLAGS_payload_size <= 16)
+    return payload_create< scal::Payload<16> >(obj, yield);
+  else if (FLAGS_payload == "inline" && FLAGS_payload_size <= 64)
+    return payload_create< scal::Payload<64> >(obj, yield);
+  else if (FLAGS_payload == "inline")
+    return payload_create< scal::Payload<256> >(obj, yield);
+  else
+    return payload_create<int>(obj, yield);
+}
+
+// The objects of the main thread, which the threads of stress mode share.
+TaggedPool *obj;
+Pool<int> *spec_obj;
 string lib_object, spec_object;
+scal_yield_t yield_policy;
+
+// Each worker of a parallel search has objects, and arenas, of its own; see
+// worker_initialize.
+__thread bool in_worker;
+__thread TaggedPool *worker_obj;
+__thread Pool<int> *worker_spec_obj;
+
+TaggedPool *&this_obj() {
+  return in_worker ? worker_obj : obj;
+}
+
+Pool<int> *&this_spec_obj() {
+  return in_worker ? worker_spec_obj : spec_obj;
+}
+
+// With -reset snapshot, the object and the specification are constructed
+// once, each in its own arena, and reset by restoring the image of their
+// arena rather than deleted and constructed again; see util/arena.h. Arenas
+// only reserve address space, and are backed as far as used.
+const size_t kArenaSize = 1UL << 30;
+__thread scal::Arena *obj_arena;
+__thread scal::Arena *spec_arena;
+
+bool in_arena(void *p) {
+  return (obj_arena != NULL && obj_arena->contains(p))
+      || (spec_arena != NULL && spec_arena->contains(p));
+}
+
+// What objects allocate with new while constructed in an arena comes from
+// the arena as well.
+void* operator new(size_t size) {
+  if (scal::Arena::active() != NULL)
+    return scal::Arena::active()->allocate(size, 0);
+  void *p = malloc(size);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  if (!in_arena(p))
+    free(p);
+}
 
 void obj_reset() {
-  if (obj) delete obj;
-  obj = obj_create(lib_object);
+  scal::reclamation_reset();
+  if (obj_arena != NULL) {
+    obj_arena->restore();
+    return;
+  }
+  if (this_obj()) delete this_obj();
+  this_obj() = tagged_create(lib_object, yield_policy);
 }
 
 void spec_reset() {
-  if (spec_obj) delete spec_obj;
-  spec_obj = obj_create(spec_object);
+  if (spec_arena != NULL && this_spec_obj() != NULL) {
+    spec_arena->restore();
+    return;
+  }
+  if (spec_arena != NULL)
+    spec_arena->activate();
+  if (this_spec_obj()) delete this_spec_obj();
+  this_spec_obj() = obj_create(spec_object, NO_YIELD);
+  if (spec_arena != NULL) {
+    spec_arena->deactivate();
+    spec_arena->save();
+  }
 }
 
+// Reclaimed nodes are reused by the allocation policy, to catch ABA.
+void* obj_malloc(size_t size) {
+  return violin_malloc(size);
+}
+
+void obj_free(void *p) {
+  violin_free(p);
+}
+
+// Enumerated threads share the context of their OS thread, so each gets its
+// own reclamation record, and request slot (see scal_initialize_slots), by
+// its index in the enumerator; the records are reset before each execution.
+uint64_t enumerated_thread_id() {
+  return fibers->current_index;
+}
+
+// Creates the object, in an arena with -reset snapshot, and its
+// specification's arena; the specification is created by spec_reset.
+void obj_initialize() {
+  if (FLAGS_reset == "snapshot") {
+    obj_arena = new scal::Arena(kArenaSize);
+    spec_arena = new scal::Arena(kArenaSize);
+    obj_arena->activate();
+  }
+  this_obj() = tagged_create(lib_object, yield_policy);
+  if (obj_arena != NULL) {
+    obj_arena->deactivate();
+    obj_arena->save();
+  }
+}
+
+// A worker of a parallel search runs as thread 0 of a context, allocator
+// and reclamation domain of its own, on objects of its own.
+void worker_initialize() {
+  scal_initialize_thread();
+  scal::reclamation_enter_private_domain();
+  in_worker = true;
+  obj_initialize();
+}
+
+void worker_finalize() {
+  if (obj_arena != NULL) {
+    delete obj_arena;
+    delete spec_arena;
+  } else {
+    delete this_obj();
+    delete this_spec_obj();
+  }
+  this_obj() = NULL;
+  this_spec_obj() = NULL;
+  obj_arena = spec_arena = NULL;
+  in_worker = false;
+  scal::reclamation_leave_private_domain();
+  scal_finalize_thread();
+}
+
+// Called directly rather than through scal_object_put, whose thread
+// bookkeeping is not thread-safe; threads set up their allocators themselves.
 void obj_add(int v) {
-  scal_object_put(obj,v);
+  this_obj()->put(v);
 }
 
 void spec_add(int v) {
-  scal_object_put(spec_obj,v);
+  scal_object_put(this_spec_obj(),v);
 }
 
 int obj_remove() {
-  return scal_object_get(obj);
+  int v;
+  return this_obj()->get(&v) ? v : EMPTY_VAL;
+}
+
+void obj_add_batch(int *vs, int n) {
+  this_obj()->put_batch(vs,n);
+}
+
+int obj_remove_batch(int *vs, int n) {
+  return this_obj()->get_batch(vs,n);
 }
 
 int spec_remove() {
-  return scal_object_get(spec_obj);
+  return scal_object_get(this_spec_obj());
 }
 
 violin_order_t obj_order(string id) {
   string spec = obj_spec(id);
-  if (spec.find("stack") != string::npos)
+  if (spec.find("priority") != string::npos)
+    return PRIORITY_ORDER;
+  else if (spec.find("stack") != string::npos)
     return LIFO_ORDER;
   else if (spec.find("queue") != string::npos)
     return FIFO_ORDER;
@@ -55,7 +288,7 @@ violin_order_t obj_order(string id) {
 
 int main(int argc, char **argv) {
 
-	scal_initialize(1);
+  scal_declare_objects();
 
   stringstream usage;
   usage << "usage" << endl;
@@ -78,7 +311,55 @@ int main(int argc, char **argv) {
     exit(-1);
   }
 
-  spec_object = (obj_order(lib_object) == FIFO_ORDER) ? "msq" : lib_object;
+  if (FLAGS_workload != "") {
+    Workload workload = violin_parse_workload(FLAGS_workload);
+    if (workload.empty()) {
+      cerr << "Invalid workload \"" << FLAGS_workload << "\"; see --help for usage." << endl;
+      exit(-1);
+    }
+    violin_set_workload(workload);
+  }
+
+  int shard = 0, num_shards = 1;
+  if (FLAGS_shard != "") {
+    stringstream in(FLAGS_shard);
+    char slash = 0;
+    in >> shard >> slash >> num_shards;
+    if (in.fail() || !in.eof() || slash != '/' || shard < 0 || shard >= num_shards) {
+      cerr << "Invalid shard \"" << FLAGS_shard << "\"; see --help for usage." << endl;
+      exit(-1);
+    }
+    if (FLAGS_deepen != "none") {
+      cerr << "Shards do not deepen the delay bound; see --help for usage." << endl;
+      exit(-1);
+    }
+  }
+
+  if (FLAGS_workers < 1) {
+    cerr << "Invalid number of workers " << FLAGS_workers << "; see --help for usage." << endl;
+    exit(-1);
+  }
+  // The objects of wfq12 share their state; see wf_queue_ppopp12.h.
+  if (FLAGS_workers > 1
+      && (FLAGS_deepen != "none" || FLAGS_shard != "" || FLAGS_record != ""
+          || FLAGS_replay != "" || FLAGS_mode.find("stress") != string::npos
+          || lib_object == "wfq12")) {
+    cerr << "Workers do not deepen, shard, record or replay a search, nor stress "
+         << "or check wfq12; see --help for usage." << endl;
+    exit(-1);
+  }
+
+  // Variants such as ts-ebr are specified by their base object.
+  spec_object = (obj_order(lib_object) == FIFO_ORDER) ? "msq" : lib_object.substr(0, lib_object.find('-'));
+
+  bool stress = FLAGS_mode.find("stress") != string::npos;
+
+  // Stress-mode threads use context ids 1..threads; 0 is the main thread.
+  scal_initialize(stress ? FLAGS_threads + 1 : 1);
+  if (!stress)
+    scal_initialize_slots((FLAGS_workload != ""
+                           ? violin_parse_workload(FLAGS_workload)
+                           : violin_default_workload(FLAGS_adds, FLAGS_removes, FLAGS_batch)).size());
 
   violin_mode_t mode;
   if (FLAGS_mode.find("none") != string::npos)
@@ -101,6 +382,25 @@ int main(int argc, char **argv) {
   default: alloc = MRF_ALLOC; break;
   }
 
+  if (stress)
+    yield_policy = PERTURB_YIELD;
+  else if (FLAGS_yield.find("foot") != string::npos)
+    yield_policy = FOOTPRINT_YIELD;
+  else
+    yield_policy = SWITCH_YIELD;
+  scal::yield_hook = DoYield;
+  scal::footprint_hook = DoFootprintYield;
+  scal::block_hook = DoBlock;
+  scal::wake_hook = DoWake;
+
+  // Stress-mode threads are real, and reclaim through malloc and free.
+  if (!stress) {
+    scal::reclaim_malloc_hook = obj_malloc;
+    scal::reclaim_free_hook = obj_free;
+    scal::reclaim_thread_hook = enumerated_thread_id;
+    scal::reclamation_configure(1);
+  }
+
   violin_show_t show;
   if (FLAGS_show.find("none") != string::npos)
     show = SHOW_NONE;
@@ -111,10 +411,68 @@ int main(int argc, char **argv) {
   else
     show = SHOW_ALL;
 
-  cout << "Selected SCAL data structure: " << obj_name(lib_object) << endl;
+  int relaxation = FLAGS_relaxation > 0 ? FLAGS_relaxation : obj_relaxation(lib_object);
+
+  // Stress-mode threads free reclaimed nodes, which must not be in an arena.
+  if (stress)
+    obj = tagged_create(lib_object, yield_policy);
+  else
+    obj_initialize();
+  if (obj == NULL) {
+    cerr << "Data structure \"" << lib_object << "\" does not take "
+         << FLAGS_payload << " payloads; see util/payload.h." << endl;
+    exit(-1);
+  }
+
+  stringstream header;
+  header << "Selected SCAL data structure: " << obj_name(lib_object) << endl;
+  cout << header.str();
+
+  if (stress) {
+    violin_stress(
+      {.initialize = obj_reset, .add = obj_add, .remove = obj_remove,
+       .add_batch = NULL, .remove_batch = NULL},
+      FLAGS_adds,
+      FLAGS_removes,
+      obj_order(lib_object),
+      FLAGS_barriers,
+      FLAGS_threads,
+      FLAGS_rounds,
+      FLAGS_pct_depth,
+      FLAGS_spin,
+      show,
+      relaxation
+    );
+    return 0;
+  }
+
+  if (FLAGS_replay != "") {
+    return violin_replay_trace(
+      {.initialize = obj_reset, .add = obj_add, .remove = obj_remove,
+       .add_batch = obj_add_batch, .remove_batch = obj_remove_batch},
+      {.initialize = spec_reset, .add = spec_add, .remove = spec_remove,
+       .add_batch = NULL, .remove_batch = NULL},
+      FLAGS_replay,
+      FLAGS_replay_execution,
+      mode,
+      alloc,
+      obj_order(lib_object),
+      relaxation
+    );
+  }
+
+  violin_set_budget(FLAGS_max_executions, FLAGS_max_seconds, FLAGS_progress, FLAGS_stats);
+  violin_set_deepening(FLAGS_deepen != "none", FLAGS_deepen == "first");
+  violin_set_shrinking(FLAGS_shrink);
+  violin_set_recording(FLAGS_record, FLAGS_record_violations);
+  violin_set_sharding(shard, num_shards, FLAGS_shard_results, header.str());
+  violin_set_parallel(FLAGS_workers, worker_initialize, worker_finalize);
+
   violin(
-    {.initialize = obj_reset, .add = obj_add, .remove = obj_remove},
-    {.initialize = spec_reset, .add = spec_add, .remove = spec_remove},
+    {.initialize = obj_reset, .add = obj_add, .remove = obj_remove,
+     .add_batch = obj_add_batch, .remove_batch = obj_remove_batch},
+    {.initialize = spec_reset, .add = spec_add, .remove = spec_remove,
+     .add_batch = NULL, .remove_batch = NULL},
     FLAGS_adds,
     FLAGS_removes,
     mode,
@@ -122,7 +480,9 @@ int main(int argc, char **argv) {
     obj_order(lib_object),
     FLAGS_barriers,
     FLAGS_delays,
-    show
+    show,
+    relaxation,
+    FLAGS_batch
   );
   return 0;
 }
\ No newline at end of file
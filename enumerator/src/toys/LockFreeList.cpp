@@ -0,0 +1,102 @@
+#include "violin.h"
+
+// Harris-Michael lock-free list, after LockFreeLinkedList.cpp in
+// with-Boogie/src/c/LockFreeDS; the mark bit is kept in a separate field.
+
+struct node {
+  int key;
+  bool marked;
+  struct node *next;
+};
+
+struct node *head;
+
+bool cas(struct node **p, bool *m, struct node *t, bool tm, struct node *x, bool xm) {
+  if (*p == t && *m == tm) {
+    *p = x;
+    *m = xm;
+    return true;
+  } else return false;
+}
+
+struct node *new_node(int key, struct node *next) {
+  struct node *n = (struct node*) violin_malloc(sizeof *n);
+  n->key = key;
+  n->marked = false;
+  n->next = next;
+  return n;
+}
+
+void reset() {
+  head = new_node(0, new_node(OMEGA, 0));
+}
+
+// Find the first node with a key at least `key`, unlinking marked nodes.
+void find(int key, struct node **pred, struct node **curr) {
+retry:
+  while (true) {
+    *pred = head;
+    *curr = (*pred)->next;
+    while (true) {
+      struct node *succ = (*curr)->next;
+      Yield();
+      while ((*curr)->marked) {
+        if (!cas(&(*pred)->next, &(*pred)->marked, *curr, false, succ, false))
+          goto retry;
+        *curr = succ;
+        succ = (*curr)->next;
+        Yield();
+      }
+      if ((*curr)->key >= key)
+        return;
+      *pred = *curr;
+      *curr = succ;
+    }
+  }
+}
+
+bool insert(int key) {
+  struct node *pred, *curr;
+  while (true) {
+    find(key, &pred, &curr);
+    if (curr->key == key)
+      return false;
+    struct node *n = new_node(key, curr);
+    Yield();
+    if (cas(&pred->next, &pred->marked, curr, false, n, false))
+      return true;
+  }
+}
+
+bool remove(int key) {
+  struct node *pred, *curr;
+  while (true) {
+    find(key, &pred, &curr);
+    if (curr->key != key)
+      return false;
+    struct node *succ = curr->next;
+    Yield();
+    if (!cas(&curr->next, &curr->marked, succ, false, succ, true))
+      continue;
+    Yield();
+    cas(&pred->next, &pred->marked, curr, false, succ, false);
+    return true;
+  }
+}
+
+bool contains(int key) {
+  struct node *curr = head;
+  while (curr->key < key) {
+    curr = curr->next;
+    Yield();
+  }
+  return curr->key == key && !curr->marked;
+}
+
+int main() {
+  violin_set(
+    {.initialize = reset, .insert = insert, .remove = remove, .contains = contains},
+    1, 2, 1, 1,
+    COUNTING_MODE, LRF_ALLOC, 2, 2, SHOW_VIOLATIONS);
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "violin.h"
+
+// Lotan-Shavit priority queue, after LockFreePriorityQueue.cpp in
+// with-Boogie/src/c/LockFreeDS, on the bottom level of the skip list only:
+// remove marks the first unmarked node, and does not unlink it.
+
+struct node {
+  int key;
+  int marked;
+  struct node *next;
+};
+
+struct node *head;
+
+bool cas(struct node **p, struct node *t, struct node *x) {
+  if (*p == t) {
+    *p = x;
+    return true;
+  } else return false;
+}
+
+bool cas_int(int *p, int t, int x) {
+  if (*p == t) {
+    *p = x;
+    return true;
+  } else return false;
+}
+
+struct node *new_node(int key, struct node *next) {
+  struct node *n = (struct node*) violin_malloc(sizeof *n);
+  n->key = key;
+  n->marked = 0;
+  n->next = next;
+  return n;
+}
+
+void reset() {
+  head = new_node(0, new_node(OMEGA, 0));
+}
+
+void add(int key) {
+  while (true) {
+    struct node *pred = head;
+    struct node *curr = pred->next;
+    while (curr->key < key) {
+      pred = curr;
+      curr = curr->next;
+      Yield();
+    }
+    struct node *n = new_node(key, curr);
+    Yield();
+    if (cas(&pred->next, curr, n))
+      return;
+  }
+}
+
+int remove_min() {
+  struct node *curr = head->next;
+  while (curr->key != OMEGA) {
+    Yield();
+    if (!curr->marked && cas_int(&curr->marked, 0, 1))
+      return curr->key;
+    curr = curr->next;
+  }
+  return EMPTY_VAL;
+}
+
+// Sequential specification, for the linearization modes.
+
+int spec_keys[100];
+int spec_size;
+
+void spec_reset() {
+  spec_size = 0;
+}
+
+void spec_add(int key) {
+  spec_keys[spec_size++] = key;
+}
+
+int spec_remove_min() {
+  if (spec_size == 0)
+    return EMPTY_VAL;
+  int min = 0;
+  for (int i = 1; i < spec_size; i++)
+    if (spec_keys[i] < spec_keys[min])
+      min = i;
+  int key = spec_keys[min];
+  spec_keys[min] = spec_keys[--spec_size];
+  return key;
+}
+
+int main() {
+  violin(
+    {.initialize = reset, .add = add, .remove = remove_min,
+     .add_batch = NULL, .remove_batch = NULL},
+    {.initialize = spec_reset, .add = spec_add, .remove = spec_remove_min,
+     .add_batch = NULL, .remove_batch = NULL},
+    2, 2,
+    COUNTING_MODE, LRF_ALLOC, PRIORITY_ORDER, 2, 2, SHOW_VIOLATIONS);
+  return 0;
+}